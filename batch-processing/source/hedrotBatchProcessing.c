@@ -0,0 +1,274 @@
+//
+//  hedrotBatchProcessing.c
+//
+//  headless batch reprocessing of recorded sessions
+//
+//  the recordings (text format of the Max external, or binary format) are replayed through the estimation of
+//  libhedrot (same code path as the reception, see recordedSession_replayFrame), optionally with other settings or
+//  another calibration, and the results are written in the text format of the Max external (header, then raw and
+//  calibrated data, quaternion and angles for each frame): they can be read by matlab/readTextDataFromHeadtracker.m
+//  or reprocessed again. The files are shared dynamically between the worker threads (each thread takes the next
+//  file as soon as it is done with the previous one)
+//
+//  the recordings can also be converted to the binary format (option -b), much faster to read than the text format
+//
+//  note: the Max external records one frame per output tick, the frame rate (1000/outputDataPeriod) should then be
+//  given with the option -r when it differs from the samplerate of the headtracker
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "libhedrot.h"
+#include "libhedrot_recording.h"
+
+#define MAX_NUMBER_OF_THREADS       256
+#define MAX_FILENAME_LENGTH         1024
+
+#define REPROCESSED_SUFFIX          "_reprocessed.txt"
+#define BINARY_SUFFIX               ".hrb"
+
+//=====================================================================================================
+// structure definition: batchJob (one recording)
+//=====================================================================================================
+typedef struct _batchJob {
+    const char*         inputFilename;
+    char                outputFilename[MAX_FILENAME_LENGTH];
+    long                numberOfFrames;
+    long                samplerate;
+    int                 result; // 1 if successful
+} batchJob;
+
+//=====================================================================================================
+// structure definition: batchProcessing
+//=====================================================================================================
+typedef struct _batchProcessing {
+    // settings applied after the header of each recording (settings files and command-line settings)
+    recordedSession*    overrides;
+    long                framerate; // rate of the recorded frames (0: samplerate of the header)
+    char                binaryConversion; // 1: conversion to the binary format, without reprocessing
+    
+    // files
+    batchJob*           jobs;
+    long                numberOfJobs;
+    
+    // next job to process, shared by the worker threads
+    volatile long       nextJob;
+} batchProcessing;
+
+
+//=====================================================================================================
+// function reprocessSession
+//=====================================================================================================
+//
+// replay a session through the estimation and write the results to file
+// returns 1 if successful, 0 otherwise
+//
+int reprocessSession(recordedSession *session, FILE *file) {
+    headtrackerData *trackingData;
+    long n;
+    int result;
+    
+    trackingData = headtracker_new();
+    setOutputMask(trackingData, OUTPUT_MASK_ANGLES);
+    recordedSession_initReplay(session, trackingData);
+    
+    result = recordedSession_writeHeader(session, file);
+    
+    for(n = 0; n < session->numberOfFrames && result; n++) {
+        recordedSession_replayFrame(session, trackingData, n);
+        while(pullNotificationMessage(trackingData) != NOTIFICATION_MESSAGE_NONE);
+        
+        headtracker_updateOutputs(trackingData);
+        result = recordedSession_writeFrame(trackingData, file, n);
+    }
+    
+    headtracker_free(trackingData);
+    
+    return result;
+}
+
+
+//=====================================================================================================
+// function processJob
+//=====================================================================================================
+//
+// read a recording, then reprocess it or convert it to the binary format
+//
+void processJob(batchProcessing *batch, batchJob *job) {
+    recordedSession *session = newRecordedSession();
+    FILE *file;
+    long i;
+    
+    job->result = 0;
+    session->samplerate = batch->framerate;
+    
+    if(recordedSession_read(session, (char*) job->inputFilename)) {
+        job->numberOfFrames = session->numberOfFrames;
+        job->samplerate = session->samplerate;
+        
+        // settings applied after those of the header (written in the header of the output as well)
+        for(i = 0; i < batch->overrides->numberOfSettings; i++)
+            recordedSession_addSetting(session, batch->overrides->settings[i].key, batch->overrides->settings[i].value);
+        
+        if(batch->binaryConversion) {
+            job->result = recordedSession_writeBinary(session, job->outputFilename);
+        } else if(session->samplerate <= 0) {
+            printf("unknown frame rate for %s, use -r\r\n", job->inputFilename);
+        } else if((file = fopen(job->outputFilename, "w")) == NULL) {
+            printf("cannot open %s for writing\r\n", job->outputFilename);
+        } else {
+            job->result = reprocessSession(session, file);
+            if(fclose(file)) job->result = 0;
+            if(!job->result) printf("write error on %s\r\n", job->outputFilename);
+        }
+    }
+    
+    freeRecordedSession(session);
+}
+
+
+//=====================================================================================================
+// function workerThreadFunction
+//=====================================================================================================
+//
+// worker thread: processes the next file until all the files are done
+//
+void *workerThreadFunction(void *arg) {
+    batchProcessing *batch = (batchProcessing*) arg;
+    long job;
+    
+    while((job = __sync_fetch_and_add(&batch->nextJob, 1)) < batch->numberOfJobs)
+        processJob(batch, batch->jobs + job);
+    
+    return NULL;
+}
+
+
+//=====================================================================================================
+// function makeOutputFilename
+//=====================================================================================================
+//
+// name of the output file: name of the recording without extension + suffix, in outputDirectory if not NULL
+// (next to the recording otherwise)
+//
+void makeOutputFilename(char *outputFilename, const char *inputFilename, const char *outputDirectory, const char *suffix) {
+    const char *name = inputFilename, *slash;
+    char *dot;
+    
+    if(outputDirectory) {
+        if((slash = strrchr(inputFilename, '/')) != NULL) name = slash + 1;
+        snprintf(outputFilename, MAX_FILENAME_LENGTH, "%s/%s", outputDirectory, name);
+    } else {
+        snprintf(outputFilename, MAX_FILENAME_LENGTH, "%s", inputFilename);
+    }
+    
+    // remove the extension
+    if((dot = strrchr(outputFilename, '.')) != NULL && !strchr(dot, '/')) *dot = 0;
+    
+    strncat(outputFilename, suffix, MAX_FILENAME_LENGTH - strlen(outputFilename) - 1);
+}
+
+
+void printUsage() {
+    printf("usage: hedrot_batch [-j threads] [-r frame rate] [-i settings file]... [-s key=value]... [-o output directory] [-b] recordings...\r\n");
+    printf("\t-j: number of worker threads (default: number of cores)\r\n");
+    printf("\t-r: rate of the recorded frames in Hz (default: samplerate of the header of each recording)\r\n");
+    printf("\t-i: settings file (see export_settings), applied after the settings of each recording, can be repeated\r\n");
+    printf("\t-s: setting applied after the settings of each recording (e.g. -s MadgwickBetaMax=1 -s \"accOffset=0 0 0\"), can be repeated\r\n");
+    printf("\t-o: output directory (default: next to each recording). Output files: <recording>%s\r\n", REPROCESSED_SUFFIX);
+    printf("\t-b: convert the recordings to the binary format (<recording>%s) instead of reprocessing them\r\n", BINARY_SUFFIX);
+}
+
+
+int main(int argc, const char * argv[]) {
+    batchProcessing *batch;
+    pthread_t threads[MAX_NUMBER_OF_THREADS];
+    const char *outputDirectory = NULL;
+    char setting[RECORDING_MAX_KEY_LENGTH + RECORDING_MAX_VALUE_LENGTH], *equal;
+    int numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN), i;
+    long numberOfFrames = 0, numberOfFailures = 0, j;
+    double duration = 0, startTime, elapsedTime;
+    
+    printf("Hedrot batch processing, based on hedrot version %s, compiled on "__DATE__"\r\n", HEDROT_VERSION);
+    
+    batch = (batchProcessing*) malloc(sizeof(batchProcessing));
+    batch->overrides = newRecordedSession();
+    batch->framerate = 0;
+    batch->binaryConversion = 0;
+    batch->jobs = (batchJob*) malloc(argc * sizeof(batchJob));
+    batch->numberOfJobs = 0;
+    batch->nextJob = 0;
+    
+    // arguments
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-j") && i+1 < argc) numberOfThreads = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-r") && i+1 < argc) batch->framerate = atol(argv[++i]);
+        else if(!strcmp(argv[i], "-o") && i+1 < argc) outputDirectory = argv[++i];
+        else if(!strcmp(argv[i], "-b")) batch->binaryConversion = 1;
+        else if(!strcmp(argv[i], "-i") && i+1 < argc) {
+            if(!recordedSession_readSettings(batch->overrides, (char*) argv[++i])) return 1;
+        } else if(!strcmp(argv[i], "-s") && i+1 < argc) {
+            i++;
+            strncpy(setting, argv[i], sizeof(setting) - 1);
+            setting[sizeof(setting) - 1] = 0;
+            if((equal = strchr(setting, '=')) == NULL) {
+                printf("invalid setting %s (key=value)\r\n", argv[i]);
+                return 1;
+            }
+            *equal = 0;
+            recordedSession_addSetting(batch->overrides, setting, equal + 1);
+        } else if(argv[i][0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            batch->jobs[batch->numberOfJobs].inputFilename = argv[i];
+            batch->jobs[batch->numberOfJobs].numberOfFrames = 0;
+            batch->jobs[batch->numberOfJobs].samplerate = 0;
+            batch->numberOfJobs++;
+        }
+    }
+    
+    if(!batch->numberOfJobs) {
+        printUsage();
+        return 1;
+    }
+    
+    // output files (after all the arguments, the suffix depends on -b)
+    for(j = 0; j < batch->numberOfJobs; j++)
+        makeOutputFilename(batch->jobs[j].outputFilename, batch->jobs[j].inputFilename, outputDirectory,
+                           batch->binaryConversion ? BINARY_SUFFIX : REPROCESSED_SUFFIX);
+    
+    numberOfThreads = (int) max(min(min(numberOfThreads, MAX_NUMBER_OF_THREADS), batch->numberOfJobs), 1);
+    
+    startTime = get_monotonic_time();
+    for(i = 0; i < numberOfThreads; i++)
+        pthread_create(&threads[i], NULL, workerThreadFunction, batch);
+    for(i = 0; i < numberOfThreads; i++)
+        pthread_join(threads[i], NULL);
+    elapsedTime = get_monotonic_time() - startTime;
+    
+    // summary
+    for(j = 0; j < batch->numberOfJobs; j++) {
+        if(batch->jobs[j].result) {
+            printf("%s -> %s: %ld frames\r\n", batch->jobs[j].inputFilename, batch->jobs[j].outputFilename, batch->jobs[j].numberOfFrames);
+            numberOfFrames += batch->jobs[j].numberOfFrames;
+            if(batch->jobs[j].samplerate > 0) duration += (double) batch->jobs[j].numberOfFrames / batch->jobs[j].samplerate;
+        } else {
+            printf("%s: failed\r\n", batch->jobs[j].inputFilename);
+            numberOfFailures++;
+        }
+    }
+    printf("%ld files (%ld failed), %ld frames (%.1f s of recording) on %d threads in %.2f s (%.0f frames/s)\r\n",
+           batch->numberOfJobs, numberOfFailures, numberOfFrames, duration, numberOfThreads, elapsedTime,
+           elapsedTime > 0 ? numberOfFrames / elapsedTime : 0);
+    
+    freeRecordedSession(batch->overrides);
+    free(batch->jobs);
+    free(batch);
+    
+    return numberOfFailures ? 1 : 0;
+}
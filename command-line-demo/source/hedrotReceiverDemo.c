@@ -45,6 +45,7 @@ int main(int argc, const char * argv[]) {
     double currentTime1, currentTime2, previousTime;
     char messageNumber;
 	int i;
+    float q1, q2, q3, q4, yaw, pitch, roll;
 
     headtrackerData* trackingData;
     
@@ -59,6 +60,15 @@ int main(int argc, const char * argv[]) {
     // set verbose to 1
     setVerbose(trackingData,1);
     
+    // only the centered quaternion, the angles and the pose history are printed
+    setOutputMask(trackingData, OUTPUT_MASK_QUATERNION | OUTPUT_MASK_ANGLES | OUTPUT_MASK_POSE_HISTORY);
+    
+    // keep the calibrated gyroscope offset from one session to the next (no need to stay still at startup)
+    setGyroOffsetStoreFilename(trackingData, "hedrot_gyroOffsets.txt");
+    
+    // reduce the computation and the printing while the headtracker is not moving
+    setIdleModeOn(trackingData, 1);
+    
     // set autodiscover to 1
     setAutoDiscover(trackingData,1);
     
@@ -104,18 +114,45 @@ int main(int argc, const char * argv[]) {
                 case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_FINISHED:
                     printf("gyroscope calibration finished\r\n");
                     break;
+                case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_RESTORED:
+                    printf("stored gyroscope offset restored\r\n");
+                    break;
+                case NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED:
+                    export_gyroOffsetStore(trackingData);
+                    break;
+                case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED:
+                    printf("gyroscope calibration window clamped to %ld samples\r\n", trackingData->gyroBiasTrackerData->windowLength);
+                    break;
                 case NOTIFICATION_MESSAGE_BOARD_OVERLOAD:
                     printf("board too slow, reduce samplerate\r\n");
                     break;
+                case NOTIFICATION_MESSAGE_MAG_DISTURBANCE_STARTED:
+                    printf("magnetic disturbance detected\r\n");
+                    break;
+                case NOTIFICATION_MESSAGE_MAG_DISTURBANCE_ENDED:
+                    printf("magnetic disturbance ended\r\n");
+                    break;
+                case NOTIFICATION_MESSAGE_IDLE_MODE_STARTED:
+                    printf("idle mode started\r\n");
+                    break;
+                case NOTIFICATION_MESSAGE_IDLE_MODE_ENDED:
+                    printf("idle mode ended\r\n");
+                    break;
             }
         }
         currentTime2 = getTime();
         
         
-        // print estimated quaternion and angles if transmitting
-        if(trackingData->infoReceptionStatus == COMMUNICATION_STATE_HEADTRACKER_TRANSMITTING) {
+        // print estimated quaternion and angles if transmitting (in idle mode, only once per second)
+        if(trackingData->infoReceptionStatus == COMMUNICATION_STATE_HEADTRACKER_TRANSMITTING
+           && headtracker_outputDue(trackingData, get_monotonic_time())) {
+            headtracker_updateOutputs(trackingData);
             printf("estimated quaternion: %f %f %f %f\r\n", trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4);
             printf("estimated angles: yaw %f - pitch %f - roll %f\r\n", trackingData->yaw, trackingData->pitch, trackingData->roll);
+            // pose resampled at the current time (minus 10 ms to stay inside the received data)
+            if(headtracker_getResampledPose(trackingData, get_monotonic_time() - .01, &q1, &q2, &q3, &q4, &yaw, &pitch, &roll) != RESAMPLING_NO_DATA) {
+                printf("resampled angles: yaw %f - pitch %f - roll %f\r\n", yaw, pitch, roll);
+            }
             printf("Time elapsed since last tick = %f sec\r\n", currentTime2 - previousTime);
         }
         
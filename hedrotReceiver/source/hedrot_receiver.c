@@ -11,6 +11,7 @@
 
 void hedrot_receiver_tick(t_hedrot_receiver *x) {
     t_atom output;
+    t_atom output3[3];
     t_ptr_size len;
     
     char messageNumber;
@@ -33,6 +34,13 @@ void hedrot_receiver_tick(t_hedrot_receiver *x) {
             atom_setfloat(&output, x->trackingData->beta);
             outlet_anything( x->x_debug_outlet, gensym("beta"), 1, &output);
             
+            if(x->trackingData->estimationMethod == 2) {
+                atom_setfloat(output3, x->trackingData->ESKFgyroBias[0]);
+                atom_setfloat(output3+1, x->trackingData->ESKFgyroBias[1]);
+                atom_setfloat(output3+2, x->trackingData->ESKFgyroBias[2]);
+                outlet_anything( x->x_debug_outlet, gensym("gyroBias"), 3, output3);
+            }
+            
             
             // if we're recording the data in a text file, add a new line
             if(x->recordingDataFlag != 0) {
@@ -92,6 +100,15 @@ void hedrot_receiver_tick(t_hedrot_receiver *x) {
             case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_FINISHED:
                 hedrot_receiver_outputGyroCalibrationFinishedNotice(x);
                 break;
+            case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_RESTORED:
+                hedrot_receiver_outputGyroCalibrationRestoredNotice(x);
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED:
+                defer((t_object *)x, (method)hedrot_receiver_defered_exportGyroOffsetStore, NULL, 0, NULL);
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED:
+                hedrot_receiver_gyroCalibrationWindowClampedNotice(x);
+                break;
             case NOTIFICATION_MESSAGE_MAG_CALIBRATION_STARTED:
                 hedrot_receiver_outputMagCalibrationStartedNotice(x);
                 break;
@@ -132,6 +149,14 @@ void hedrot_receiver_tick(t_hedrot_receiver *x) {
             case NOTIFICATION_MESSAGE_BOARD_OVERLOAD:
                 hedrot_receiver_boardOverloadNotice(x);
                 break;
+            case NOTIFICATION_MESSAGE_MAG_DISTURBANCE_STARTED:
+            case NOTIFICATION_MESSAGE_MAG_DISTURBANCE_ENDED:
+                hedrot_receiver_magDisturbanceNotice(x);
+                break;
+            case NOTIFICATION_MESSAGE_IDLE_MODE_STARTED:
+            case NOTIFICATION_MESSAGE_IDLE_MODE_ENDED:
+                hedrot_receiver_idleModeNotice(x);
+                break;
             default:
                 post("[hedrot_receiver] : unknown message %ld from libhedrot", messageNumber);
                 break;
@@ -168,36 +193,97 @@ void hedrot_receiver_autodiscover_deferedTick(t_hedrot_receiver *x, t_symbol *s,
 void hedrot_receiver_output_data(t_hedrot_receiver *x)
 {
     int i;
+    float q1, q2, q3, q4, yaw, pitch, roll, *block;
+    long outputsDue, l, size;
+    double hostTime = get_monotonic_time();
+    
+    // compute the angles and the prediction for the latest frame (only once per tick, not for every received frame)
+    headtracker_updateOutputs(x->trackingData);
+    
+    // if resampling is on, output the pose at the current time minus resamplingDelay (no jitter)
+    // otherwise output the latest received pose
+    if(!(x->resamplingDelay > 0
+         && headtracker_getResampledPose(x->trackingData, hostTime - x->resamplingDelay * .001, &q1, &q2, &q3, &q4, &yaw, &pitch, &roll) != RESAMPLING_NO_DATA)) {
+        q1 = x->trackingData->qcent1;
+        q2 = x->trackingData->qcent2;
+        q3 = x->trackingData->qcent3;
+        q4 = x->trackingData->qcent4;
+        yaw = x->trackingData->yaw;
+        pitch = x->trackingData->pitch;
+        roll = x->trackingData->roll;
+    }
     
-    for (i=0; i < 3; i++) {
-        //prepare the lists (raw and calibrated)
-        atom_setlong(x->rawData+i,x->trackingData->magRawData[i]);
-        atom_setlong(x->rawData+i+3,x->trackingData->accRawData[i]);
-        atom_setlong(x->rawData+i+6,x->trackingData->gyroRawData[i]);
-        
-        atom_setfloat(x->calData+i,x->trackingData->magCalData[i]);
-        atom_setfloat(x->calData+i+3,x->trackingData->accCalDataLP[i]);
-        atom_setfloat(x->calData+i+6,x->trackingData->gyroCalData[i]);
+    // outputs to publish: in idle mode, only at the heartbeat rate; with the deadband, only the poses that changed
+    // (the deadband is tested on the pose actually sent)
+    outputsDue = headtracker_outputDueForPose(x->trackingData, hostTime, q1, q2, q3, q4, yaw, pitch, roll);
+    if(!outputsDue) return;
+    
+    //prepare the lists (raw and calibrated), only if they are published (attribute outputMask)
+    if(outputsDue & OUTPUT_MASK_RAW_DATA) {
+        for (i=0; i < 3; i++) {
+            atom_setlong(x->rawData+i,x->trackingData->magRawData[i]);
+            atom_setlong(x->rawData+i+3,x->trackingData->accRawData[i]);
+            atom_setlong(x->rawData+i+6,x->trackingData->gyroRawData[i]);
+        }
+    }
+    
+    if(outputsDue & OUTPUT_MASK_CALIBRATED_DATA) {
+        for (i=0; i < 3; i++) {
+            atom_setfloat(x->calData+i,x->trackingData->magCalData[i]);
+            atom_setfloat(x->calData+i+3,x->trackingData->accCalDataLP[i]);
+            atom_setfloat(x->calData+i+6,x->trackingData->gyroCalData[i]);
+        }
     }
     
     // output data, right-to-left order
     if(x->trackingData->calibrationValid) {
-        atom_setfloat(x->t_estimatedQuaternion,(float)x->trackingData->qcent1);
-        atom_setfloat(x->t_estimatedQuaternion+1,(float)x->trackingData->qcent2);
-        atom_setfloat(x->t_estimatedQuaternion+2,(float)x->trackingData->qcent3);
-        atom_setfloat(x->t_estimatedQuaternion+3,(float)x->trackingData->qcent4);
+        atom_setfloat(x->t_estimatedQuaternion,q1);
+        atom_setfloat(x->t_estimatedQuaternion+1,q2);
+        atom_setfloat(x->t_estimatedQuaternion+2,q3);
+        atom_setfloat(x->t_estimatedQuaternion+3,q4);
+        
         
+        atom_setfloat(x->t_estimatedAngles,yaw);
+        atom_setfloat(x->t_estimatedAngles+1,pitch);
+        atom_setfloat(x->t_estimatedAngles+2,roll);
+        
+        // spherical harmonic rotation matrices of the latest frame, one message per degree: band <degree> <block, row major>
+        if(x->trackingData->SHrotationOrder > 0 && (outputsDue & OUTPUT_MASK_SH_ROTATION)) {
+            for(l = 1; l <= x->trackingData->SHrotationOrder; l++) {
+                block = SHrotation_getBlock(x->trackingData->outputSHrotation, l);
+                size = (2*l+1) * (2*l+1);
+                atom_setlong(x->t_SHrotationBand, l);
+                for(i = 0; i < size; i++)
+                    atom_setfloat(x->t_SHrotationBand+i+1, block[i]);
+                outlet_anything(x->x_SHrotation_outlet, gensym("band"), size+1, x->t_SHrotationBand);
+            }
+        }
         
-        atom_setfloat(x->t_estimatedAngles,(float)x->trackingData->yaw);
-        atom_setfloat(x->t_estimatedAngles+1,(float)x->trackingData->pitch);
-        atom_setfloat(x->t_estimatedAngles+2,(float)x->trackingData->roll);
+        // predicted (latency-compensated) orientation, only if the prediction is on
+        if(x->trackingData->predictionTime > 0 && (outputsDue & OUTPUT_MASK_PREDICTION)) {
+            atom_setfloat(x->t_predictedQuaternion,(float)x->trackingData->qpred1);
+            atom_setfloat(x->t_predictedQuaternion+1,(float)x->trackingData->qpred2);
+            atom_setfloat(x->t_predictedQuaternion+2,(float)x->trackingData->qpred3);
+            atom_setfloat(x->t_predictedQuaternion+3,(float)x->trackingData->qpred4);
+            
+            atom_setfloat(x->t_predictedAngles,(float)x->trackingData->predictedYaw);
+            atom_setfloat(x->t_predictedAngles+1,(float)x->trackingData->predictedPitch);
+            atom_setfloat(x->t_predictedAngles+2,(float)x->trackingData->predictedRoll);
+            
+            outlet_anything(x->x_predicted_outlet, gensym("quaternion"), 4, x->t_predictedQuaternion);
+            outlet_anything(x->x_predicted_outlet, gensym("angles"), 3, x->t_predictedAngles);
+        }
         
-        outlet_list(x->x_cookedQuaternions_outlet,NULL,4,x->t_estimatedQuaternion);
-        outlet_list(x->x_cookedAngles_outlet,NULL,3,x->t_estimatedAngles);
-        outlet_list(x->x_calData_outlet,NULL,9,x->calData);
+        if(outputsDue & OUTPUT_MASK_QUATERNION)
+            outlet_list(x->x_cookedQuaternions_outlet,NULL,4,x->t_estimatedQuaternion);
+        if(outputsDue & OUTPUT_MASK_ANGLES)
+            outlet_list(x->x_cookedAngles_outlet,NULL,3,x->t_estimatedAngles);
+        if(outputsDue & OUTPUT_MASK_CALIBRATED_DATA)
+            outlet_list(x->x_calData_outlet,NULL,9,x->calData);
     }
     
-    outlet_list(x->x_rawData_outlet,NULL,9,x->rawData);
+    if(outputsDue & OUTPUT_MASK_RAW_DATA)
+        outlet_list(x->x_rawData_outlet,NULL,9,x->rawData);
     
 }
 
@@ -230,6 +316,8 @@ void *hedrot_receiver_new(t_symbol *s, short ac, t_atom *av)
     x = (t_hedrot_receiver *)object_alloc(hedrot_receiver_class);
     
     // create outlets
+    x->x_SHrotation_outlet = outlet_new(x, 0);
+    x->x_predicted_outlet = outlet_new(x, 0);
     x->x_debug_outlet = outlet_new(x, 0);
     x->x_error_outlet = outlet_new(x, 0);
     x->x_status_outlet = outlet_new(x, 0);
@@ -248,6 +336,12 @@ void *hedrot_receiver_new(t_symbol *s, short ac, t_atom *av)
     // default output data rate
     x->outputDataPeriod = 5;
     
+    // no stored gyroscope offset by default
+    x->gyroOffsetStoreFile = gensym("");
+    
+    // no resampling by default (latest sample output)
+    x->resamplingDelay = 0;
+    
     // dictionaries and buffers for calibration data
     x->magCalInfoDict = dictionary_new();
     x->magCalInfoDictName = symbol_unique();
@@ -321,6 +415,9 @@ void hedrot_receiver_free(t_hedrot_receiver *x)
     hedrot_receiver_close(x);
     hedrot_receiver_free_clock(x);
     
+    // offset tracked until the port has been closed
+    export_gyroOffsetStore(x->trackingData);
+    
     object_free((t_object *)x->magCalInfoDict); // will call object_unregister
     object_free((t_object *)x->accCalInfoDict); // will call object_unregister
     
@@ -364,6 +461,9 @@ void hedrot_receiver_assist(t_hedrot_receiver *x, void *b, long m, long a, char
             case 3: sprintf(s, "cooked quaternion"); break;
             case 4: sprintf(s, "status"); break;
             case 5: sprintf(s, "error messages"); break;
+            case 6: sprintf(s, "debug"); break;
+            case 7: sprintf(s, "predicted (latency-compensated) quaternion and angles"); break;
+            case 8: sprintf(s, "spherical harmonic rotation matrices (band <degree> <matrix>)"); break;
         }
     }
 }
@@ -744,6 +844,13 @@ void hedrot_receiver_defered_exportRTmagRawCalData(t_hedrot_receiver *x, t_symbo
 }
 
 
+void hedrot_receiver_defered_exportGyroOffsetStore(t_hedrot_receiver *x, t_symbol *s) {
+    // the stored gyroscope offsets have been updated (in memory), write the file out of the scheduler thread
+    if(!export_gyroOffsetStore(x->trackingData))
+        error("[hedrot_receiver] Error while storing the gyroscope offset");
+}
+
+
 void hedrot_receiver_outputPortList(t_hedrot_receiver *x) {
     t_atom message_clear[2], outptr[4];
     int i;
@@ -813,6 +920,15 @@ void hedrot_receiver_outputGyroCalibrationFinishedNotice(t_hedrot_receiver *x) {
     if(x->verbose) post("[hedrot_receiver]: gyroscope offset calibration finished");
 }
 
+void hedrot_receiver_outputGyroCalibrationRestoredNotice(t_hedrot_receiver *x) {
+    t_atom output3[3];
+    
+    atom_setfloat_array( 3, output3, 3, x->trackingData->gyroOffset);
+    outlet_anything( x->x_debug_outlet, gensym("gyroOffset"), 3, output3);
+    
+    if(x->verbose) post("[hedrot_receiver]: stored gyroscope offset restored, calibration running in the background");
+}
+
 void hedrot_receiver_outputMagCalibrationStartedNotice(t_hedrot_receiver *x) {
     t_atom output[2];
     atom_setsym(output, gensym("status"));
@@ -913,6 +1029,34 @@ void hedrot_receiver_boardOverloadNotice(t_hedrot_receiver *x) {
     if(x->verbose) post("[hedrot_receiver] : board too slow, reduce samplerate");
 }
 
+void hedrot_receiver_gyroCalibrationWindowClampedNotice(t_hedrot_receiver *x) {
+    t_atom output;
+    
+    atom_setlong(&output, x->trackingData->gyroBiasTrackerData->windowLength);
+    
+    outlet_anything( x->x_error_outlet, gensym("gyro_calibration_window_clamped"), 1, &output);
+    
+    if(x->verbose) post("[hedrot_receiver] : gyroOffsetAutocalTime too long, gyroscope calibration window clamped to %ld samples", x->trackingData->gyroBiasTrackerData->windowLength);
+}
+
+void hedrot_receiver_magDisturbanceNotice(t_hedrot_receiver *x) {
+    t_atom output;
+    
+    atom_setlong(&output, x->trackingData->magDisturbed);
+    outlet_anything( x->x_status_outlet, gensym("magnetic_disturbance"), 1, &output);
+    
+    if(x->verbose) post("[hedrot_receiver] : magnetic disturbance %s", x->trackingData->magDisturbed ? "detected" : "ended");
+}
+
+void hedrot_receiver_idleModeNotice(t_hedrot_receiver *x) {
+    t_atom output;
+    
+    atom_setlong(&output, x->trackingData->idle);
+    outlet_anything( x->x_status_outlet, gensym("idle"), 1, &output);
+    
+    if(x->verbose) post("[hedrot_receiver] : idle mode %s", x->trackingData->idle ? "started" : "ended");
+}
+
 
 void hedrot_receiver_outputReceptionStatus(t_hedrot_receiver *x) {
     t_atom sym[2];
@@ -1048,6 +1192,66 @@ void hedrot_receiver_mirrorHeadtrackerInfo(t_hedrot_receiver *x) {
     x->accLPtimeConstant = x->trackingData->accLPtimeConstant;
     object_attr_touch( (t_object *)x, gensym("accLPtimeConstant"));
     
+    x->initialConvergenceTime = x->trackingData->initialConvergenceTime;
+    object_attr_touch( (t_object *)x, gensym("initialConvergenceTime"));
+    
+    x->magMultirateOn = x->trackingData->magMultirateOn;
+    object_attr_touch( (t_object *)x, gensym("magMultirateOn"));
+    
+    x->magDisturbanceGatingOn = x->trackingData->magDisturbanceGatingOn;
+    object_attr_touch( (t_object *)x, gensym("magDisturbanceGatingOn"));
+    
+    x->magDisturbanceNormThreshold = x->trackingData->magDisturbanceNormThreshold;
+    object_attr_touch( (t_object *)x, gensym("magDisturbanceNormThreshold"));
+    
+    x->magDisturbanceInclinationThreshold = x->trackingData->magDisturbanceInclinationThreshold;
+    object_attr_touch( (t_object *)x, gensym("magDisturbanceInclinationThreshold"));
+    
+    x->idleModeOn = x->trackingData->idleModeOn;
+    object_attr_touch( (t_object *)x, gensym("idleModeOn"));
+    
+    x->idleGyroThreshold = x->trackingData->idleGyroThreshold;
+    object_attr_touch( (t_object *)x, gensym("idleGyroThreshold"));
+    
+    x->idleAccThreshold = x->trackingData->idleAccThreshold;
+    object_attr_touch( (t_object *)x, gensym("idleAccThreshold"));
+    
+    x->idleDecimationFactor = x->trackingData->idleDecimationFactor;
+    object_attr_touch( (t_object *)x, gensym("idleDecimationFactor"));
+    
+    x->idleHeartbeatPeriod = x->trackingData->idleHeartbeatPeriod;
+    object_attr_touch( (t_object *)x, gensym("idleHeartbeatPeriod"));
+    
+    x->deadbandOn = x->trackingData->deadbandOn;
+    object_attr_touch( (t_object *)x, gensym("deadbandOn"));
+    
+    x->deadbandQuaternionAngle = x->trackingData->deadbandQuaternionAngle;
+    object_attr_touch( (t_object *)x, gensym("deadbandQuaternionAngle"));
+    
+    x->deadbandEulerAngle = x->trackingData->deadbandEulerAngle;
+    object_attr_touch( (t_object *)x, gensym("deadbandEulerAngle"));
+    
+    x->deadbandMaxSilence = x->trackingData->deadbandMaxSilence;
+    object_attr_touch( (t_object *)x, gensym("deadbandMaxSilence"));
+    
+    x->outputMask = x->trackingData->outputMask;
+    object_attr_touch( (t_object *)x, gensym("outputMask"));
+    
+    x->gyroIntegrationMethod = x->trackingData->gyroIntegrationMethod;
+    object_attr_touch( (t_object *)x, gensym("gyroIntegrationMethod"));
+    
+    x->ESKFgyroNoise = x->trackingData->ESKFgyroNoise;
+    object_attr_touch( (t_object *)x, gensym("ESKFgyroNoise"));
+    
+    x->ESKFgyroBiasNoise = x->trackingData->ESKFgyroBiasNoise;
+    object_attr_touch( (t_object *)x, gensym("ESKFgyroBiasNoise"));
+    
+    x->ESKFaccNoise = x->trackingData->ESKFaccNoise;
+    object_attr_touch( (t_object *)x, gensym("ESKFaccNoise"));
+    
+    x->ESKFmagNoise = x->trackingData->ESKFmagNoise;
+    object_attr_touch( (t_object *)x, gensym("ESKFmagNoise"));
+    
     x->axesReference = x->trackingData->axesReference;
     object_attr_touch( (t_object *)x, gensym("axesReference"));
     
@@ -1057,6 +1261,24 @@ void hedrot_receiver_mirrorHeadtrackerInfo(t_hedrot_receiver *x) {
     x->invertRotation = x->trackingData->invertRotation;
     object_attr_touch( (t_object *)x, gensym("invertRotation"));
     
+    x->fastAnglesOn = x->trackingData->fastAnglesOn;
+    object_attr_touch( (t_object *)x, gensym("fastAnglesOn"));
+    
+    x->predictionTime = x->trackingData->predictionTime;
+    object_attr_touch( (t_object *)x, gensym("predictionTime"));
+    
+    x->predictionDamping = x->trackingData->predictionDamping;
+    object_attr_touch( (t_object *)x, gensym("predictionDamping"));
+    
+    x->SHrotationOrder = x->trackingData->SHrotationOrder;
+    object_attr_touch( (t_object *)x, gensym("SHrotationOrder"));
+    
+    x->resamplingMethod = x->trackingData->outputPoseHistory->interpolationMethod;
+    object_attr_touch( (t_object *)x, gensym("resamplingMethod"));
+    
+    x->resamplingSmoothingTime = x->trackingData->outputPoseHistory->smoothingTime;
+    object_attr_touch( (t_object *)x, gensym("resamplingSmoothingTime"));
+    
     x->accCalMaxGyroNorm = x->trackingData->accCalMaxGyroNorm;
     object_attr_touch( (t_object *)x, gensym("accCalMaxGyroNorm"));
     
@@ -1208,6 +1430,86 @@ void hedrot_receiver_doopenforwrite(t_hedrot_receiver *x, t_symbol *s) {
     len = strlen(str);
     sysfile_write(x->fh_write, &len, str);
     
+    sprintf(str, "initialConvergenceTime, %f;\n", x->trackingData->initialConvergenceTime);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "magMultirateOn, %d;\n", x->trackingData->magMultirateOn);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "magDisturbanceGatingOn, %d;\n", x->trackingData->magDisturbanceGatingOn);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "magDisturbanceNormThreshold, %f;\n", x->trackingData->magDisturbanceNormThreshold);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "magDisturbanceInclinationThreshold, %f;\n", x->trackingData->magDisturbanceInclinationThreshold);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "idleModeOn, %d;\n", x->trackingData->idleModeOn);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "idleGyroThreshold, %f;\n", x->trackingData->idleGyroThreshold);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "idleAccThreshold, %f;\n", x->trackingData->idleAccThreshold);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "idleDecimationFactor, %ld;\n", x->trackingData->idleDecimationFactor);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "idleHeartbeatPeriod, %f;\n", x->trackingData->idleHeartbeatPeriod);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "deadbandOn, %d;\n", x->trackingData->deadbandOn);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "deadbandQuaternionAngle, %f;\n", x->trackingData->deadbandQuaternionAngle);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "deadbandEulerAngle, %f;\n", x->trackingData->deadbandEulerAngle);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "deadbandMaxSilence, %f;\n", x->trackingData->deadbandMaxSilence);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "estimationMethod, %hhi;\n", x->trackingData->estimationMethod);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "gyroIntegrationMethod, %hhi;\n", x->trackingData->gyroIntegrationMethod);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "ESKFgyroNoise, %f;\n", x->trackingData->ESKFgyroNoise);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "ESKFgyroBiasNoise, %f;\n", x->trackingData->ESKFgyroBiasNoise);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "ESKFaccNoise, %f;\n", x->trackingData->ESKFaccNoise);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "ESKFmagNoise, %f;\n", x->trackingData->ESKFmagNoise);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
     sprintf(str, "axesReference, %hhi;\n", x->trackingData->axesReference);
     len = strlen(str);
     sysfile_write(x->fh_write, &len, str);
@@ -1220,6 +1522,22 @@ void hedrot_receiver_doopenforwrite(t_hedrot_receiver *x, t_symbol *s) {
     len = strlen(str);
     sysfile_write(x->fh_write, &len, str);
     
+    sprintf(str, "fastAnglesOn, %d;\n", x->trackingData->fastAnglesOn);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "predictionTime, %f;\n", x->trackingData->predictionTime);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "predictionDamping, %f;\n", x->trackingData->predictionDamping);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
+    sprintf(str, "SHrotationOrder, %ld;\n", x->trackingData->SHrotationOrder);
+    len = strlen(str);
+    sysfile_write(x->fh_write, &len, str);
+    
     sprintf(str, "accCalMaxGyroNorm, %f;\n", x->trackingData->accCalMaxGyroNorm);
     len = strlen(str);
     sysfile_write(x->fh_write, &len, str);
@@ -1482,6 +1800,24 @@ t_max_err hedrot_receiver_gyroOffsetAutocalThreshold_set(t_hedrot_receiver *x, t
     return MAX_ERR_NONE;
 }
 
+t_max_err hedrot_receiver_gyroOffsetStoreFile_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    char fullfilename[MAX_PATH_CHARS];
+    
+    if (!argc)
+        return MAX_ERR_GENERIC;
+    
+    x->gyroOffsetStoreFile = atom_getsym(argv);
+    
+    if(x->gyroOffsetStoreFile == gensym(""))
+        setGyroOffsetStoreFilename(x->trackingData, "");
+    else {
+        path_toabsolutesystempath( 0, x->gyroOffsetStoreFile->s_name, fullfilename);
+        setGyroOffsetStoreFilename(x->trackingData, fullfilename);
+    }
+    
+    return MAX_ERR_NONE;
+}
+
 
 t_max_err hedrot_receiver_accOffset_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
     int i;
@@ -1552,6 +1888,14 @@ t_max_err hedrot_receiver_estimationMethod_set(t_hedrot_receiver *x, t_object *a
     return MAX_ERR_NONE;
 }
 
+t_max_err hedrot_receiver_gyroIntegrationMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->gyroIntegrationMethod = (char) max(min(atom_getlong(argv),1),0);
+        setGyroIntegrationMethod(x->trackingData, x->gyroIntegrationMethod);
+    }
+    return MAX_ERR_NONE;
+}
+
 
 t_max_err hedrot_receiver_MadgwickBetaGain_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
     if (argc && argv) {
@@ -1579,6 +1923,161 @@ t_max_err hedrot_receiver_accLPtimeConstant_set(t_hedrot_receiver *x, t_object *
     return MAX_ERR_NONE;
 }
 
+t_max_err hedrot_receiver_initialConvergenceTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->initialConvergenceTime = (float) max(atom_getfloat(argv),0);
+        setInitialConvergenceTime(x->trackingData, x->initialConvergenceTime);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_magMultirateOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->magMultirateOn = (unsigned char) max(min(atom_getlong(argv),1),0);
+        setMagMultirateOn(x->trackingData, x->magMultirateOn);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_magDisturbanceGatingOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->magDisturbanceGatingOn = (unsigned char) max(min(atom_getlong(argv),1),0);
+        setMagDisturbanceGatingOn(x->trackingData, x->magDisturbanceGatingOn);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_magDisturbanceNormThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setMagDisturbanceNormThreshold(x->trackingData, (float) atom_getfloat(argv));
+        x->magDisturbanceNormThreshold = x->trackingData->magDisturbanceNormThreshold;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_magDisturbanceInclinationThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setMagDisturbanceInclinationThreshold(x->trackingData, (float) atom_getfloat(argv));
+        x->magDisturbanceInclinationThreshold = x->trackingData->magDisturbanceInclinationThreshold;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_idleModeOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->idleModeOn = (unsigned char) max(min(atom_getlong(argv),1),0);
+        setIdleModeOn(x->trackingData, x->idleModeOn);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_idleGyroThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setIdleGyroThreshold(x->trackingData, (float) atom_getfloat(argv));
+        x->idleGyroThreshold = x->trackingData->idleGyroThreshold;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_idleAccThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setIdleAccThreshold(x->trackingData, (float) atom_getfloat(argv));
+        x->idleAccThreshold = x->trackingData->idleAccThreshold;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_idleDecimationFactor_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setIdleDecimationFactor(x->trackingData, (long) atom_getlong(argv));
+        x->idleDecimationFactor = x->trackingData->idleDecimationFactor;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_idleHeartbeatPeriod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setIdleHeartbeatPeriod(x->trackingData, (float) atom_getfloat(argv));
+        x->idleHeartbeatPeriod = x->trackingData->idleHeartbeatPeriod;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_deadbandOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->deadbandOn = (unsigned char) max(min(atom_getlong(argv),1),0);
+        setDeadbandOn(x->trackingData, x->deadbandOn);
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_deadbandQuaternionAngle_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setDeadbandQuaternionAngle(x->trackingData, (float) atom_getfloat(argv));
+        x->deadbandQuaternionAngle = x->trackingData->deadbandQuaternionAngle;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_deadbandEulerAngle_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setDeadbandEulerAngle(x->trackingData, (float) atom_getfloat(argv));
+        x->deadbandEulerAngle = x->trackingData->deadbandEulerAngle;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_deadbandMaxSilence_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setDeadbandMaxSilence(x->trackingData, (float) atom_getfloat(argv));
+        x->deadbandMaxSilence = x->trackingData->deadbandMaxSilence;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_outputMask_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setOutputMask(x->trackingData, (long) atom_getlong(argv));
+        x->outputMask = x->trackingData->outputMask;
+    }
+    return MAX_ERR_NONE;
+}
+
+t_max_err hedrot_receiver_ESKFgyroNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setESKFgyroNoise(x->trackingData, (float) atom_getfloat(argv));
+        x->ESKFgyroNoise = x->trackingData->ESKFgyroNoise;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_ESKFgyroBiasNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setESKFgyroBiasNoise(x->trackingData, (float) atom_getfloat(argv));
+        x->ESKFgyroBiasNoise = x->trackingData->ESKFgyroBiasNoise;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_ESKFaccNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setESKFaccNoise(x->trackingData, (float) atom_getfloat(argv));
+        x->ESKFaccNoise = x->trackingData->ESKFaccNoise;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_ESKFmagNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setESKFmagNoise(x->trackingData, (float) atom_getfloat(argv));
+        x->ESKFmagNoise = x->trackingData->ESKFmagNoise;
+    }
+    return MAX_ERR_NONE;
+}
+
 t_max_err hedrot_receiver_outputDataPeriod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
     if (argc && argv) {
         x->outputDataPeriod = (long) max(min(atom_getlong(argv),500),1);
@@ -1616,6 +2115,68 @@ t_max_err hedrot_receiver_invertRotation_set(t_hedrot_receiver *x, t_object *att
 }
 
 
+t_max_err hedrot_receiver_fastAnglesOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->fastAnglesOn = (unsigned char) max(min(atom_getlong(argv),1),0);
+        setFastAnglesOn(x->trackingData, x->fastAnglesOn);
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_predictionTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setPredictionTime(x->trackingData, (float) atom_getfloat(argv));
+        x->predictionTime = x->trackingData->predictionTime;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_predictionDamping_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setPredictionDamping(x->trackingData, (float) atom_getfloat(argv));
+        x->predictionDamping = x->trackingData->predictionDamping;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_SHrotationOrder_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setSHrotationOrder(x->trackingData, (long) atom_getlong(argv));
+        x->SHrotationOrder = x->trackingData->SHrotationOrder;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_resamplingMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setResamplingMethod(x->trackingData, (char) atom_getlong(argv));
+        x->resamplingMethod = x->trackingData->outputPoseHistory->interpolationMethod;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_resamplingSmoothingTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        setResamplingSmoothingTime(x->trackingData, (float) atom_getfloat(argv));
+        x->resamplingSmoothingTime = x->trackingData->outputPoseHistory->smoothingTime;
+    }
+    return MAX_ERR_NONE;
+}
+
+
+t_max_err hedrot_receiver_resamplingDelay_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
+    if (argc && argv) {
+        x->resamplingDelay = (float) max(atom_getfloat(argv),0);
+    }
+    return MAX_ERR_NONE;
+}
+
+
 t_max_err hedrot_receiver_accCalMaxGyroNorm_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv) {
     if (argc && argv) {
         x->accCalMaxGyroNorm = (float) max(atom_getfloat(argv),0);
@@ -1810,6 +2371,10 @@ int C74_EXPORT main()
     CLASS_ATTR_ACCESSORS(c, "gyroOffsetAutocalThreshold", NULL, hedrot_receiver_gyroOffsetAutocalThreshold_set);
     CLASS_ATTR_SAVE(c,    "gyroOffsetAutocalThreshold",   0);
     
+    CLASS_ATTR_SYM(c,    "gyroOffsetStoreFile",    0,  t_hedrot_receiver,  gyroOffsetStoreFile);
+    CLASS_ATTR_ACCESSORS(c, "gyroOffsetStoreFile", NULL, hedrot_receiver_gyroOffsetStoreFile_set);
+    CLASS_ATTR_SAVE(c,    "gyroOffsetStoreFile",   0);
+    
     CLASS_ATTR_FLOAT_ARRAY(c,    "accOffset",    0,  t_hedrot_receiver,  accOffset,  3);
     CLASS_ATTR_ACCESSORS(c, "accOffset", NULL, hedrot_receiver_accOffset_set);
     
@@ -1855,10 +2420,15 @@ int C74_EXPORT main()
     
     // angle estimation
     CLASS_ATTR_CHAR(c,    "estimationMethod",    0,  t_hedrot_receiver,  estimationMethod);
-    CLASS_ATTR_ENUMINDEX(c, "estimationMethod", 0, "\"Madgwick\" \"gyroscope-only\"");
+    CLASS_ATTR_ENUMINDEX(c, "estimationMethod", 0, "\"Madgwick\" \"gyroscope-only\" \"Kalman filter\"");
     CLASS_ATTR_ACCESSORS(c, "estimationMethod", NULL, hedrot_receiver_estimationMethod_set);
     CLASS_ATTR_SAVE(c,    "estimationMethod",   0);
     
+    CLASS_ATTR_CHAR(c,    "gyroIntegrationMethod",    0,  t_hedrot_receiver,  gyroIntegrationMethod);
+    CLASS_ATTR_ENUMINDEX(c, "gyroIntegrationMethod", 0, "\"first order\" \"exponential map\"");
+    CLASS_ATTR_ACCESSORS(c, "gyroIntegrationMethod", NULL, hedrot_receiver_gyroIntegrationMethod_set);
+    CLASS_ATTR_SAVE(c,    "gyroIntegrationMethod",   0);
+    
     CLASS_ATTR_FLOAT(c,    "MadgwickBetaGain",    0,  t_hedrot_receiver,  MadgwickBetaGain);
     CLASS_ATTR_ACCESSORS(c, "MadgwickBetaGain", NULL, hedrot_receiver_MadgwickBetaGain_set);
     CLASS_ATTR_SAVE(c,    "MadgwickBetaGain",   0);
@@ -1871,6 +2441,86 @@ int C74_EXPORT main()
     CLASS_ATTR_ACCESSORS(c, "accLPtimeConstant", NULL, hedrot_receiver_accLPtimeConstant_set);
     CLASS_ATTR_SAVE(c,    "accLPtimeConstant",   0);
     
+    CLASS_ATTR_FLOAT(c,    "initialConvergenceTime",    0,  t_hedrot_receiver,  initialConvergenceTime);
+    CLASS_ATTR_ACCESSORS(c, "initialConvergenceTime", NULL, hedrot_receiver_initialConvergenceTime_set);
+    CLASS_ATTR_SAVE(c,    "initialConvergenceTime",   0);
+    
+    CLASS_ATTR_CHAR(c,    "magMultirateOn",    0,  t_hedrot_receiver,  magMultirateOn);
+    CLASS_ATTR_STYLE_LABEL(c, "magMultirateOn", 0, "onoff", "magMultirateOn");
+    CLASS_ATTR_ACCESSORS(c, "magMultirateOn", NULL, hedrot_receiver_magMultirateOn_set);
+    CLASS_ATTR_SAVE(c,    "magMultirateOn",   0);
+    
+    CLASS_ATTR_CHAR(c,    "magDisturbanceGatingOn",    0,  t_hedrot_receiver,  magDisturbanceGatingOn);
+    CLASS_ATTR_STYLE_LABEL(c, "magDisturbanceGatingOn", 0, "onoff", "magDisturbanceGatingOn");
+    CLASS_ATTR_ACCESSORS(c, "magDisturbanceGatingOn", NULL, hedrot_receiver_magDisturbanceGatingOn_set);
+    CLASS_ATTR_SAVE(c,    "magDisturbanceGatingOn",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "magDisturbanceNormThreshold",    0,  t_hedrot_receiver,  magDisturbanceNormThreshold);
+    CLASS_ATTR_ACCESSORS(c, "magDisturbanceNormThreshold", NULL, hedrot_receiver_magDisturbanceNormThreshold_set);
+    CLASS_ATTR_SAVE(c,    "magDisturbanceNormThreshold",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "magDisturbanceInclinationThreshold",    0,  t_hedrot_receiver,  magDisturbanceInclinationThreshold);
+    CLASS_ATTR_ACCESSORS(c, "magDisturbanceInclinationThreshold", NULL, hedrot_receiver_magDisturbanceInclinationThreshold_set);
+    CLASS_ATTR_SAVE(c,    "magDisturbanceInclinationThreshold",   0);
+    
+    CLASS_ATTR_CHAR(c,    "idleModeOn",    0,  t_hedrot_receiver,  idleModeOn);
+    CLASS_ATTR_STYLE_LABEL(c, "idleModeOn", 0, "onoff", "idleModeOn");
+    CLASS_ATTR_ACCESSORS(c, "idleModeOn", NULL, hedrot_receiver_idleModeOn_set);
+    CLASS_ATTR_SAVE(c,    "idleModeOn",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "idleGyroThreshold",    0,  t_hedrot_receiver,  idleGyroThreshold);
+    CLASS_ATTR_ACCESSORS(c, "idleGyroThreshold", NULL, hedrot_receiver_idleGyroThreshold_set);
+    CLASS_ATTR_SAVE(c,    "idleGyroThreshold",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "idleAccThreshold",    0,  t_hedrot_receiver,  idleAccThreshold);
+    CLASS_ATTR_ACCESSORS(c, "idleAccThreshold", NULL, hedrot_receiver_idleAccThreshold_set);
+    CLASS_ATTR_SAVE(c,    "idleAccThreshold",   0);
+    
+    CLASS_ATTR_LONG(c,    "idleDecimationFactor",    0,  t_hedrot_receiver,  idleDecimationFactor);
+    CLASS_ATTR_ACCESSORS(c, "idleDecimationFactor", NULL, hedrot_receiver_idleDecimationFactor_set);
+    CLASS_ATTR_SAVE(c,    "idleDecimationFactor",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "idleHeartbeatPeriod",    0,  t_hedrot_receiver,  idleHeartbeatPeriod);
+    CLASS_ATTR_ACCESSORS(c, "idleHeartbeatPeriod", NULL, hedrot_receiver_idleHeartbeatPeriod_set);
+    CLASS_ATTR_SAVE(c,    "idleHeartbeatPeriod",   0);
+    
+    CLASS_ATTR_CHAR(c,    "deadbandOn",    0,  t_hedrot_receiver,  deadbandOn);
+    CLASS_ATTR_STYLE_LABEL(c, "deadbandOn", 0, "onoff", "deadbandOn");
+    CLASS_ATTR_ACCESSORS(c, "deadbandOn", NULL, hedrot_receiver_deadbandOn_set);
+    CLASS_ATTR_SAVE(c,    "deadbandOn",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "deadbandQuaternionAngle",    0,  t_hedrot_receiver,  deadbandQuaternionAngle);
+    CLASS_ATTR_ACCESSORS(c, "deadbandQuaternionAngle", NULL, hedrot_receiver_deadbandQuaternionAngle_set);
+    CLASS_ATTR_SAVE(c,    "deadbandQuaternionAngle",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "deadbandEulerAngle",    0,  t_hedrot_receiver,  deadbandEulerAngle);
+    CLASS_ATTR_ACCESSORS(c, "deadbandEulerAngle", NULL, hedrot_receiver_deadbandEulerAngle_set);
+    CLASS_ATTR_SAVE(c,    "deadbandEulerAngle",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "deadbandMaxSilence",    0,  t_hedrot_receiver,  deadbandMaxSilence);
+    CLASS_ATTR_ACCESSORS(c, "deadbandMaxSilence", NULL, hedrot_receiver_deadbandMaxSilence_set);
+    CLASS_ATTR_SAVE(c,    "deadbandMaxSilence",   0);
+    
+    CLASS_ATTR_LONG(c,    "outputMask",    0,  t_hedrot_receiver,  outputMask);
+    CLASS_ATTR_ACCESSORS(c, "outputMask", NULL, hedrot_receiver_outputMask_set);
+    CLASS_ATTR_SAVE(c,    "outputMask",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "ESKFgyroNoise",    0,  t_hedrot_receiver,  ESKFgyroNoise);
+    CLASS_ATTR_ACCESSORS(c, "ESKFgyroNoise", NULL, hedrot_receiver_ESKFgyroNoise_set);
+    CLASS_ATTR_SAVE(c,    "ESKFgyroNoise",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "ESKFgyroBiasNoise",    0,  t_hedrot_receiver,  ESKFgyroBiasNoise);
+    CLASS_ATTR_ACCESSORS(c, "ESKFgyroBiasNoise", NULL, hedrot_receiver_ESKFgyroBiasNoise_set);
+    CLASS_ATTR_SAVE(c,    "ESKFgyroBiasNoise",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "ESKFaccNoise",    0,  t_hedrot_receiver,  ESKFaccNoise);
+    CLASS_ATTR_ACCESSORS(c, "ESKFaccNoise", NULL, hedrot_receiver_ESKFaccNoise_set);
+    CLASS_ATTR_SAVE(c,    "ESKFaccNoise",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "ESKFmagNoise",    0,  t_hedrot_receiver,  ESKFmagNoise);
+    CLASS_ATTR_ACCESSORS(c, "ESKFmagNoise", NULL, hedrot_receiver_ESKFmagNoise_set);
+    CLASS_ATTR_SAVE(c,    "ESKFmagNoise",   0);
+    
     CLASS_ATTR_CHAR(c,    "axesReference",    0,  t_hedrot_receiver,  axesReference);
     CLASS_ATTR_ENUMINDEX(c, "axesReference", 0, "\"X->right, Y->back, Z->down\" \"X->right, Y->front, Z->up\" \"X->front, Y->left, Z->up\"");
     CLASS_ATTR_ACCESSORS(c, "axesReference", NULL, hedrot_receiver_axesReference_set);
@@ -1886,6 +2536,36 @@ int C74_EXPORT main()
     CLASS_ATTR_ACCESSORS(c, "invertRotation", NULL, hedrot_receiver_invertRotation_set);
     CLASS_ATTR_SAVE(c,    "invertRotation",   0);
     
+    CLASS_ATTR_CHAR(c,    "fastAnglesOn",    0,  t_hedrot_receiver,  fastAnglesOn);
+    CLASS_ATTR_STYLE_LABEL(c, "fastAnglesOn", 0, "onoff", "fastAnglesOn");
+    CLASS_ATTR_ACCESSORS(c, "fastAnglesOn", NULL, hedrot_receiver_fastAnglesOn_set);
+    CLASS_ATTR_SAVE(c,    "fastAnglesOn",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "predictionTime",    0,  t_hedrot_receiver,  predictionTime);
+    CLASS_ATTR_ACCESSORS(c, "predictionTime", NULL, hedrot_receiver_predictionTime_set);
+    CLASS_ATTR_SAVE(c,    "predictionTime",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "predictionDamping",    0,  t_hedrot_receiver,  predictionDamping);
+    CLASS_ATTR_ACCESSORS(c, "predictionDamping", NULL, hedrot_receiver_predictionDamping_set);
+    CLASS_ATTR_SAVE(c,    "predictionDamping",   0);
+    
+    CLASS_ATTR_LONG(c,    "SHrotationOrder",    0,  t_hedrot_receiver,  SHrotationOrder);
+    CLASS_ATTR_ACCESSORS(c, "SHrotationOrder", NULL, hedrot_receiver_SHrotationOrder_set);
+    CLASS_ATTR_SAVE(c,    "SHrotationOrder",   0);
+    
+    CLASS_ATTR_CHAR(c,    "resamplingMethod",    0,  t_hedrot_receiver,  resamplingMethod);
+    CLASS_ATTR_ENUMINDEX(c, "resamplingMethod", 0, "\"slerp\" \"squad\"");
+    CLASS_ATTR_ACCESSORS(c, "resamplingMethod", NULL, hedrot_receiver_resamplingMethod_set);
+    CLASS_ATTR_SAVE(c,    "resamplingMethod",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "resamplingSmoothingTime",    0,  t_hedrot_receiver,  resamplingSmoothingTime);
+    CLASS_ATTR_ACCESSORS(c, "resamplingSmoothingTime", NULL, hedrot_receiver_resamplingSmoothingTime_set);
+    CLASS_ATTR_SAVE(c,    "resamplingSmoothingTime",   0);
+    
+    CLASS_ATTR_FLOAT(c,    "resamplingDelay",    0,  t_hedrot_receiver,  resamplingDelay);
+    CLASS_ATTR_ACCESSORS(c, "resamplingDelay", NULL, hedrot_receiver_resamplingDelay_set);
+    CLASS_ATTR_SAVE(c,    "resamplingDelay",   0);
+    
     CLASS_ATTR_FLOAT(c,    "accCalMaxGyroNorm",    0,  t_hedrot_receiver,  accCalMaxGyroNorm);
     CLASS_ATTR_ACCESSORS(c, "accCalMaxGyroNorm", NULL, hedrot_receiver_accCalMaxGyroNorm_set);
     CLASS_ATTR_SAVE(c,    "accCalMaxGyroNorm",   0);
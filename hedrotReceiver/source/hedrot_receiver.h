@@ -41,6 +41,8 @@ typedef struct hedrot_receiver
     void			*x_status_outlet;
     void			*x_error_outlet;
     void			*x_debug_outlet;
+    void			*x_predicted_outlet;
+    void			*x_SHrotation_outlet;
     
     
     // general variables about information reception
@@ -70,18 +72,46 @@ typedef struct hedrot_receiver
     unsigned char   magMeasurementMode;
     float           gyroOffsetAutocalTime; // in ms
     long            gyroOffsetAutocalThreshold; //in LSB units
+    t_symbol        *gyroOffsetStoreFile; // file of the stored gyroscope offsets (empty symbol: disabled)
     float           accOffset[3];
     float           accScaling[3];
     float           magOffset[3];
     float           magScaling[3];
     
     char            estimationMethod;
+    char            gyroIntegrationMethod;
     float           MadgwickBetaMax;
     float           MadgwickBetaGain;
     float           accLPtimeConstant;
+    float           initialConvergenceTime;
+    unsigned char   magMultirateOn;
+    unsigned char   magDisturbanceGatingOn;
+    float           magDisturbanceNormThreshold;
+    float           magDisturbanceInclinationThreshold;
+    unsigned char   idleModeOn;
+    float           idleGyroThreshold;
+    float           idleAccThreshold;
+    long            idleDecimationFactor;
+    float           idleHeartbeatPeriod;
+    unsigned char   deadbandOn;
+    float           deadbandQuaternionAngle;
+    float           deadbandEulerAngle;
+    float           deadbandMaxSilence;
+    long            outputMask;
+    float           ESKFgyroNoise;
+    float           ESKFgyroBiasNoise;
+    float           ESKFaccNoise;
+    float           ESKFmagNoise;
     char            axesReference;
     char            rotationOrder;
     char            invertRotation;
+    unsigned char   fastAnglesOn;
+    float           predictionTime;
+    float           predictionDamping;
+    long            SHrotationOrder;
+    char            resamplingMethod;
+    float           resamplingSmoothingTime;
+    float           resamplingDelay; // in ms, 0 = no resampling (the latest sample is output)
     float           accCalMaxGyroNorm;
     char            offlineCalibrationMethod; //0 = double ellipsoid fit, 1 = Aussal
     char            RTmagCalibrationMethod; //0 = direct, 1 = iterative
@@ -94,6 +124,9 @@ typedef struct hedrot_receiver
     // output data
     t_atom          t_estimatedAngles[3];
     t_atom          t_estimatedQuaternion[4];
+    t_atom          t_predictedAngles[3];
+    t_atom          t_predictedQuaternion[4];
+    t_atom          t_SHrotationBand[1+(2*SH_ROTATION_MAX_ORDER+1)*(2*SH_ROTATION_MAX_ORDER+1)]; // degree, then the block (row major)
     
     t_dictionary	*magCalInfoDict;
     t_symbol        *magCalInfoDictName;
@@ -189,6 +222,9 @@ void hedrot_receiver_dumpRTmagCalInfo(t_hedrot_receiver *x);
 void hedrot_receiver_exportRTmagRawCalData(t_hedrot_receiver *x, t_symbol *s);
 void hedrot_receiver_defered_exportRTmagRawCalData(t_hedrot_receiver *x, t_symbol *s);
 
+// stored gyroscope offsets
+void hedrot_receiver_defered_exportGyroOffsetStore(t_hedrot_receiver *x, t_symbol *s);
+
 void hedrot_receiver_output_data(t_hedrot_receiver *x);
 
 
@@ -204,6 +240,7 @@ void hedrot_receiver_mirrorHeadtrackerInfo(t_hedrot_receiver *x);
 void hedrot_receiver_outputCalibrationNotValidNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputGyroCalibrationStartedNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputGyroCalibrationFinishedNotice(t_hedrot_receiver *x);
+void hedrot_receiver_outputGyroCalibrationRestoredNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputMagCalibrationStartedNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputMagCalibrationSucceededNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputMagCalibrationFailedNotice(t_hedrot_receiver *x);
@@ -213,6 +250,9 @@ void hedrot_receiver_outputAccCalibrationFailedNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputAccCalibrationPausedNotice(t_hedrot_receiver *x);
 void hedrot_receiver_outputAccCalibrationResumedNotice(t_hedrot_receiver *x);
 void hedrot_receiver_boardOverloadNotice(t_hedrot_receiver *x);
+void hedrot_receiver_gyroCalibrationWindowClampedNotice(t_hedrot_receiver *x);
+void hedrot_receiver_magDisturbanceNotice(t_hedrot_receiver *x);
+void hedrot_receiver_idleModeNotice(t_hedrot_receiver *x);
 
 
 //getters and setters
@@ -236,6 +276,7 @@ t_max_err hedrot_receiver_magMeasurementMode_set(t_hedrot_receiver *x, t_object
 t_max_err hedrot_receiver_gyroOffsetAutocalOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_gyroOffsetAutocalTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_gyroOffsetAutocalThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_gyroOffsetStoreFile_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 void hedrot_receiver_do_set_gyroOffsetAutocalOn(t_hedrot_receiver *x, char gyroOffsetAutocalOn);
 t_max_err hedrot_receiver_accOffset_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_accScaling_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
@@ -245,12 +286,39 @@ t_max_err hedrot_receiver_outputDataPeriod_set(t_hedrot_receiver *x, t_object *a
 
 
 t_max_err hedrot_receiver_estimationMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_gyroIntegrationMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_MadgwickBetaGain_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_MadgwickBetaMax_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_accLPtimeConstant_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_initialConvergenceTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_magMultirateOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_magDisturbanceGatingOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_magDisturbanceNormThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_magDisturbanceInclinationThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_idleModeOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_idleGyroThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_idleAccThreshold_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_idleDecimationFactor_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_idleHeartbeatPeriod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_deadbandOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_deadbandQuaternionAngle_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_deadbandEulerAngle_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_deadbandMaxSilence_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_outputMask_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_ESKFgyroNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_ESKFgyroBiasNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_ESKFaccNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_ESKFmagNoise_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_axesReference_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_rotationOrder_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_invertRotation_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_fastAnglesOn_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_predictionTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_predictionDamping_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_SHrotationOrder_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_resamplingMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_resamplingSmoothingTime_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
+t_max_err hedrot_receiver_resamplingDelay_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_accCalMaxGyroNorm_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_offlineCalibrationMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
 t_max_err hedrot_receiver_RTmagCalibrationMethod_set(t_hedrot_receiver *x, t_object *attr, long argc, t_atom *argv);
@@ -0,0 +1,244 @@
+//
+//  hedrotJackClient.c
+//
+//  JACK client publishing the head orientation as audio-rate control-voltage (CV) ports
+//
+//  the headtracker is read by a separate thread (headtracker_tick every TICK_PERIOD), while the JACK process callback
+//  interpolates the pose at every sample of the period from the timestamped history of the poses
+//  (headtracker_getBlockPoses, lock-free: the audio thread never waits for the reader thread).
+//  The poses are delayed by a fixed amount (option -d), so that they are interpolated between received frames
+//  instead of extrapolated: the output is jitter-free and aligned to the audio period.
+//
+//  output ports: qw qx qy qz (centered quaternion, W,X,Y,Z) yaw pitch roll (in degrees)
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <jack/jack.h>
+
+#include "libhedrot.h"
+#include "hedrot_comm_protocol.h"
+
+// time constants
+#define TICK_PERIOD             .002 // time period in seconds between two ticks of the reader thread
+#define DEFAULT_DELAY           10 // default delay of the poses, in ms (reception jitter of the headtracker frames)
+
+#define MAX_PERIOD_SIZE         8192 // max JACK period size, in frames
+#define NUMBER_OF_PORTS         7
+
+const char *portNames[NUMBER_OF_PORTS] = {"qw", "qx", "qy", "qz", "yaw", "pitch", "roll"};
+
+//=====================================================================================================
+// structure definition: hedrotJackClient
+//=====================================================================================================
+typedef struct _hedrotJackClient {
+    headtrackerData     *trackingData;
+    
+    jack_client_t       *client;
+    jack_port_t         *ports[NUMBER_OF_PORTS];
+    
+    // used by the audio thread only
+    audioClockMapping   mapping; // JACK frame time -> host time
+    double              delay; // delay of the poses, in frames
+    float               quaternions[4*MAX_PERIOD_SIZE]; // poses of the samples of the current period
+    
+    // used by the reader thread only
+    pthread_t           readerThread;
+} hedrotJackClient;
+
+volatile int running = 1;
+
+
+//=====================================================================================================
+// function process
+//=====================================================================================================
+//
+// JACK process callback (audio thread): one pose per sample of the period
+//
+int process(jack_nframes_t numberOfFrames, void *arg) {
+    hedrotJackClient *x = (hedrotJackClient*) arg;
+    float *buffers[NUMBER_OF_PORTS], *q;
+    jack_nframes_t currentFrames;
+    jack_time_t currentUsecs, nextUsecs;
+    float periodUsecs;
+    jack_nframes_t n;
+    int i;
+    
+    for(i = 0; i < NUMBER_OF_PORTS; i++)
+        buffers[i] = (float*) jack_port_get_buffer(x->ports[i], numberOfFrames);
+    
+    if(numberOfFrames > MAX_PERIOD_SIZE) {
+        for(i = 0; i < NUMBER_OF_PORTS; i++)
+            memset(buffers[i], 0, numberOfFrames * sizeof(float));
+        return 0;
+    }
+    
+    // timestamp of the first frame of the period, converted from the JACK clock to the host clock (get_monotonic_time)
+    if(!jack_get_cycle_times(x->client, &currentFrames, &currentUsecs, &nextUsecs, &periodUsecs))
+        audioClockMapping_update(&x->mapping, currentFrames,
+                                 get_monotonic_time() - (jack_get_time() - currentUsecs) * 1e-6);
+    else
+        currentFrames = jack_last_frame_time(x->client);
+    
+    headtracker_getBlockPoses(x->trackingData, &x->mapping, currentFrames - x->delay, numberOfFrames, 1, x->quaternions);
+    
+    for(n = 0, q = x->quaternions; n < numberOfFrames; n++, q += 4) {
+        buffers[0][n] = q[0];
+        buffers[1][n] = q[1];
+        buffers[2][n] = q[2];
+        buffers[3][n] = q[3];
+        x->trackingData->quaternion2EulerAngles(q[0], q[1], q[2], q[3], buffers[4] + n, buffers[5] + n, buffers[6] + n);
+    }
+    
+    return 0;
+}
+
+
+//=====================================================================================================
+// function readerThreadFunction
+//=====================================================================================================
+//
+// reader thread: receives the data of the headtracker, estimates the orientation and fills the history of the poses
+//
+void *readerThreadFunction(void *arg) {
+    hedrotJackClient *x = (hedrotJackClient*) arg;
+    char messageNumber;
+    
+    while(running) {
+        headtracker_tick(x->trackingData);
+        
+        // process messages to notify
+        while( (messageNumber = pullNotificationMessage(x->trackingData)) ) {
+            switch( messageNumber ) {
+                case NOTIFICATION_MESSAGE_PORT_OPENED:
+                    printf("port %s opened\r\n", x->trackingData->serialcomm->availablePorts[x->trackingData->serialcomm->portNumber]);
+                    break;
+                case NOTIFICATION_MESSAGE_WRONG_FIRMWARE_VERSION:
+                    printf("Wrong Headtracker Firmware Version - expected version: %i - actual version: %i\r\n",HEDROT_FIRMWARE_VERSION,x->trackingData->firmwareVersion);
+                    break;
+                case NOTIFICATION_MESSAGE_HEADTRACKER_STATUS_CHANGED:
+                    printf("new reception status: %d\r\n",x->trackingData->infoReceptionStatus);
+                    break;
+                case NOTIFICATION_MESSAGE_CALIBRATION_NOT_VALID:
+                    printf("calibration not valid\r\n");
+                    break;
+                case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_FINISHED:
+                    printf("gyroscope calibration finished\r\n");
+                    break;
+                case NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED:
+                    // the audio thread reads the poses without lock, it is not stalled by the file access
+                    export_gyroOffsetStore(x->trackingData);
+                    break;
+                case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED:
+                    printf("gyroscope calibration window clamped to %ld samples\r\n", x->trackingData->gyroBiasTrackerData->windowLength);
+                    break;
+                case NOTIFICATION_MESSAGE_BOARD_OVERLOAD:
+                    printf("board too slow, reduce samplerate\r\n");
+                    break;
+            }
+        }
+        
+        usleep((int) (TICK_PERIOD * 1000000));
+    }
+    
+    return NULL;
+}
+
+
+void stop(int signal) {
+    running = 0;
+}
+
+void printUsage() {
+    printf("usage: hedrot_jack [-n client name] [-d delay in ms] [-a axes reference] [-o rotation order] [-i]\r\n");
+    printf("\t-n: name of the JACK client (default: hedrot)\r\n");
+    printf("\t-d: delay of the poses in ms, must cover the reception jitter (default: %d)\r\n", DEFAULT_DELAY);
+    printf("\t-a: axes reference (0: X->right, Y->back, Z->down, 1: X->right, Y->front, Z->up, 2: X->front, Y->left, Z->up)\r\n");
+    printf("\t-o: rotation order of the angles (0: yaw-pitch-roll, 1: roll-pitch-yaw)\r\n");
+    printf("\t-i: invert the rotation\r\n");
+}
+
+
+int main(int argc, const char * argv[]) {
+    hedrotJackClient *x;
+    const char *clientName = "hedrot";
+    double delay = DEFAULT_DELAY;
+    char axesReference = 0, rotationOrder = 0, invertRotation = 0;
+    jack_status_t status;
+    int i;
+    
+    printf("Hedrot JACK client, based on hedrot version %s, compiled on "__DATE__"\r\n", HEDROT_VERSION);
+    printf("Required firmware version %d\r\n", HEDROT_FIRMWARE_VERSION);
+    
+    // arguments
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-n") && i+1 < argc) clientName = argv[++i];
+        else if(!strcmp(argv[i], "-d") && i+1 < argc) delay = atof(argv[++i]);
+        else if(!strcmp(argv[i], "-a") && i+1 < argc) axesReference = (char) atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-o") && i+1 < argc) rotationOrder = (char) atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-i")) invertRotation = 1;
+        else {
+            printUsage();
+            return 1;
+        }
+    }
+    
+    x = (hedrotJackClient*) malloc(sizeof(hedrotJackClient));
+    
+    // headtracker: only the pose history is needed (the outputs are interpolated in the history)
+    x->trackingData = headtracker_new();
+    x->trackingData->serialcomm->baud = 57600;
+    setOutputMask(x->trackingData, OUTPUT_MASK_POSE_HISTORY);
+    setAxesReference(x->trackingData, axesReference);
+    setRotationOrder(x->trackingData, rotationOrder);
+    setInvertRotation(x->trackingData, invertRotation);
+    setGyroOffsetStoreFilename(x->trackingData, "hedrot_gyroOffsets.txt");
+    setAutoDiscover(x->trackingData, 1);
+    setHeadtrackerOn(x->trackingData, 1);
+    
+    // JACK client
+    x->client = jack_client_open(clientName, JackNullOption, &status);
+    if(!x->client) {
+        printf("could not open the JACK client (status 0x%x), is the JACK server running?\r\n", status);
+        headtracker_free(x->trackingData);
+        free(x);
+        return 1;
+    }
+    
+    audioClockMapping_init(&x->mapping, jack_get_sample_rate(x->client));
+    x->delay = delay * .001 * jack_get_sample_rate(x->client);
+    
+    for(i = 0; i < NUMBER_OF_PORTS; i++)
+        x->ports[i] = jack_port_register(x->client, portNames[i], JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+    jack_set_process_callback(x->client, process, x);
+    
+    // reader thread, then audio
+    pthread_create(&x->readerThread, NULL, readerThreadFunction, x);
+    if(jack_activate(x->client)) {
+        printf("could not activate the JACK client\r\n");
+        running = 0;
+    } else {
+        printf("JACK client \"%s\" active, %d Hz, poses delayed by %.1f ms\r\n", jack_get_client_name(x->client),
+               jack_get_sample_rate(x->client), delay);
+    }
+    
+    signal(SIGINT, stop);
+    signal(SIGTERM, stop);
+    
+    while(running)
+        usleep(100000);
+    
+    // clean up
+    jack_client_close(x->client);
+    pthread_join(x->readerThread, NULL);
+    setHeadtrackerOn(x->trackingData, 0);
+    export_gyroOffsetStore(x->trackingData);
+    headtracker_free(x->trackingData);
+    free(x);
+    
+    return 0;
+}
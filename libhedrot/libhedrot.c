@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
 
 #include "libhedrot.h"
 #include "libhedrot_utils.h"
@@ -47,10 +48,67 @@ double get_monotonic_time() {
     QueryPerformanceCounter(&time);
     return time.QuadPart / (double)frequency.QuadPart;
 }
+#else /* #if defined(_WIN32) || defined(_WIN64) */
+#include <time.h>
+double get_monotonic_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
 #endif /* #if defined(_WIN32) || defined(_WIN64) */
 #endif /* #ifdef __MACH__ */
 
 
+// receiver settings accessible by name (see processReceiverSettingPair), same names as the attributes of the Max external
+receiverSetting receiverSettings[] = {
+    {"headtracker_on",                       setHeadtrackerOn,               NULL,                           NULL},
+    {"autoDiscover",                         setAutoDiscover,                NULL,                           NULL},
+    {"gyroOffsetAutocalOn",                  setGyroOffsetAutocalOn,         NULL,                           NULL},
+    {"gyroOffsetAutocalTime",                NULL,                           NULL,                           setGyroOffsetAutocalTime},
+    {"gyroOffsetAutocalThreshold",           NULL,                           setGyroOffsetAutocalThreshold,  NULL},
+    {"estimationMethod",                     setEstimationMethod,            NULL,                           NULL},
+    {"MadgwickBetaGain",                     NULL,                           NULL,                           setMadgwickBetaGain},
+    {"MadgwickBetaMax",                      NULL,                           NULL,                           setMadgwickBetaMax},
+    {"accLPtimeConstant",                    NULL,                           NULL,                           setAccLPtimeConstant},
+    {"initialConvergenceTime",               NULL,                           NULL,                           setInitialConvergenceTime},
+    {"magMultirateOn",                       setMagMultirateOn,              NULL,                           NULL},
+    {"magDisturbanceGatingOn",               setMagDisturbanceGatingOn,      NULL,                           NULL},
+    {"magDisturbanceNormThreshold",          NULL,                           NULL,                           setMagDisturbanceNormThreshold},
+    {"magDisturbanceInclinationThreshold",   NULL,                           NULL,                           setMagDisturbanceInclinationThreshold},
+    {"gyroIntegrationMethod",                setGyroIntegrationMethod,       NULL,                           NULL},
+    {"idleModeOn",                           setIdleModeOn,                  NULL,                           NULL},
+    {"idleGyroThreshold",                    NULL,                           NULL,                           setIdleGyroThreshold},
+    {"idleAccThreshold",                     NULL,                           NULL,                           setIdleAccThreshold},
+    {"idleDecimationFactor",                 NULL,                           setIdleDecimationFactor,        NULL},
+    {"idleHeartbeatPeriod",                  NULL,                           NULL,                           setIdleHeartbeatPeriod},
+    {"deadbandOn",                           setDeadbandOn,                  NULL,                           NULL},
+    {"deadbandQuaternionAngle",              NULL,                           NULL,                           setDeadbandQuaternionAngle},
+    {"deadbandEulerAngle",                   NULL,                           NULL,                           setDeadbandEulerAngle},
+    {"deadbandMaxSilence",                   NULL,                           NULL,                           setDeadbandMaxSilence},
+    {"ESKFgyroNoise",                        NULL,                           NULL,                           setESKFgyroNoise},
+    {"ESKFgyroBiasNoise",                    NULL,                           NULL,                           setESKFgyroBiasNoise},
+    {"ESKFaccNoise",                         NULL,                           NULL,                           setESKFaccNoise},
+    {"ESKFmagNoise",                         NULL,                           NULL,                           setESKFmagNoise},
+    {"axesReference",                        setAxesReference,               NULL,                           NULL},
+    {"rotationOrder",                        setRotationOrder,               NULL,                           NULL},
+    {"invertRotation",                       setInvertRotation,              NULL,                           NULL},
+    {"fastAnglesOn",                         setFastAnglesOn,                NULL,                           NULL},
+    {"predictionTime",                       NULL,                           NULL,                           setPredictionTime},
+    {"predictionDamping",                    NULL,                           NULL,                           setPredictionDamping},
+    {"SHrotationOrder",                      NULL,                           setSHrotationOrder,             NULL},
+    {"resamplingMethod",                     setResamplingMethod,            NULL,                           NULL},
+    {"resamplingSmoothingTime",              NULL,                           NULL,                           setResamplingSmoothingTime},
+    {"accCalMaxGyroNorm",                    NULL,                           NULL,                           setAccCalMaxGyroNorm},
+    {"offlineCalibrationMethod",             setOfflineCalibrationMethod,    NULL,                           NULL},
+    {"RTmagCalibrationMethod",               setRTmagCalibrationMethod,      NULL,                           NULL},
+    {"RTmagCalOn",                           setRTmagCalOn,                  NULL,                           NULL},
+    {"RTmagMaxMemoryDuration",               NULL,                           NULL,                           setRTmagMaxMemoryDuration},
+    {"RTmagMaxDistanceError",                NULL,                           NULL,                           setRTmagMaxDistanceError},
+    {"RTMagCalibrationPeriod",               NULL,                           NULL,                           setRTMagCalibrationPeriod},
+    {NULL,                                   NULL,                           NULL,                           NULL}
+};
+
+
 
 //=====================================================================================================
 // "public" function declarations
@@ -74,16 +132,33 @@ headtrackerData* headtracker_new() {
     trackingData->accCalibrationData = (calibrationData*) malloc(sizeof(calibrationData));
     
     trackingData->RTmagCalibrationData = newRTmagCalData();
+    trackingData->outputPoseHistory = newPoseHistory();
+    trackingData->estimatePoseHistory = newPoseHistory();
+    trackingData->outputSHrotation = newSHrotation();
+    trackingData->gyroBiasTrackerData = newGyroBiasTracker();
+    
+    // timestamps of the frames (read by the resampling functions, possibly from another thread before the first connection)
+    trackingData->sampleCounter = 0;
+    trackingData->sampleTimestamp = 0;
+    trackingData->hostTimeOffset = 0;
+    trackingData->hostTimeOffsetValid = 0;
+    
     trackingData->RTmagCalOn = 0;
     trackingData->RTmagMaxDistanceError = .1f; // 10% distance error compared to the previously calibrated set is allowed
     trackingData->RTMagCalibrationPeriod = .1f; // RT calibration in seconds
     trackingData->RTmagMaxMemoryDuration = 10; // maximum duration of the memory used for calibration step 1, in seconds
+    trackingData->verbose = 0;
+    
+    // output transform settings, needed by headtracker_init (updateOutputTransform)
+    trackingData->axesReference = 0;
+    trackingData->rotationOrder = 0;
+    trackingData->invertRotation = 0;
+    trackingData->fastAnglesOn = 0;
     
     
     headtracker_init(trackingData);
     
     // default values (headtracker)
-    trackingData->verbose = 0;
     trackingData->headtracker_on = 0;
     trackingData->autoDiscover = 0;
     trackingData->samplerate = 1000;
@@ -131,6 +206,9 @@ headtrackerData* headtracker_new() {
     trackingData->gyroOffsetAutocalTime = 2000; //ms
     trackingData->gyroOffsetAutocalThreshold = 200; //LSB
     trackingData->gyroOffsetAutocalOn = 1;
+    trackingData->gyroOffsetStoreFilename[0] = 0;
+    trackingData->gyroOffsetStoreKey[0] = 0;
+    trackingData->numberOfStoredGyroOffsets = 0;
     
     
     // default filter coefficients and internal variables
@@ -138,9 +216,40 @@ headtrackerData* headtracker_new() {
     trackingData->MadgwickBetaMax = 2.5;
     trackingData->MadgwickBetaGain = 1;
     setAccLPtimeConstant(trackingData, .01f); // default time constant 10 ms
-    trackingData->axesReference = 0;
-    trackingData->rotationOrder = 0;
-    trackingData->invertRotation = 0;
+    trackingData->ESKFgyroNoise = .05f;
+    trackingData->ESKFgyroBiasNoise = .0005f;
+    trackingData->ESKFaccNoise = .05f;
+    trackingData->ESKFmagNoise = .1f;
+    trackingData->magMultirateOn = 0;
+    trackingData->initialConvergenceTime = .2f;
+    trackingData->gyroIntegrationMethod = 0;
+    trackingData->magDisturbanceGatingOn = 0;
+    trackingData->magDisturbanceNormThreshold = .1f;
+    trackingData->magDisturbanceInclinationThreshold = 5.0f;
+    resetMagDisturbance(trackingData);
+    trackingData->idleModeOn = 0;
+    trackingData->idleGyroThreshold = .05f;
+    trackingData->idleAccThreshold = .02f;
+    trackingData->idleDecimationFactor = 16;
+    trackingData->idleHeartbeatPeriod = 1.0f;
+    resetIdleMode(trackingData);
+    trackingData->lastIdleOutputTime = 0;
+    trackingData->deadbandOn = 0;
+    setDeadbandQuaternionAngle(trackingData, .1f);
+    trackingData->deadbandEulerAngle = .1f;
+    trackingData->deadbandMaxSilence = 1.0f;
+    trackingData->deadbandPublishedOutputs = 0;
+    trackingData->previousGyroIncrement[0] = 0;
+    trackingData->previousGyroIncrement[1] = 0;
+    trackingData->previousGyroIncrement[2] = 0;
+    resetESKF(trackingData);
+    trackingData->predictionTime = 0;
+    trackingData->predictionDamping = .2f;
+    trackingData->predictionLPalpha = 1 - (float) exp(-trackingData->samplePeriod/PREDICTION_LP_TIME_CONSTANT);
+    trackingData->SHrotationOrder = 0;
+    trackingData->outputMask = OUTPUT_MASK_ALL;
+    trackingData->outputsUpToDate = 0;
+    trackingData->centeredQuaternionUpToDate = 0;
     
     trackingData->gyroOffsetCalibratedState = 0;
     resetGyroOffsetCalibration(trackingData);
@@ -170,7 +279,11 @@ void headtracker_free(headtrackerData* trackingData) {
     free(trackingData->serialcomm);
     free(trackingData->magCalibrationData);
     free(trackingData->accCalibrationData);
-    free(trackingData->serialcomm);
+    freePoseHistory(trackingData->outputPoseHistory);
+    freePoseHistory(trackingData->estimatePoseHistory);
+    freeSHrotation(trackingData->outputSHrotation);
+    freeGyroBiasTracker(trackingData->gyroBiasTrackerData);
+    freeRTmagCalData(trackingData->RTmagCalibrationData);
     free(trackingData);
 }
 
@@ -198,6 +311,7 @@ void headtracker_init(headtrackerData *trackingData) {
     trackingData->qref2 = 0;
     trackingData->qref3 = 0;
     trackingData->qref4 = 0;
+    updateOutputTransform(trackingData);
     
     // init the calibration values
     trackingData->calibrationValid = 0;
@@ -534,6 +648,114 @@ int export_RTmagCalDataRawSamples(headtrackerData *trackingData, char* filename)
 }
 
 
+//=====================================================================================================
+// function export_gyroOffsetStore
+//=====================================================================================================
+//
+// write the stored gyroscope offsets (one per board and samplerate, see storeGyroOffset) in the file
+// gyroOffsetStoreFilename, so that the next sessions can start with them (see import_gyroOffsetStore)
+//
+// blocking file access: never called by headtracker_tick, the front end calls it outside of the output path
+// when notified with NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED, and when the object is released
+//
+// the format for each line is:
+//      key, X Y Z;
+//
+// returns 1 if no error (or if there is nothing to store)
+// returns 0 if error
+//
+int export_gyroOffsetStore(headtrackerData *trackingData) {
+    int i;
+    
+    FILE *fd;
+    
+    if(!trackingData->gyroOffsetStoreFilename[0] || !trackingData->numberOfStoredGyroOffsets) return 1;
+    
+    // open file for writing, returns 0 if it fails
+#if defined(_WIN32) || defined(_WIN64)
+    fopen_s( &fd, trackingData->gyroOffsetStoreFilename, "w");
+#else /* #if defined(_WIN32) || defined(_WIN64) */
+    fd = fopen( trackingData->gyroOffsetStoreFilename, "w");
+#endif /* #if defined(_WIN32) || defined(_WIN64) */
+    
+    if( fd == NULL) {
+        printf("Error: file %s could not be opened for writing", trackingData->gyroOffsetStoreFilename);
+        return 0;
+    }
+    
+    for(i = 0; i < trackingData->numberOfStoredGyroOffsets; i++)
+        fprintf(fd, "%s, %f %f %f;\n", trackingData->gyroOffsetStoreKeys[i],
+                trackingData->gyroOffsetStoreValues[i][0], trackingData->gyroOffsetStoreValues[i][1], trackingData->gyroOffsetStoreValues[i][2]);
+    
+    // close (save) the file, returns 0 if it fails
+    if(fclose(fd)) {
+        printf("Error: file %s could not be closed properly", trackingData->gyroOffsetStoreFilename);
+        return 0;
+    }
+    
+    if(trackingData->verbose) printf("[hedrot] gyroscope offsets stored in %s\r\n", trackingData->gyroOffsetStoreFilename);
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function import_gyroOffsetStore
+//=====================================================================================================
+//
+// read the gyroscope offsets stored in the file gyroOffsetStoreFilename (see export_gyroOffsetStore), they are
+// kept in memory and looked up at the next connection (see restoreGyroOffset)
+//
+// blocking file access: called when the file is set (setGyroOffsetStoreFilename), never by headtracker_tick
+//
+// returns 1 if the file has been read
+// returns 0 if not (no offset stored yet)
+//
+int import_gyroOffsetStore(headtrackerData *trackingData) {
+    char   lineBuffer[200];
+    char   *keyBuffer =  NULL;
+    char   *valueBuffer = NULL;
+    char   *brkt;
+    float  *offset;
+    int    n;
+    
+    FILE *fd;
+    
+    trackingData->numberOfStoredGyroOffsets = 0;
+    
+    if(!trackingData->gyroOffsetStoreFilename[0]) return 0;
+    
+    // open file for reading, returns 0 if it fails (no offset stored yet)
+#if defined(_WIN32) || defined(_WIN64)
+    fopen_s( &fd, trackingData->gyroOffsetStoreFilename, "r");
+#else /* #if defined(_WIN32) || defined(_WIN64) */
+    fd = fopen( trackingData->gyroOffsetStoreFilename, "r");
+#endif /* #if defined(_WIN32) || defined(_WIN64) */
+    
+    if( fd == NULL) {
+        if(trackingData->verbose) printf("[hedrot] no gyroscope offset stored in %s\r\n", trackingData->gyroOffsetStoreFilename);
+        return 0;
+    }
+    
+    while (fgets(lineBuffer, 200, fd) != NULL && trackingData->numberOfStoredGyroOffsets < MAX_NUMBER_OF_STORED_GYRO_OFFSETS) {
+        n = trackingData->numberOfStoredGyroOffsets;
+        offset = trackingData->gyroOffsetStoreValues[n];
+        if((keyBuffer=strtok_r(lineBuffer, ", ", &brkt)) != NULL && strlen(keyBuffer) < GYRO_OFFSET_STORE_KEY_LENGTH
+           && (valueBuffer=strtok_r(NULL, ";", &brkt)) != NULL
+           && sscanf(valueBuffer, "%f %f %f", &offset[0], &offset[1], &offset[2]) == 3) {
+            strcpy(trackingData->gyroOffsetStoreKeys[n], keyBuffer);
+            trackingData->numberOfStoredGyroOffsets++;
+        }
+    }
+    
+    fclose(fd);
+    
+    if(trackingData->verbose) printf("[hedrot] %d gyroscope offset(s) read from %s\r\n", trackingData->numberOfStoredGyroOffsets, trackingData->gyroOffsetStoreFilename);
+    
+    return 1;
+}
+
+
 //=====================================================================================================
 // function calibrateAcc
 //=====================================================================================================
@@ -641,6 +863,8 @@ void headtracker_tick(headtrackerData *trackingData) {
         
         unsigned int i;
         
+        long previousSampleCounter = trackingData->sampleCounter;
+        
         unsigned char message; // for single bytes to be sent to the head tracker
         
         // check if a new scheduled ping is necessary
@@ -724,6 +948,22 @@ void headtracker_tick(headtrackerData *trackingData) {
                 }
             }
         }
+        
+        // if new frames have been received, update the estimation of the offset between the host clock and the headtracker clock
+        // (the frames are read by bursts, the low-pass filter removes the jitter of the reception time)
+        if(trackingData->sampleCounter != previousSampleCounter) {
+            if(trackingData->hostTimeOffsetValid) {
+                trackingData->hostTimeOffset += (1 - exp(-(trackingData->sampleCounter - previousSampleCounter) * trackingData->samplePeriod / HOST_TIME_OFFSET_TIME_CONSTANT))
+                                                * (current_time - trackingData->sampleTimestamp - trackingData->hostTimeOffset);
+            } else {
+                trackingData->hostTimeOffset = current_time - trackingData->sampleTimestamp;
+                trackingData->hostTimeOffsetValid = 1;
+            }
+            
+            // the histories are queried on the host clock
+            poseHistory_setTimeOffset(trackingData->outputPoseHistory, trackingData->hostTimeOffset);
+            poseHistory_setTimeOffset(trackingData->estimatePoseHistory, trackingData->hostTimeOffset);
+        }
     }
 }
 
@@ -821,6 +1061,9 @@ int processInfoFromHeadtracker(headtrackerData *trackingData, int offset, int nu
         return 0;
     }
     
+    // identity of the board in the store of gyroscope offsets (from the calibration received with the settings)
+    getGyroOffsetStoreKey(trackingData, trackingData->gyroOffsetStoreKey);
+    
     pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_SETTINGS_DATA_READY);
     
     return 1;
@@ -835,16 +1078,7 @@ int processInfoFromHeadtracker(headtrackerData *trackingData, int offset, int nu
 // reset the internal variables for the gyro auto calibration
 //
 void resetGyroOffsetCalibration(headtrackerData *trackingData) {
-    trackingData->gyroOffsetAutocalCounter = 0;
-    trackingData->gyroOffsetAutocalMin[0] = 10000000;
-    trackingData->gyroOffsetAutocalMin[1] = 10000000;
-    trackingData->gyroOffsetAutocalMin[2] = 10000000;
-    trackingData->gyroOffsetAutocalMax[0] = -10000000;
-    trackingData->gyroOffsetAutocalMax[1] = -10000000;
-    trackingData->gyroOffsetAutocalMax[2] = -10000000;
-    trackingData->gyroOffsetAutocalSum[0] = 0;
-    trackingData->gyroOffsetAutocalSum[1] = 0;
-    trackingData->gyroOffsetAutocalSum[2] = 0;
+    initGyroBiasTracker(trackingData->gyroBiasTrackerData);
     
     trackingData->gyroOffset[0] = 0;
     trackingData->gyroOffset[1] = 0;
@@ -853,49 +1087,236 @@ void resetGyroOffsetCalibration(headtrackerData *trackingData) {
 
 
 
+//=====================================================================================================
+// function getGyroOffsetStoreKey
+//=====================================================================================================
+//
+// key of the connected headtracker in the store of gyroscope offsets: b<board type>-<fingerprint>@<samplerate>
+// (the offset depends on the sensor, and slightly on the samplerate through the sensor settings)
+//
+// the firmware does not transmit any serial number: the board is identified by a fingerprint (FNV-1a hash) of the
+// accelerometer and magnetometer calibration stored in its EEPROM and received with the settings. The key follows
+// the board from one port to another, and changes when the board is calibrated again (the offset is then calibrated
+// from scratch at the next connection). Limitation: boards of the same type that have never been calibrated (default
+// calibration of the firmware) cannot be told apart and share the same key
+//
+void getGyroOffsetStoreKey(headtrackerData *trackingData, char *key) {
+    float *calibrationData[4];
+    unsigned char *bytes;
+    unsigned long fingerprint = 2166136261UL;
+    int i;
+    size_t n;
+    
+    calibrationData[0] = trackingData->accOffset;
+    calibrationData[1] = trackingData->accScaling;
+    calibrationData[2] = trackingData->magOffset;
+    calibrationData[3] = trackingData->magScaling;
+    
+    for(i = 0; i < 4; i++) {
+        bytes = (unsigned char*) calibrationData[i];
+        for(n = 0; n < 3 * sizeof(float); n++)
+            fingerprint = ((fingerprint ^ bytes[n]) * 16777619UL) & 0xFFFFFFFFUL;
+    }
+    
+    sprintf(key, "b%d-%08lx@%ld", (int) trackingData->sensorBoardType, fingerprint, trackingData->samplerate);
+}
+
+
+//=====================================================================================================
+// function storeGyroOffset
+//=====================================================================================================
+//
+// keep the current gyroscope offset in the store, for the connected board (the line of the board is replaced or added)
+// memory only, can be called from headtracker_tick: the front end is notified to write the file (see export_gyroOffsetStore)
+//
+void storeGyroOffset(headtrackerData *trackingData) {
+    int n;
+    
+    if(!trackingData->gyroOffsetStoreFilename[0] || !trackingData->gyroOffsetStoreKey[0]) return;
+    
+    for(n = 0; n < trackingData->numberOfStoredGyroOffsets; n++)
+        if(!strcmp(trackingData->gyroOffsetStoreKeys[n], trackingData->gyroOffsetStoreKey)) break;
+    
+    if(n == trackingData->numberOfStoredGyroOffsets) {
+        if(n == MAX_NUMBER_OF_STORED_GYRO_OFFSETS) {
+            // store full: the oldest entry is dropped
+            memmove(trackingData->gyroOffsetStoreKeys[0], trackingData->gyroOffsetStoreKeys[1], (n-1) * GYRO_OFFSET_STORE_KEY_LENGTH);
+            memmove(trackingData->gyroOffsetStoreValues[0], trackingData->gyroOffsetStoreValues[1], (n-1) * 3 * sizeof(float));
+            n--;
+        } else {
+            trackingData->numberOfStoredGyroOffsets++;
+        }
+        strcpy(trackingData->gyroOffsetStoreKeys[n], trackingData->gyroOffsetStoreKey);
+    }
+    
+    trackingData->gyroOffsetStoreValues[n][0] = trackingData->gyroOffset[0];
+    trackingData->gyroOffsetStoreValues[n][1] = trackingData->gyroOffset[1];
+    trackingData->gyroOffsetStoreValues[n][2] = trackingData->gyroOffset[2];
+    
+    pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED);
+}
+
+
+//=====================================================================================================
+// function restoreGyroOffset
+//=====================================================================================================
+//
+// look for the gyroscope offset stored for the connected board (memory only, see import_gyroOffsetStore)
+// if there is one, use it as (provisional) offset: the headtracker data is usable from the first frame,
+// while the automatic calibration goes on and replaces it as soon as a still window is found
+//
+// returns 1 if an offset has been found
+// returns 0 if not
+//
+int restoreGyroOffset(headtrackerData *trackingData) {
+    float *offset;
+    int n;
+    
+    if(!trackingData->gyroOffsetStoreFilename[0] || !trackingData->gyroOffsetStoreKey[0]) return 0;
+    
+    for(n = 0; n < trackingData->numberOfStoredGyroOffsets; n++)
+        if(!strcmp(trackingData->gyroOffsetStoreKeys[n], trackingData->gyroOffsetStoreKey)) break;
+    
+    if(n == trackingData->numberOfStoredGyroOffsets) return 0;
+    
+    offset = trackingData->gyroOffsetStoreValues[n];
+    
+    // the window length must be set first, since changing it restarts the estimation
+    updateGyroBiasTrackerWindowLength(trackingData);
+    gyroBiasTracker_setOffset(trackingData->gyroBiasTrackerData, offset);
+    
+    trackingData->gyroOffset[0] = offset[0];
+    trackingData->gyroOffset[1] = offset[1];
+    trackingData->gyroOffset[2] = offset[2];
+    
+    if(trackingData->verbose) printf("[hedrot] stored gyroscope offset for %s: %f %f %f\r\n", trackingData->gyroOffsetStoreKey, offset[0], offset[1], offset[2]);
+    
+    return 1;
+}
+
+
+
+//=====================================================================================================
+// function updateGyroBiasTrackerWindowLength
+//=====================================================================================================
+//
+// set the window of the bias tracker to gyroOffsetAutocalTime ms at the current samplerate (the estimation restarts
+// if it changes). If the tracker had to clamp it (see gyroBiasTracker_setWindowLength), the calibration runs on the
+// shorter window and a notification is sent
+//
+void updateGyroBiasTrackerWindowLength(headtrackerData *trackingData) {
+    long windowLength = (long) (trackingData->gyroOffsetAutocalTime / 1000. * trackingData->samplerate);
+    
+    if(windowLength == trackingData->gyroBiasTrackerData->requestedWindowLength) return;
+    
+    if(gyroBiasTracker_setWindowLength(trackingData->gyroBiasTrackerData, windowLength) < windowLength) {
+        if(trackingData->verbose) printf("[hedrot] gyroscope calibration window clamped to %ld samples\r\n", trackingData->gyroBiasTrackerData->windowLength);
+        pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED);
+    }
+}
+
+
+
 //=====================================================================================================
 // function gyroOffsetCalibration
 //=====================================================================================================
 //
-// calibrate the zero of the gyroscope
+// calibrate the zero of the gyroscope, on a sliding window of gyroOffsetAutocalTime ms (see libhedrot_gyroBiasTracker.c)
+// called for every frame during the whole session, so that the offset follows the drift of the gyroscope
 //
 void gyroOffsetCalibration(headtrackerData *trackingData) {
-    //gyro offset autocalibration
-    // update min, max, sum and counter
-    trackingData->gyroOffsetAutocalMax[0] = max(trackingData->gyroOffsetAutocalMax[0], trackingData->gyroRawData[0]);
-    trackingData->gyroOffsetAutocalMax[1] = max(trackingData->gyroOffsetAutocalMax[1], trackingData->gyroRawData[1]);
-    trackingData->gyroOffsetAutocalMax[2] = max(trackingData->gyroOffsetAutocalMax[2], trackingData->gyroRawData[2]);
-    trackingData->gyroOffsetAutocalMin[0] = min(trackingData->gyroOffsetAutocalMin[0], trackingData->gyroRawData[0]);
-    trackingData->gyroOffsetAutocalMin[1] = min(trackingData->gyroOffsetAutocalMin[1], trackingData->gyroRawData[1]);
-    trackingData->gyroOffsetAutocalMin[2] = min(trackingData->gyroOffsetAutocalMin[2], trackingData->gyroRawData[2]);
-    trackingData->gyroOffsetAutocalSum[0] += trackingData->gyroRawData[0];
-    trackingData->gyroOffsetAutocalSum[1] += trackingData->gyroRawData[1];
-    trackingData->gyroOffsetAutocalSum[2] += trackingData->gyroRawData[2];
-    trackingData->gyroOffsetAutocalCounter++;
-    
-    // if the max-min differences are above the threshold, reset the counter and values
-    if((trackingData->gyroOffsetAutocalMax[0]-trackingData->gyroOffsetAutocalMin[0]>trackingData->gyroOffsetAutocalThreshold)
-       ||(trackingData->gyroOffsetAutocalMax[1]-trackingData->gyroOffsetAutocalMin[1]>trackingData->gyroOffsetAutocalThreshold)
-       ||(trackingData->gyroOffsetAutocalMax[2]-trackingData->gyroOffsetAutocalMin[2]>trackingData->gyroOffsetAutocalThreshold)) {
-        resetGyroOffsetCalibration(trackingData);
+    char state;
+    
+    // the window length follows gyroOffsetAutocalTime and the samplerate (the estimation restarts if it changes)
+    updateGyroBiasTrackerWindowLength(trackingData);
+    
+    state = gyroBiasTracker_update(trackingData->gyroBiasTrackerData, trackingData->gyroRawData, trackingData->gyroOffsetAutocalThreshold);
+    
+    // use the estimated offset as soon as there is one, even provisional
+    if(state != GYRO_BIAS_TRACKER_NO_ESTIMATE) {
+        trackingData->gyroOffset[0] = trackingData->gyroBiasTrackerData->offset[0];
+        trackingData->gyroOffset[1] = trackingData->gyroBiasTrackerData->offset[1];
+        trackingData->gyroOffset[2] = trackingData->gyroBiasTrackerData->offset[2];
     }
     
-    // check if there are enough stable samples. If yes, update the offsets and the "calibrate" flag
-    if(trackingData->gyroOffsetAutocalCounter >= (trackingData->gyroOffsetAutocalTime / 1000. * trackingData->samplerate) ) {
-        trackingData->gyroOffset[0] = (trackingData->gyroOffsetAutocalSum[0] * 1.0f)/ trackingData->gyroOffsetAutocalCounter;
-        trackingData->gyroOffset[1] = (trackingData->gyroOffsetAutocalSum[1] * 1.0f)/ trackingData->gyroOffsetAutocalCounter;
-        trackingData->gyroOffset[2] = (trackingData->gyroOffsetAutocalSum[2] * 1.0f)/ trackingData->gyroOffsetAutocalCounter;
+    // the calibration is done when the first still window has been found
+    if(state == GYRO_BIAS_TRACKER_CALIBRATED && trackingData->gyroOffsetCalibratedState == 1)
         trackingData->gyroOffsetCalibratedState = 2;
-    }
 }
 
 
 void headtracker_compute_data(headtrackerData *trackingData) {
+    short magRawData[3], accRawData[3], gyroRawData[3];
+    
+    convert_7bytes_to_3int16(trackingData->rawDataBuffer,0,magRawData);
+    convert_7bytes_to_3int16(trackingData->rawDataBuffer,7,accRawData);
+    convert_7bytes_to_3int16(trackingData->rawDataBuffer,14,gyroRawData);
+    
+    headtracker_compute_rawData(trackingData, magRawData, accRawData, gyroRawData);
+}
+
+
+//=====================================================================================================
+// function headtracker_compute_rawData
+//=====================================================================================================
+//
+// process one frame of raw data (calibration, estimation, outputs), received from the headtracker or replayed from a
+// recording (see libhedrot_recording)
+//
+void headtracker_compute_rawData(headtrackerData *trackingData, short *magRawData, short *accRawData, short *gyroRawData) {
     short RTmagCalres;
+    short previousMagRawData[3];
+    float gyroCalData[3], samplePeriod;
+    char still;
+    
+    previousMagRawData[0] = trackingData->magRawData[0];
+    previousMagRawData[1] = trackingData->magRawData[1];
+    previousMagRawData[2] = trackingData->magRawData[2];
+    
+    // timestamp of the frame on the headtracker clock
+    if(trackingData->sampleCounter)
+        trackingData->sampleTimestamp += trackingData->samplePeriod;
+    else
+        trackingData->sampleTimestamp = 0;
+    trackingData->sampleCounter++;
+    
+    trackingData->magRawData[0] = magRawData[0];
+    trackingData->magRawData[1] = magRawData[1];
+    trackingData->magRawData[2] = magRawData[2];
+    trackingData->accRawData[0] = accRawData[0];
+    trackingData->accRawData[1] = accRawData[1];
+    trackingData->accRawData[2] = accRawData[2];
+    trackingData->gyroRawData[0] = gyroRawData[0];
+    trackingData->gyroRawData[1] = gyroRawData[1];
+    trackingData->gyroRawData[2] = gyroRawData[2];
+    
+    // the headtracker repeats the last magnetometer sample until the magnetometer provides a new one
+    // => a new magnetometer sample is detected when the raw value changes
+    // (the frames carry no magnetometer counter: a new sample identical to the previous one is taken as repeated, its
+    // fusion is then delayed until the next sample that differs)
+    trackingData->magDataFresh = (trackingData->magRawData[0] != previousMagRawData[0])
+                                || (trackingData->magRawData[1] != previousMagRawData[1])
+                                || (trackingData->magRawData[2] != previousMagRawData[2]);
+    if(trackingData->magDataFresh) {
+        trackingData->magHoldLength = max(trackingData->magFramesSinceUpdate, 1);
+        trackingData->magFramesSinceUpdate = 1;
+    } else if(trackingData->magFramesSinceUpdate < MAX_MAG_HOLD_LENGTH) {
+        trackingData->magFramesSinceUpdate++;
+    }
     
-    convert_7bytes_to_3int16(trackingData->rawDataBuffer,0,trackingData->magRawData);
-    convert_7bytes_to_3int16(trackingData->rawDataBuffer,7,trackingData->accRawData);
-    convert_7bytes_to_3int16(trackingData->rawDataBuffer,14,trackingData->gyroRawData);
+    // first frame of the gyro calibration: start it now, before the gyro data is scaled, so that the offset restored
+    // from the previous session already applies to this frame
+    if(trackingData->gyroOffsetAutocalOn && trackingData->gyroOffsetCalibratedState == 0) {
+        trackingData->gyroOffsetCalibratedState = 1;
+        
+        if(restoreGyroOffset(trackingData)) {
+            // start with the offset of the previous session, the calibration goes on in the background
+            pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_GYRO_CALIBRATION_RESTORED);
+        } else {
+            // send a message to the output to ask the user to stay still while calibrating the gyro
+            pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_GYRO_CALIBRATION_STARTED);
+        }
+    }
     
     //scale the gyro data
     trackingData->gyroCalData[0] = (trackingData->gyroRawData[0]-trackingData->gyroOffset[0]) * trackingData->gyroscopeCalibrationFactor;
@@ -905,9 +1326,10 @@ void headtracker_compute_data(headtrackerData *trackingData) {
     // angle estimation
     if(trackingData->calibrationValid) {
         // if the real-time calibration of the magnetometer is on and if the counter reaches 0, update it
+        // (the points acquired while the magnetic field is disturbed are skipped)
         if(trackingData->RTmagCalOn) {
             trackingData->RTMagCalAcquisitionRateCounter--;
-            if(!trackingData->RTMagCalAcquisitionRateCounter) {
+            if(!trackingData->RTMagCalAcquisitionRateCounter && !(trackingData->magDisturbanceGatingOn && trackingData->magDisturbed)) {
                 trackingData->RTMagCalAcquisitionRateCounter = trackingData->RTMagCalAcquisitionRateFactor;
                 
                 if(trackingData->RTmagCalibrationMethod)
@@ -920,34 +1342,85 @@ void headtracker_compute_data(headtrackerData *trackingData) {
                 //  2: point added, calibration failed
                 //  3: point added, calibration succeeded
                 
-                if(RTmagCalres >= 3)
+                if(RTmagCalres >= 3) {
                     pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_MAG_RT_CALIBRATION_SUCCEEDED);
+                    
+                    // the calibrated field changes with the new calibration: new references for the disturbance detection
+                    trackingData->magDisturbanceReferenceValid = 0;
+                }
             }
         }
         
-        //compute cooked data and angles only if calibration is valid
-        switch( trackingData->estimationMethod) {
-            case 0: // 0 = Madgwick 9 Axes
-                MadgwickAHRSupdateModified(trackingData);
-                break;
-            case 1: // 1 = gyroscope integration only (no magnetometer)
-                GyroscopeIntegrationUpdate(trackingData);
-                break;
+        // 9 axes methods: start directly from the attitude given by the accelerometer and the magnetometer
+        if(!trackingData->attitudeInitialized && trackingData->estimationMethod != 1)
+            initializeAttitude(trackingData);
+        
+        // idle mode: while the headtracker is still, the estimation runs once every idleDecimationFactor frames
+        // with the mean angular rate of these frames, and again at every frame from the first movement on
+        still = updateStillness(trackingData);
+        trackingData->estimationUpdated = 1;
+        
+        if(trackingData->idle) {
+            trackingData->idleGyroSum[0] += trackingData->gyroCalData[0];
+            trackingData->idleGyroSum[1] += trackingData->gyroCalData[1];
+            trackingData->idleGyroSum[2] += trackingData->gyroCalData[2];
+            trackingData->idleMagDataFresh |= trackingData->magDataFresh;
+            trackingData->idleFrameCounter++;
+            
+            if(trackingData->idleFrameCounter >= trackingData->idleDecimationFactor || !still || !trackingData->idleModeOn) {
+                // one estimation step covering all the frames since the last one
+                gyroCalData[0] = trackingData->gyroCalData[0];
+                gyroCalData[1] = trackingData->gyroCalData[1];
+                gyroCalData[2] = trackingData->gyroCalData[2];
+                samplePeriod = trackingData->samplePeriod;
+                
+                trackingData->gyroCalData[0] = trackingData->idleGyroSum[0] / trackingData->idleFrameCounter;
+                trackingData->gyroCalData[1] = trackingData->idleGyroSum[1] / trackingData->idleFrameCounter;
+                trackingData->gyroCalData[2] = trackingData->idleGyroSum[2] / trackingData->idleFrameCounter;
+                trackingData->samplePeriod = samplePeriod * trackingData->idleFrameCounter;
+                trackingData->magDataFresh = trackingData->idleMagDataFresh;
+                
+                updateOrientation(trackingData);
+                
+                trackingData->gyroCalData[0] = gyroCalData[0];
+                trackingData->gyroCalData[1] = gyroCalData[1];
+                trackingData->gyroCalData[2] = gyroCalData[2];
+                trackingData->samplePeriod = samplePeriod;
+                
+                trackingData->idleGyroSum[0] = 0;
+                trackingData->idleGyroSum[1] = 0;
+                trackingData->idleGyroSum[2] = 0;
+                trackingData->idleMagDataFresh = 0;
+                trackingData->idleFrameCounter = 0;
+            } else {
+                trackingData->estimationUpdated = 0;
+            }
+            
+            // back to full rate
+            if(!still || !trackingData->idleModeOn) {
+                trackingData->idle = 0;
+                pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_IDLE_MODE_ENDED);
+            }
+        } else {
+            updateOrientation(trackingData);
+            
+            // switch to idle mode after IDLE_MODE_DELAY seconds of stillness (not before the initialization of the attitude
+            // nor during the high-gain phase of the Madgwick filter)
+            if(trackingData->idleModeOn && trackingData->stillDuration >= IDLE_MODE_DELAY
+               && (trackingData->attitudeInitialized || trackingData->estimationMethod == 1)
+               && (trackingData->initialConvergenceCounter <= 0 || trackingData->estimationMethod != 0)) {
+                trackingData->idle = 1;
+                pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_IDLE_MODE_STARTED);
+            }
         }
         
+        // angular acceleration, needed to extrapolate the estimated orientation (latency compensation)
+        updateAngularAcceleration(trackingData);
     }
     
     // check if the gyro calibration is done
     if(trackingData->gyroOffsetAutocalOn) {
         switch(trackingData->gyroOffsetCalibratedState) {
-            case 0:
-                // gyro calibration not started yet, start it now
-                trackingData->gyroOffsetCalibratedState = 1;
-                gyroOffsetCalibration(trackingData);
-                
-                // send a message to the output to ask the user to stay still while calibrating the gyro
-                pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_GYRO_CALIBRATION_STARTED);
-                break;
             case 1:
                 gyroOffsetCalibration(trackingData);
                 break;
@@ -955,9 +1428,16 @@ void headtracker_compute_data(headtrackerData *trackingData) {
                 // the calibration is finished
                 trackingData->gyroOffsetCalibratedState = 3;
                 
+                // store it for the next sessions
+                storeGyroOffset(trackingData);
+                
                 // send a message to the output to notify that the calibration is finished
                 pushNotificationMessage(trackingData, NOTIFICATION_MESSAGE_GYRO_CALIBRATION_FINISHED);
                 break;
+            case 3:
+                // calibrated: keep tracking the offset (temperature drift)
+                gyroOffsetCalibration(trackingData);
+                break;
         }
     }
     
@@ -1005,101 +1485,408 @@ void headtracker_compute_data(headtrackerData *trackingData) {
         }
     }
     
-    // center according to reference1
-    quaternionComposition(trackingData->qref1, trackingData->qref2, trackingData->qref3, trackingData->qref4,
-                          trackingData->q1, trackingData->q2, trackingData->q3, trackingData->q4,
-                          &trackingData->qcent1, &trackingData->qcent2, &trackingData->qcent3, &trackingData->qcent4);
+    // the outputs derived from the estimated quaternion (centered quaternion, angles, prediction) are not computed here
+    // but on demand by headtracker_updateOutputs, i.e. once per read instead of once per frame
+    // (in idle mode, they stay up to date as long as the estimation is skipped)
+    if(trackingData->estimationUpdated) {
+        trackingData->outputsUpToDate = 0;
+        trackingData->centeredQuaternionUpToDate = 0;
+    }
     
-    // change the axes references of the quaternion if it does not fit the standard (X->right, Y->back, Z->down)
-    changeQuaternionReference(trackingData);
+    // the history needs the centered quaternion of every frame (but not the angles)
+    if(trackingData->outputMask & OUTPUT_MASK_POSE_HISTORY) {
+        if(!trackingData->centeredQuaternionUpToDate) {
+            computeOutputQuaternion(trackingData, trackingData->q1, trackingData->q2, trackingData->q3, trackingData->q4,
+                                    &trackingData->qcent1, &trackingData->qcent2, &trackingData->qcent3, &trackingData->qcent4);
+            trackingData->centeredQuaternionUpToDate = 1;
+        }
+        
+        poseHistory_addPose(trackingData->outputPoseHistory, trackingData->sampleTimestamp,
+                            trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4);
+    }
     
+    if(trackingData->outputMask & OUTPUT_MASK_ESTIMATE_HISTORY)
+        poseHistory_addPose(trackingData->estimatePoseHistory, trackingData->sampleTimestamp,
+                            trackingData->q1, trackingData->q2, trackingData->q3, trackingData->q4);
+}
+
+
+//=====================================================================================================
+// function headtracker_updateOutputs
+//=====================================================================================================
+//
+// compute the outputs requested by outputMask (centered quaternion, angles, predicted quaternion and angles,
+// spherical harmonic rotation matrices) for the latest frame
+// should be called by the consumers before reading them. Does nothing if they are already up to date, so that
+// the euler angles and the prediction are computed at the rate of the consumers instead of the headtracker samplerate
+//
+void headtracker_updateOutputs(headtrackerData *trackingData) {
+    if(trackingData->outputsUpToDate) return;
     
-    // invert rotation if requested
-    if(trackingData->invertRotation) {
-        trackingData->qcent2 = - trackingData->qcent2;
-        trackingData->qcent3 = - trackingData->qcent3;
-        trackingData->qcent4 = - trackingData->qcent4;
+    // centered quaternion
+    if(!trackingData->centeredQuaternionUpToDate
+       && (trackingData->outputMask & (OUTPUT_MASK_QUATERNION | OUTPUT_MASK_ANGLES | OUTPUT_MASK_PREDICTION | OUTPUT_MASK_SH_ROTATION))) {
+        computeOutputQuaternion(trackingData, trackingData->q1, trackingData->q2, trackingData->q3, trackingData->q4,
+                                &trackingData->qcent1, &trackingData->qcent2, &trackingData->qcent3, &trackingData->qcent4);
+        trackingData->centeredQuaternionUpToDate = 1;
     }
     
-    // compute euler angles
-    switch(trackingData->rotationOrder) {
-        case 0:
-            quaternion2YawPitchRoll(trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4, &trackingData->yaw, &trackingData->pitch, &trackingData->roll);
-            break;
-        case 1:
-            quaternion2RollPitchYaw(trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4, &trackingData->yaw, &trackingData->pitch, &trackingData->roll);
-            break;
+    // angles
+    if(trackingData->outputMask & OUTPUT_MASK_ANGLES)
+        trackingData->quaternion2EulerAngles(trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4,
+                                             &trackingData->yaw, &trackingData->pitch, &trackingData->roll);
+    
+    // predicted quaternion and angles
+    if(trackingData->outputMask & OUTPUT_MASK_PREDICTION) {
+        if(trackingData->predictionTime > 0) {
+            predictOrientation(trackingData);
+            computeOutputQuaternion(trackingData, trackingData->qpred1, trackingData->qpred2, trackingData->qpred3, trackingData->qpred4,
+                                    &trackingData->qpred1, &trackingData->qpred2, &trackingData->qpred3, &trackingData->qpred4);
+            if(trackingData->outputMask & OUTPUT_MASK_ANGLES)
+                trackingData->quaternion2EulerAngles(trackingData->qpred1, trackingData->qpred2, trackingData->qpred3, trackingData->qpred4,
+                                                     &trackingData->predictedYaw, &trackingData->predictedPitch, &trackingData->predictedRoll);
+        } else {
+            trackingData->qpred1 = trackingData->qcent1;
+            trackingData->qpred2 = trackingData->qcent2;
+            trackingData->qpred3 = trackingData->qcent3;
+            trackingData->qpred4 = trackingData->qcent4;
+            trackingData->predictedYaw = trackingData->yaw;
+            trackingData->predictedPitch = trackingData->pitch;
+            trackingData->predictedRoll = trackingData->roll;
+        }
     }
     
+    // spherical harmonic rotation matrices
+    if((trackingData->outputMask & OUTPUT_MASK_SH_ROTATION) && trackingData->SHrotationOrder > 0)
+        SHrotation_update(trackingData->outputSHrotation, trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4);
+    
+    trackingData->outputsUpToDate = 1;
 }
 
 
 //=====================================================================================================
-// function convert_7bytes_to_3int16
+// function headtracker_outputDue
 //=====================================================================================================
 //
-// decode the raw data flow from the headtracker
+// tells the consumers which outputs should be published at host time hostTime (in seconds, see get_monotonic_time),
+// when the published pose is the latest one (qcent, yaw, pitch, roll). See headtracker_outputDueForPose
 //
-void convert_7bytes_to_3int16(unsigned char *rawDataBuffer,int baseIndex,short *rawDataToSend) {
-    // for each sensor with values vx, vy, vz in 16 bits:
-    // each of the 7 bytes starts with the bit 1 (it's a unique marker of raw data info)
-    // 1/vx_1-vx_7
-    // 1/vx_8-vx_14
-    // 1/vx_15/vx_16/vy_1-vy_5
-    // 1/vy_6-vx_12
-    // 1/vy_13-vy_16/vz_1-vz_3
-    // 1/vz_4-vy_10
-    // 1/vz_11-vy_16/0
-    rawDataToSend[0] = ((rawDataBuffer[baseIndex]&127)<<9) + ((rawDataBuffer[baseIndex+1]&127)<<2) + ((rawDataBuffer[baseIndex+2]&127)>>5);
-    rawDataToSend[1] = ((rawDataBuffer[baseIndex+2]&31)<<11) + ((rawDataBuffer[baseIndex+3]&127)<<4) + ((rawDataBuffer[baseIndex+4]&127)>>3);
-    rawDataToSend[2] = ((rawDataBuffer[baseIndex+4]&7)<<13) + ((rawDataBuffer[baseIndex+5]&127)<<6) + ((rawDataBuffer[baseIndex+6]&127)>>1);
+// the outputs are updated (headtracker_updateOutputs) if the deadband is on
+//
+long headtracker_outputDue(headtrackerData *trackingData, double hostTime) {
+    if(trackingData->deadbandOn) headtracker_updateOutputs(trackingData);
+    
+    return headtracker_outputDueForPose(trackingData, hostTime,
+                                        trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4,
+                                        trackingData->yaw, trackingData->pitch, trackingData->roll);
 }
 
 
 //=====================================================================================================
-// function MadgwickAHRSupdateModified
+// function headtracker_outputDueForPose
 //=====================================================================================================
 //
-// AHRS algorithm update
+// tells the consumers which outputs should be published at host time hostTime (in seconds, see get_monotonic_time),
+// when the published pose is (q1, q2, q3, q4) and (yaw, pitch, roll), e.g. a pose from headtracker_getResampledPose.
+// returns an output mask (subset of outputMask, 0 if nothing has to be published):
+//  - in idle mode, nothing is due between two heartbeats (once every idleHeartbeatPeriod seconds)
+//    (the first output after the end of the idle mode is thus sent without delay)
+//  - if deadbandOn is set, the quaternion and the angles are only due when they changed by more than
+//    deadbandQuaternionAngle / deadbandEulerAngle since they were last published; the prediction and the spherical
+//    harmonic rotation matrices (always derived from the latest frame) when the corresponding quaternion changed by more
+//    than deadbandQuaternionAngle. Any output is also due after deadbandMaxSilence seconds without publication.
+//    The outputs found due are considered as published
 //
-// Modified version of Madgwick's angle estimation algorithm
-// See: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
-// Main modifications:
-//  . low-pass filter applied to accelerometer data, with variable time constant depending on the movement (gyroscope activity)
-//  . beta coefficient (balance between gyroscope and accel/compass incremental estimation) made variable, depending on the movement (gyroscope activity)
+// the caller must have updated the outputs (headtracker_updateOutputs) if the deadband is on
 //
-//=====================================================================================================
-char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
-    float recipNorm;
-    float s1, s2, s3, s4;
-    float qDot1, qDot2, qDot3, qDot4;
-    float hx, hy;
-    float _2q1mx, _2q1my, _2q1mz, _2q2mx, _2bx, _2bz, _4bx, _4bz, _2q1, _2q2, _2q3, _2q4, _2q1q3, _2q3q4, q1q1, q1q2, q1q3, q1q4, q2q2, q2q3, q2q4, q3q3, q3q4, q4q4;
-    float a_norm2,m_norm2, gyro_norm2;
+long headtracker_outputDueForPose(headtrackerData *trackingData, double hostTime, float q1, float q2, float q3, float q4, float yaw, float pitch, float roll) {
+    long outputsDue = trackingData->outputMask;
     
-    float accDataNorm[3], magDataNorm[3];
-    
-    //scale mag data
-    if(trackingData->RTmagCalOn) {
-        trackingData->magCalData[0]=(trackingData->magRawData[0]-trackingData->RTmagCalibrationData->estimatedOffset[0]) * trackingData->RTmagCalibrationData->estimatedScalingFactor[0];
-        trackingData->magCalData[1]=(trackingData->magRawData[1]-trackingData->RTmagCalibrationData->estimatedOffset[1]) * trackingData->RTmagCalibrationData->estimatedScalingFactor[1];
-        trackingData->magCalData[2]=(trackingData->magRawData[2]-trackingData->RTmagCalibrationData->estimatedOffset[2]) * trackingData->RTmagCalibrationData->estimatedScalingFactor[2];
-    } else {
-        trackingData->magCalData[0]=(trackingData->magRawData[0]-trackingData->magOffset[0]) * trackingData->magScalingFactor[0];
-        trackingData->magCalData[1]=(trackingData->magRawData[1]-trackingData->magOffset[1]) * trackingData->magScalingFactor[1];
-        trackingData->magCalData[2]=(trackingData->magRawData[2]-trackingData->magOffset[2]) * trackingData->magScalingFactor[2];
+    if(trackingData->idle) {
+        if(hostTime - trackingData->lastIdleOutputTime < trackingData->idleHeartbeatPeriod) return 0;
+        trackingData->lastIdleOutputTime = hostTime;
     }
     
-    //scale acc data
-    trackingData->accCalData[0]=(trackingData->accRawData[0]-trackingData->accOffset[0]) * trackingData->accScalingFactor[0];
-    trackingData->accCalData[1]=(trackingData->accRawData[1]-trackingData->accOffset[1]) * trackingData->accScalingFactor[1];
-    trackingData->accCalData[2]=(trackingData->accRawData[2]-trackingData->accOffset[2]) * trackingData->accScalingFactor[2];
+    if(!trackingData->deadbandOn) return outputsDue;
     
+    if((outputsDue & OUTPUT_MASK_QUATERNION)
+       && !deadbandQuaternionDue(trackingData, OUTPUT_MASK_QUATERNION, trackingData->publishedQuaternion,
+                                 q1, q2, q3, q4, &trackingData->quaternionPublicationTime, hostTime))
+        outputsDue &= ~OUTPUT_MASK_QUATERNION;
     
-    // compute the squared norm of the gyro data => rough estimation of the movement
-    gyro_norm2 = trackingData->gyroCalData[0] * trackingData->gyroCalData[0]
-    + trackingData->gyroCalData[1] * trackingData->gyroCalData[1]
-    + trackingData->gyroCalData[2] * trackingData->gyroCalData[2];
+    if((outputsDue & OUTPUT_MASK_ANGLES)
+       && !deadbandAnglesDue(trackingData, OUTPUT_MASK_ANGLES, trackingData->publishedAngles, yaw, pitch, roll,
+                             &trackingData->anglesPublicationTime, hostTime))
+        outputsDue &= ~OUTPUT_MASK_ANGLES;
+    
+    // the predicted angles are published with the predicted quaternion
+    if((outputsDue & OUTPUT_MASK_PREDICTION)
+       && !deadbandQuaternionDue(trackingData, OUTPUT_MASK_PREDICTION, trackingData->publishedPredictedQuaternion,
+                                 trackingData->qpred1, trackingData->qpred2, trackingData->qpred3, trackingData->qpred4,
+                                 &trackingData->predictionPublicationTime, hostTime))
+        outputsDue &= ~OUTPUT_MASK_PREDICTION;
+    
+    // the matrices are derived from the centered quaternion, but have their own publication state
+    if((outputsDue & OUTPUT_MASK_SH_ROTATION)
+       && !deadbandQuaternionDue(trackingData, OUTPUT_MASK_SH_ROTATION, trackingData->publishedSHrotationQuaternion,
+                                 trackingData->qcent1, trackingData->qcent2, trackingData->qcent3, trackingData->qcent4,
+                                 &trackingData->SHrotationPublicationTime, hostTime))
+        outputsDue &= ~OUTPUT_MASK_SH_ROTATION;
+    
+    trackingData->deadbandPublishedOutputs |= outputsDue;
+    
+    return outputsDue;
+}
+
+
+//=====================================================================================================
+// function deadbandQuaternionDue
+//=====================================================================================================
+//
+// returns 1 if the quaternion (q1, q2, q3, q4) of the output "output" (see output mask) must be published: first
+// publication, rotation angle from the published quaternion larger than deadbandQuaternionAngle, or no publication for
+// deadbandMaxSilence seconds.
+// In this case, the quaternion and the time are stored as published
+//
+char deadbandQuaternionDue(headtrackerData *trackingData, long output, float *publishedQuaternion, float q1, float q2, float q3, float q4, double *publicationTime, double hostTime) {
+    float dotProduct, normProduct, cosHalfAngle = 0;
+    
+    // (normalised here: the estimated quaternion is only normalised with a fast approximation, too coarse for small thresholds)
+    dotProduct = q1 * publishedQuaternion[0] + q2 * publishedQuaternion[1] + q3 * publishedQuaternion[2] + q4 * publishedQuaternion[3];
+    normProduct = (q1 * q1 + q2 * q2 + q3 * q3 + q4 * q4)
+                * (publishedQuaternion[0] * publishedQuaternion[0] + publishedQuaternion[1] * publishedQuaternion[1]
+                   + publishedQuaternion[2] * publishedQuaternion[2] + publishedQuaternion[3] * publishedQuaternion[3]);
+    if(normProduct > 0) cosHalfAngle = (float) (fabs(dotProduct) / sqrt(normProduct));
+    
+    if(!(trackingData->deadbandPublishedOutputs & output)
+       || cosHalfAngle < trackingData->deadbandQuaternionCosine
+       || (trackingData->deadbandMaxSilence > 0 && hostTime - *publicationTime >= trackingData->deadbandMaxSilence)) {
+        publishedQuaternion[0] = q1;
+        publishedQuaternion[1] = q2;
+        publishedQuaternion[2] = q3;
+        publishedQuaternion[3] = q4;
+        *publicationTime = hostTime;
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+//=====================================================================================================
+// function deadbandAnglesDue
+//=====================================================================================================
+//
+// returns 1 if the euler angles (in degrees) of the output "output" (see output mask) must be published: first
+// publication, change of one angle (modulo 360) larger than deadbandEulerAngle, or no publication for deadbandMaxSilence
+// seconds.
+// In this case, the angles and the time are stored as published
+//
+char deadbandAnglesDue(headtrackerData *trackingData, long output, float *publishedAngles, float yaw, float pitch, float roll, double *publicationTime, double hostTime) {
+    float angles[3], change, maxChange = 0;
+    int i;
+    
+    angles[0] = yaw;
+    angles[1] = pitch;
+    angles[2] = roll;
+    
+    for(i = 0; i < 3; i++) {
+        change = (float) fabs(angles[i] - publishedAngles[i]);
+        if(change > 180.0f) change = 360.0f - change;
+        maxChange = max(maxChange, change);
+    }
+    
+    if(!(trackingData->deadbandPublishedOutputs & output)
+       || maxChange > trackingData->deadbandEulerAngle
+       || (trackingData->deadbandMaxSilence > 0 && hostTime - *publicationTime >= trackingData->deadbandMaxSilence)) {
+        publishedAngles[0] = yaw;
+        publishedAngles[1] = pitch;
+        publishedAngles[2] = roll;
+        *publicationTime = hostTime;
+        return 1;
+    }
+    
+    return 0;
+}
+
+
+//=====================================================================================================
+// function computeOutputQuaternion
+//=====================================================================================================
+//
+// transform an estimated quaternion (q1, q2, q3, q4) into the output conventions (centering, axes reference, inversion)
+// with the transform precomputed by updateOutputTransform (no branch)
+//
+void computeOutputQuaternion(headtrackerData *trackingData, float q1, float q2, float q3, float q4, float *qout1, float *qout2, float *qout3, float *qout4) {
+    float *left = trackingData->outputTransformLeft, *right = trackingData->outputTransformRight, *sign = trackingData->outputTransformSign;
+    float p1, p2, p3, p4;
+    
+    quaternionComposition(left[0], left[1], left[2], left[3], q1, q2, q3, q4, &p1, &p2, &p3, &p4);
+    quaternionComposition(p1, p2, p3, p4, right[0], right[1], right[2], right[3], qout1, qout2, qout3, qout4);
+    
+    *qout1 *= sign[0];
+    *qout2 *= sign[1];
+    *qout3 *= sign[2];
+    *qout4 *= sign[3];
+}
+
+
+//=====================================================================================================
+// function updateOutputTransform
+//=====================================================================================================
+//
+// precompute the output transform, must be called each time qref, axesReference, invertRotation, rotationOrder or fastAnglesOn change
+//
+// centering: qref x q
+// axes reference: the change of axes is a rotation of 180 degrees (quaternion r, r^-1 = -r), applied as r x (qref x q) x r^-1
+//      0: X->right, Y->back, Z->down: r = identity
+//      1: X->right, Y->front, Z->up: r = 180 degrees around X (Y -> -Y, Z -> -Z)
+//      2: X->front, Y->left, Z->up: r = 180 degrees around (X-Y)/sqrt(2) (X -> -Y, Y -> -X, Z -> -Z)
+// inversion: conjugate of the result, i.e. sign (1,-1,-1,-1)
+//
+void updateOutputTransform(headtrackerData *trackingData) {
+    float r1 = 1, r2 = 0, r3 = 0, r4 = 0, invertSign;
+    quaternion2EulerFunction eulerFunctions[2][2] = {
+        {quaternion2YawPitchRoll, fastQuaternion2YawPitchRoll},
+        {quaternion2RollPitchYaw, fastQuaternion2RollPitchYaw}};
+    
+    switch (trackingData->axesReference) {
+        case 1: // X->right, Y->front, Z->up
+            r1 = 0;
+            r2 = 1;
+            break;
+        case 2: //X->front, Y->left, Z->up
+            r1 = 0;
+            r2 = .70710678118654752440f; // 1/sqrt(2)
+            r3 = -.70710678118654752440f;
+            break;
+            // if 0 identity
+    }
+    
+    quaternionComposition(r1, r2, r3, r4,
+                          trackingData->qref1, trackingData->qref2, trackingData->qref3, trackingData->qref4,
+                          &trackingData->outputTransformLeft[0], &trackingData->outputTransformLeft[1],
+                          &trackingData->outputTransformLeft[2], &trackingData->outputTransformLeft[3]);
+    trackingData->outputTransformRight[0] = r1;
+    trackingData->outputTransformRight[1] = -r2;
+    trackingData->outputTransformRight[2] = -r3;
+    trackingData->outputTransformRight[3] = -r4;
+    
+    invertSign = trackingData->invertRotation ? -1.0f : 1.0f;
+    trackingData->outputTransformSign[0] = 1;
+    trackingData->outputTransformSign[1] = invertSign;
+    trackingData->outputTransformSign[2] = invertSign;
+    trackingData->outputTransformSign[3] = invertSign;
+    
+    // euler conversion, selected once here instead of for each output
+    trackingData->quaternion2EulerAngles = eulerFunctions[trackingData->rotationOrder == 1][trackingData->fastAnglesOn != 0];
+    
+    trackingData->outputsUpToDate = 0;
+    trackingData->centeredQuaternionUpToDate = 0;
+}
+
+
+//=====================================================================================================
+// function updateAngularAcceleration
+//=====================================================================================================
+//
+// update the estimation of the angular acceleration (needed by predictOrientation), must be called for every frame
+// the angular acceleration is the derivative of the low-passed angular rate (the raw rate is far too noisy to be derived)
+//
+void updateAngularAcceleration(headtrackerData *trackingData) {
+    float omega, previousGyroDataLP;
+    int i;
+    
+    for(i = 0; i < 3; i++) {
+        // angular rate as seen by the estimator (the Kalman filter also corrects the gyroscope bias)
+        omega = trackingData->gyroCalData[i];
+        if(trackingData->estimationMethod == 2) omega -= trackingData->ESKFgyroBias[i];
+        
+        previousGyroDataLP = trackingData->gyroDataLP[i];
+        trackingData->gyroDataLP[i] += trackingData->predictionLPalpha * (omega - trackingData->gyroDataLP[i]);
+        trackingData->angularAcceleration[i] = (trackingData->gyroDataLP[i] - previousGyroDataLP) / trackingData->samplePeriod;
+    }
+}
+
+
+//=====================================================================================================
+// function predictOrientation
+//=====================================================================================================
+//
+// extrapolate the estimated quaternion (q1, q2, q3, q4) of the latest frame by predictionTime seconds, result in (qpred1, qpred2, qpred3, qpred4)
+//
+// the head is assumed to keep rotating with the current angular rate and angular acceleration (both in the sensor frame):
+//      rotation vector = (1 - damping) * (w * T + 1/2 * dw/dt * T^2)
+// damping scales the extrapolation down, to avoid overshoot at the end of fast head turns
+//
+void predictOrientation(headtrackerData *trackingData) {
+    float omega[3], rx, ry, rz, dq1, dq2, dq3, dq4, T, gain;
+    int i;
+    
+    // angular rate as seen by the estimator (the Kalman filter also corrects the gyroscope bias)
+    for(i = 0; i < 3; i++) {
+        omega[i] = trackingData->gyroCalData[i];
+        if(trackingData->estimationMethod == 2) omega[i] -= trackingData->ESKFgyroBias[i];
+    }
+    
+    T = trackingData->predictionTime;
+    gain = 1.0f - trackingData->predictionDamping;
+    rx = gain * (omega[0] * T + 0.5f * trackingData->angularAcceleration[0] * T * T);
+    ry = gain * (omega[1] * T + 0.5f * trackingData->angularAcceleration[1] * T * T);
+    rz = gain * (omega[2] * T + 0.5f * trackingData->angularAcceleration[2] * T * T);
+    
+    // q_pred = q x exp(r/2) (same convention as the estimators: rotation expressed in the sensor frame)
+    quaternionFromRotationVector(rx, ry, rz, &dq1, &dq2, &dq3, &dq4);
+    quaternionComposition(trackingData->q1, trackingData->q2, trackingData->q3, trackingData->q4,
+                          dq1, dq2, dq3, dq4,
+                          &trackingData->qpred1, &trackingData->qpred2, &trackingData->qpred3, &trackingData->qpred4);
+}
+
+
+//=====================================================================================================
+// function convert_7bytes_to_3int16
+//=====================================================================================================
+//
+// decode the raw data flow from the headtracker
+//
+void convert_7bytes_to_3int16(unsigned char *rawDataBuffer,int baseIndex,short *rawDataToSend) {
+    // for each sensor with values vx, vy, vz in 16 bits:
+    // each of the 7 bytes starts with the bit 1 (it's a unique marker of raw data info)
+    // 1/vx_1-vx_7
+    // 1/vx_8-vx_14
+    // 1/vx_15/vx_16/vy_1-vy_5
+    // 1/vy_6-vx_12
+    // 1/vy_13-vy_16/vz_1-vz_3
+    // 1/vz_4-vy_10
+    // 1/vz_11-vy_16/0
+    rawDataToSend[0] = ((rawDataBuffer[baseIndex]&127)<<9) + ((rawDataBuffer[baseIndex+1]&127)<<2) + ((rawDataBuffer[baseIndex+2]&127)>>5);
+    rawDataToSend[1] = ((rawDataBuffer[baseIndex+2]&31)<<11) + ((rawDataBuffer[baseIndex+3]&127)<<4) + ((rawDataBuffer[baseIndex+4]&127)>>3);
+    rawDataToSend[2] = ((rawDataBuffer[baseIndex+4]&7)<<13) + ((rawDataBuffer[baseIndex+5]&127)<<6) + ((rawDataBuffer[baseIndex+6]&127)>>1);
+}
+
+
+//=====================================================================================================
+// function computeCalibratedAccMagData
+//=====================================================================================================
+//
+// scale the raw magnetometer and accelerometer data according to the current calibration, and low-pass the accelerometer data
+//
+void computeCalibratedAccMagData(headtrackerData *trackingData) {
+    //scale mag data
+    if(trackingData->RTmagCalOn) {
+        trackingData->magCalData[0]=(trackingData->magRawData[0]-trackingData->RTmagCalibrationData->estimatedOffset[0]) * trackingData->RTmagCalibrationData->estimatedScalingFactor[0];
+        trackingData->magCalData[1]=(trackingData->magRawData[1]-trackingData->RTmagCalibrationData->estimatedOffset[1]) * trackingData->RTmagCalibrationData->estimatedScalingFactor[1];
+        trackingData->magCalData[2]=(trackingData->magRawData[2]-trackingData->RTmagCalibrationData->estimatedOffset[2]) * trackingData->RTmagCalibrationData->estimatedScalingFactor[2];
+    } else {
+        trackingData->magCalData[0]=(trackingData->magRawData[0]-trackingData->magOffset[0]) * trackingData->magScalingFactor[0];
+        trackingData->magCalData[1]=(trackingData->magRawData[1]-trackingData->magOffset[1]) * trackingData->magScalingFactor[1];
+        trackingData->magCalData[2]=(trackingData->magRawData[2]-trackingData->magOffset[2]) * trackingData->magScalingFactor[2];
+    }
+    
+    //scale acc data
+    trackingData->accCalData[0]=(trackingData->accRawData[0]-trackingData->accOffset[0]) * trackingData->accScalingFactor[0];
+    trackingData->accCalData[1]=(trackingData->accRawData[1]-trackingData->accOffset[1]) * trackingData->accScalingFactor[1];
+    trackingData->accCalData[2]=(trackingData->accRawData[2]-trackingData->accOffset[2]) * trackingData->accScalingFactor[2];
     
     // low-pass the accelerometer data with a variable coefficient. If movement, alpha tends to 1 (no smoothing), if no movement, alpha tends to its min (smoothing)
     trackingData->accCalDataLP[0] = trackingData->accLPalpha * trackingData->accCalData[0] + (1 - trackingData->accLPalpha) * trackingData->accLPstate[0];
@@ -1108,14 +1895,51 @@ char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
     trackingData->accLPstate[0] = trackingData->accCalDataLP[0]; // filter state update
     trackingData->accLPstate[1] = trackingData->accCalDataLP[1]; // filter state update
     trackingData->accLPstate[2] = trackingData->accCalDataLP[2]; // filter state update
+}
+
+
+//=====================================================================================================
+// function MadgwickAHRSupdateModified
+//=====================================================================================================
+//
+// AHRS algorithm update
+//
+// Modified version of Madgwick's angle estimation algorithm
+// See: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+// Main modifications:
+//  . low-pass filter applied to accelerometer data, with variable time constant depending on the movement (gyroscope activity)
+//  . beta coefficient (balance between gyroscope and accel/compass incremental estimation) made variable, depending on the movement (gyroscope activity)
+//
+//=====================================================================================================
+char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
+    float recipNorm;
+    float s1, s2, s3, s4;
+    float qDot1, qDot2, qDot3, qDot4;
+    float hx, hy;
+    float _2q1mx, _2q1my, _2q1mz, _2q2mx, _2bx, _2bz, _4bx, _4bz, _2q1, _2q2, _2q3, _2q4, _2q1q3, _2q3q4, q1q1, q1q2, q1q3, q1q4, q2q2, q2q3, q2q4, q3q3, q3q4, q4q4;
+    float a_norm2,m_norm2, gyro_norm2, magWeight, feedbackPeriod;
+    char magCorrection;
+    
+    float accDataNorm[3], *magDataNorm;
     
+    computeCalibratedAccMagData(trackingData);
+    
+    // compute the squared norm of the gyro data => rough estimation of the movement
+    gyro_norm2 = trackingData->gyroCalData[0] * trackingData->gyroCalData[0]
+    + trackingData->gyroCalData[1] * trackingData->gyroCalData[1]
+    + trackingData->gyroCalData[2] * trackingData->gyroCalData[2];
     
     // compute squared norms
     m_norm2 =  trackingData->magCalData[0] *  trackingData->magCalData[0] + trackingData->magCalData[1] *  trackingData->magCalData[1] + trackingData->magCalData[2] *  trackingData->magCalData[2];
     a_norm2 =  trackingData->accCalDataLP[0] *  trackingData->accCalDataLP[0] + trackingData->accCalDataLP[1] *  trackingData->accCalDataLP[1] + trackingData->accCalDataLP[2] *  trackingData->accCalDataLP[2];
     
+    // the magnetometer is only fused when it provides a new sample (the headtracker repeats the last magnetometer value
+    // in between, at a much lower rate than the other sensors): the frames in between get a cheaper gyroscope +
+    // accelerometer step, without the normalisation, the reference direction and the gradient of the magnetometer
+    magCorrection = !trackingData->magMultirateOn || trackingData->magDataFresh || trackingData->magReference[0] == 0.0f;
+    
     // return an error if magnetometer or accelerometer measurement invalid (avoids NaN in magnetometer normalisation)
-    if(m_norm2==0.0 || a_norm2==0.0) return 1; //returns error
+    if((magCorrection && m_norm2==0.0) || a_norm2==0.0) return 1; //returns error
     
     // Normalise accelerometer measurement
     recipNorm = invSqrt(a_norm2);
@@ -1123,24 +1947,13 @@ char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
     accDataNorm[1] = trackingData->accCalDataLP[1] * recipNorm;
     accDataNorm[2] = trackingData->accCalDataLP[2] * recipNorm;
     
-    // Normalise magnetometer measurement
-    recipNorm = invSqrt(m_norm2);
-    magDataNorm[0] = trackingData->magCalData[0] * recipNorm;
-    magDataNorm[1] = trackingData->magCalData[1] * recipNorm;
-    magDataNorm[2] = trackingData->magCalData[2] * recipNorm;
-    
     // Auxiliary variables to avoid repeated arithmetic
-    _2q1mx = 2.0f * trackingData->q1 * magDataNorm[0];
-    _2q1my = 2.0f * trackingData->q1 * magDataNorm[1];
-    _2q1mz = 2.0f * trackingData->q1 * magDataNorm[2];
-    _2q2mx = 2.0f * trackingData->q2 * magDataNorm[0];
     _2q1 = 2.0f * trackingData->q1;
     _2q2 = 2.0f * trackingData->q2;
     _2q3 = 2.0f * trackingData->q3;
     _2q4 = 2.0f * trackingData->q4;
     _2q1q3 = 2.0f * trackingData->q1 * trackingData->q3;
     _2q3q4 = 2.0f * trackingData->q3 * trackingData->q4;
-    q1q1 = trackingData->q1 * trackingData->q1;
     q1q2 = trackingData->q1 * trackingData->q2;
     q1q3 = trackingData->q1 * trackingData->q3;
     q1q4 = trackingData->q1 * trackingData->q4;
@@ -1151,19 +1964,50 @@ char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
     q3q4 = trackingData->q3 * trackingData->q4;
     q4q4 = trackingData->q4 * trackingData->q4;
     
-    // Reference direction of Earth's magnetic field
-    hx =  magDataNorm[0] * q1q1 - _2q1my * trackingData->q4 + _2q1mz * trackingData->q3 + magDataNorm[0] * q2q2 + _2q2 *  magDataNorm[1] * trackingData->q3 + _2q2 *  magDataNorm[2] * trackingData->q4 - magDataNorm[0] * q3q3 - magDataNorm[0] * q4q4;
-    hy = _2q1mx * trackingData->q4 + magDataNorm[1] * q1q1 - _2q1mz * trackingData->q2 + _2q2mx * trackingData->q3 - magDataNorm[1] * q2q2 + magDataNorm[1] * q3q3 + _2q3 *  magDataNorm[2] * trackingData->q4 - magDataNorm[1] * q4q4;
-    _2bx = (float) sqrt(hx * hx + hy * hy);
-    _2bz = -_2q1mx * trackingData->q3 + _2q1my * trackingData->q2 + magDataNorm[2] * q1q1 + _2q2mx * trackingData->q4 - magDataNorm[2] * q2q2 + _2q3 *  magDataNorm[1] * trackingData->q4 - magDataNorm[2] * q3q3 + magDataNorm[2] * q4q4;
-    _4bx = 2.0f * _2bx;
-    _4bz = 2.0f * _2bz;
-    
-    // Gradient decent algorithm corrective step
-    s1 = -_2q3 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q2 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]) - _2bz * trackingData->q3 * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (-_2bx * trackingData->q4 + _2bz * trackingData->q2) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + _2bx * trackingData->q3 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]);
-    s2 = _2q4 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q1 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]) - 4.0f * trackingData->q2 * (1 - 2.0f * q2q2 - 2.0f * q3q3 - accDataNorm[2]) + _2bz * trackingData->q4 * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (_2bx * trackingData->q3 + _2bz * trackingData->q1) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + (_2bx * trackingData->q4 - _4bz * trackingData->q2) * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]);
-    s3 = -_2q1 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q4 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]) - 4.0f * trackingData->q3 * (1 - 2.0f * q2q2 - 2.0f * q3q3 - accDataNorm[2]) + (-_4bx * trackingData->q3 - _2bz * trackingData->q1) * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (_2bx * trackingData->q2 + _2bz * trackingData->q4) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + (_2bx * trackingData->q1 - _4bz * trackingData->q3) * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]);
-    s4 = _2q2 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q3 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]) + (-_4bx * trackingData->q4 + _2bz * trackingData->q2) * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (-_2bx * trackingData->q1 + _2bz * trackingData->q3) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + _2bx * trackingData->q2 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]);
+    // Gradient decent algorithm corrective step, accelerometer part
+    s1 = -_2q3 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q2 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]);
+    s2 = _2q4 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q1 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]) - 4.0f * trackingData->q2 * (1 - 2.0f * q2q2 - 2.0f * q3q3 - accDataNorm[2]);
+    s3 = -_2q1 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q4 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]) - 4.0f * trackingData->q3 * (1 - 2.0f * q2q2 - 2.0f * q3q3 - accDataNorm[2]);
+    s4 = _2q2 * (2.0f * q2q4 - _2q1q3 - accDataNorm[0]) + _2q3 * (2.0f * q1q2 + _2q3q4 - accDataNorm[1]);
+    
+    if(magCorrection) {
+        // check if the new magnetometer sample is disturbed
+        updateMagDisturbance(trackingData, m_norm2);
+        
+        // Normalise magnetometer measurement
+        recipNorm = invSqrt(m_norm2);
+        trackingData->magDataNorm[0] = trackingData->magCalData[0] * recipNorm;
+        trackingData->magDataNorm[1] = trackingData->magCalData[1] * recipNorm;
+        trackingData->magDataNorm[2] = trackingData->magCalData[2] * recipNorm;
+        
+        // Auxiliary variables to avoid repeated arithmetic
+        _2q1mx = 2.0f * trackingData->q1 * trackingData->magDataNorm[0];
+        _2q1my = 2.0f * trackingData->q1 * trackingData->magDataNorm[1];
+        _2q1mz = 2.0f * trackingData->q1 * trackingData->magDataNorm[2];
+        _2q2mx = 2.0f * trackingData->q2 * trackingData->magDataNorm[0];
+        q1q1 = trackingData->q1 * trackingData->q1;
+        
+        // Reference direction of Earth's magnetic field
+        hx =  trackingData->magDataNorm[0] * q1q1 - _2q1my * trackingData->q4 + _2q1mz * trackingData->q3 + trackingData->magDataNorm[0] * q2q2 + _2q2 *  trackingData->magDataNorm[1] * trackingData->q3 + _2q2 *  trackingData->magDataNorm[2] * trackingData->q4 - trackingData->magDataNorm[0] * q3q3 - trackingData->magDataNorm[0] * q4q4;
+        hy = _2q1mx * trackingData->q4 + trackingData->magDataNorm[1] * q1q1 - _2q1mz * trackingData->q2 + _2q2mx * trackingData->q3 - trackingData->magDataNorm[1] * q2q2 + trackingData->magDataNorm[1] * q3q3 + _2q3 *  trackingData->magDataNorm[2] * trackingData->q4 - trackingData->magDataNorm[1] * q4q4;
+        trackingData->magReference[0] = (float) sqrt(hx * hx + hy * hy);
+        trackingData->magReference[1] = -_2q1mx * trackingData->q3 + _2q1my * trackingData->q2 + trackingData->magDataNorm[2] * q1q1 + _2q2mx * trackingData->q4 - trackingData->magDataNorm[2] * q2q2 + _2q3 *  trackingData->magDataNorm[1] * trackingData->q4 - trackingData->magDataNorm[2] * q3q3 + trackingData->magDataNorm[2] * q4q4;
+        
+        // Gradient decent algorithm corrective step, magnetometer part
+        // it is weighted by the disturbance detection (0 = no magnetometer correction while the magnetic field is disturbed)
+        magDataNorm = trackingData->magDataNorm;
+        magWeight = trackingData->magDisturbanceWeight;
+        _2bx = trackingData->magReference[0];
+        _2bz = trackingData->magReference[1];
+        _4bx = 2.0f * _2bx;
+        _4bz = 2.0f * _2bz;
+        
+        s1 += magWeight * (- _2bz * trackingData->q3 * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (-_2bx * trackingData->q4 + _2bz * trackingData->q2) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + _2bx * trackingData->q3 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]));
+        s2 += magWeight * (_2bz * trackingData->q4 * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (_2bx * trackingData->q3 + _2bz * trackingData->q1) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + (_2bx * trackingData->q4 - _4bz * trackingData->q2) * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]));
+        s3 += magWeight * ((-_4bx * trackingData->q3 - _2bz * trackingData->q1) * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (_2bx * trackingData->q2 + _2bz * trackingData->q4) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + (_2bx * trackingData->q1 - _4bz * trackingData->q3) * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]));
+        s4 += magWeight * ((-_4bx * trackingData->q4 + _2bz * trackingData->q2) * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - magDataNorm[0]) + (-_2bx * trackingData->q1 + _2bz * trackingData->q3) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - magDataNorm[1]) + _2bx * trackingData->q2 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - magDataNorm[2]));
+    }
+    
     recipNorm = invSqrt(s1 * s1 + s2 * s2 + s3 * s3 + s4 * s4);
     
     // normalise step magnitude
@@ -1172,26 +2016,31 @@ char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
     s3 *= recipNorm;
     s4 *= recipNorm;
     
-    // Rate of change of quaternion from gyroscope
-    qDot1 = 0.5f * (-trackingData->q2 * trackingData->gyroCalData[0] - trackingData->q3 * trackingData->gyroCalData[1] - trackingData->q4 * trackingData->gyroCalData[2]);
-    qDot2 = 0.5f * (trackingData->q1 * trackingData->gyroCalData[0] + trackingData->q3 * trackingData->gyroCalData[2] - trackingData->q4 * trackingData->gyroCalData[1]);
-    qDot3 = 0.5f * (trackingData->q1 * trackingData->gyroCalData[1] - trackingData->q2 * trackingData->gyroCalData[2] + trackingData->q4 * trackingData->gyroCalData[0]);
-    qDot4 = 0.5f * (trackingData->q1 * trackingData->gyroCalData[2] + trackingData->q2 * trackingData->gyroCalData[1] - trackingData->q3 * trackingData->gyroCalData[0]);
-    
     // Apply feedback step
     // compute the dynamic parameter beta: no movement => beta maximum, lot of movement => beta tends to 0
     trackingData->beta = trackingData->MadgwickBetaMax * (1 - min(max(trackingData->MadgwickBetaGain * gyro_norm2,0),1));
-    qDot1 -= trackingData->beta * s1;
-    qDot2 -= trackingData->beta * s2;
-    qDot3 -= trackingData->beta * s3;
-    qDot4 -= trackingData->beta * s4;
     
-    
-    // Integrate rate of change of quaternion to yield quaternion
-    trackingData->q1 += qDot1 * trackingData->samplePeriod;
-    trackingData->q2 += qDot2 * trackingData->samplePeriod;
-    trackingData->q3 += qDot3 * trackingData->samplePeriod;
-    trackingData->q4 += qDot4 * trackingData->samplePeriod;
+    // high-gain phase right after the initialization of the attitude (whatever the movement)
+    if(trackingData->initialConvergenceCounter > 0) {
+        trackingData->beta = trackingData->MadgwickBetaMax * INITIAL_CONVERGENCE_BETA_FACTOR;
+        trackingData->initialConvergenceCounter--;
+    }
+    qDot1 = - trackingData->beta * s1;
+    qDot2 = - trackingData->beta * s2;
+    qDot3 = - trackingData->beta * s3;
+    qDot4 = - trackingData->beta * s4;
+    
+    // the step is normalised: in idle mode (one update for several frames), it is kept at the size of one frame,
+    // otherwise the quaternion would jitter around the solution
+    feedbackPeriod = trackingData->samplePeriod;
+    if(trackingData->idle) feedbackPeriod /= max(trackingData->idleFrameCounter, 1);
+    
+    // Integrate the gyroscope data, then the feedback step (both computed from the previous quaternion)
+    integrateGyroscope(trackingData, trackingData->gyroCalData[0], trackingData->gyroCalData[1], trackingData->gyroCalData[2]);
+    trackingData->q1 += qDot1 * feedbackPeriod;
+    trackingData->q2 += qDot2 * feedbackPeriod;
+    trackingData->q3 += qDot3 * feedbackPeriod;
+    trackingData->q4 += qDot4 * feedbackPeriod;
     
     // Normalise quaternion
     recipNorm = invSqrt(trackingData->q1 * trackingData->q1 + trackingData->q2 * trackingData->q2 + trackingData->q3 * trackingData->q3 + trackingData->q4 * trackingData->q4);
@@ -1217,19 +2066,336 @@ char MadgwickAHRSupdateModified(headtrackerData *trackingData) {
 //=====================================================================================================
 char GyroscopeIntegrationUpdate(headtrackerData *trackingData) {
     float recipNorm;
+    
+    integrateGyroscope(trackingData, trackingData->gyroCalData[0], trackingData->gyroCalData[1], trackingData->gyroCalData[2]);
+    
+    // Normalise quaternion
+    recipNorm = invSqrt(trackingData->q1 * trackingData->q1 + trackingData->q2 * trackingData->q2 + trackingData->q3 * trackingData->q3 + trackingData->q4 * trackingData->q4);
+    trackingData->q1 *= recipNorm;
+    trackingData->q2 *= recipNorm;
+    trackingData->q3 *= recipNorm;
+    trackingData->q4 *= recipNorm;
+    
+    return 0;
+}
+
+
+
+
+//=====================================================================================================
+// function updateMagDisturbance
+//=====================================================================================================
+//
+// detection of magnetic disturbances (speaker magnets, metal, electronic devices...), called for each new magnetometer sample
+// the norm and the inclination (angle with the horizontal plane, computed with the current orientation) of the calibrated
+// magnetic field are compared with references that slowly follow the undisturbed field
+// magDisturbanceWeight is 1 when both deviations are below half their thresholds, and decreases linearly down to 0
+// at the thresholds (a partial correction would still pull the heading towards the disturbed field). A disturbance
+// lasting more than MAG_DISTURBANCE_MAX_DURATION seconds is considered as a new magnetic environment (new references)
+//
+// if magDisturbanceGatingOn is 0, the disturbances are still detected (magDisturbed), but the weight stays 1
+//
+void updateMagDisturbance(headtrackerData *trackingData, float m_norm2) {
+    float m_norm, hz, inclination, deviation, elapsedTime, alpha;
+    char magDisturbed;
+    
+    if(m_norm2 <= 0.0f) return;
+    m_norm = (float) sqrt(m_norm2);
+    
+    // vertical component of the normalised magnetic field in the earth frame
+    hz = (2.0f * (trackingData->q2 * trackingData->q4 - trackingData->q1 * trackingData->q3) * trackingData->magCalData[0]
+          + 2.0f * (trackingData->q3 * trackingData->q4 + trackingData->q1 * trackingData->q2) * trackingData->magCalData[1]
+          + (1.0f - 2.0f * (trackingData->q2 * trackingData->q2 + trackingData->q3 * trackingData->q3)) * trackingData->magCalData[2]) / m_norm;
+    inclination = (float) asin(min(max(hz, -1.0f), 1.0f)) * RAD_TO_DEGREE;
+    
+    // time since the previous magnetometer sample
+    elapsedTime = trackingData->samplePeriod;
+    if(trackingData->magMultirateOn) elapsedTime *= trackingData->magHoldLength;
+    
+    if(!trackingData->magDisturbanceReferenceValid || trackingData->magDisturbanceDuration > MAG_DISTURBANCE_MAX_DURATION) {
+        // first sample, or new magnetic environment
+        trackingData->magNormReference = m_norm;
+        trackingData->magInclinationReference = inclination;
+        trackingData->magDisturbanceReferenceValid = 1;
+        deviation = 0;
+    } else {
+        deviation = max((float) fabs(m_norm / trackingData->magNormReference - 1.0f) / trackingData->magDisturbanceNormThreshold,
+                        (float) fabs(inclination - trackingData->magInclinationReference) / trackingData->magDisturbanceInclinationThreshold);
+    }
+    
+    magDisturbed = (deviation > 1.0f);
+    
+    if(magDisturbed) {
+        trackingData->magDisturbanceDuration += elapsedTime;
+    } else {
+        // undisturbed: the references follow the field (slow changes of the environment, drift of the calibration)
+        trackingData->magDisturbanceDuration = 0;
+        alpha = 1.0f - (float) exp(-elapsedTime / MAG_DISTURBANCE_REFERENCE_TIME_CONSTANT);
+        trackingData->magNormReference += alpha * (m_norm - trackingData->magNormReference);
+        trackingData->magInclinationReference += alpha * (inclination - trackingData->magInclinationReference);
+    }
+    
+    if(trackingData->magDisturbanceGatingOn)
+        trackingData->magDisturbanceWeight = min(max(2.0f - 2.0f * deviation, 0.0f), 1.0f);
+    else
+        trackingData->magDisturbanceWeight = 1.0f;
+    
+    // notify the host when the state changes
+    if(magDisturbed != trackingData->magDisturbed) {
+        trackingData->magDisturbed = magDisturbed;
+        pushNotificationMessage(trackingData, magDisturbed ? NOTIFICATION_MESSAGE_MAG_DISTURBANCE_STARTED : NOTIFICATION_MESSAGE_MAG_DISTURBANCE_ENDED);
+    }
+}
+
+
+//=====================================================================================================
+// function resetMagDisturbance
+//=====================================================================================================
+//
+// reset the magnetic disturbance detection (the references are set again by the next magnetometer sample)
+//
+void resetMagDisturbance(headtrackerData *trackingData) {
+    trackingData->magDisturbed = 0;
+    trackingData->magDisturbanceWeight = 1.0f;
+    trackingData->magDisturbanceReferenceValid = 0;
+    trackingData->magDisturbanceDuration = 0;
+}
+
+
+//=====================================================================================================
+// function updateOrientation
+//=====================================================================================================
+//
+// one step of the estimation method (from the sensor data of the current frame, over samplePeriod)
+//
+void updateOrientation(headtrackerData *trackingData) {
+    switch( trackingData->estimationMethod) {
+        case 0: // 0 = Madgwick 9 Axes
+            MadgwickAHRSupdateModified(trackingData);
+            break;
+        case 1: // 1 = gyroscope integration only (no magnetometer)
+            GyroscopeIntegrationUpdate(trackingData);
+            break;
+        case 2: // 2 = error-state Kalman filter 9 Axes
+            ESKFupdate(trackingData);
+            break;
+    }
+}
+
+
+//=====================================================================================================
+// function updateStillness
+//=====================================================================================================
+//
+// stillness detection for the idle mode: the headtracker is still when the norm of the angular rate is below
+// idleGyroThreshold and the standard deviation of the accelerometer data (running variance over about
+// STILLNESS_ACC_TIME_CONSTANT seconds) is below idleAccThreshold
+//
+// returns 1 if still, and updates the duration of the still state
+//
+char updateStillness(headtrackerData *trackingData) {
+    float accData, delta, alpha, variance = 0, gyro_norm2;
+    char still;
+    int i;
+    
+    alpha = min(trackingData->samplePeriod / STILLNESS_ACC_TIME_CONSTANT, 1.0f);
+    
+    for(i = 0; i < 3; i++) {
+        accData = trackingData->accRawData[i] * trackingData->accScalingFactor[i];
+        delta = accData - trackingData->accMean[i];
+        trackingData->accMean[i] += alpha * delta;
+        variance += delta * delta;
+    }
+    trackingData->accVariance += alpha * (variance - trackingData->accVariance);
+    
+    gyro_norm2 = trackingData->gyroCalData[0] * trackingData->gyroCalData[0]
+    + trackingData->gyroCalData[1] * trackingData->gyroCalData[1]
+    + trackingData->gyroCalData[2] * trackingData->gyroCalData[2];
+    
+    still = gyro_norm2 < trackingData->idleGyroThreshold * trackingData->idleGyroThreshold
+            && trackingData->accVariance < trackingData->idleAccThreshold * trackingData->idleAccThreshold;
+    
+    if(still)
+        trackingData->stillDuration += trackingData->samplePeriod;
+    else
+        trackingData->stillDuration = 0;
+    
+    return still;
+}
+
+
+//=====================================================================================================
+// function resetIdleMode
+//=====================================================================================================
+//
+// back to full rate, and restart the stillness detection (the running variance starts high, so that the
+// headtracker is not considered still before the running mean has converged)
+//
+void resetIdleMode(headtrackerData *trackingData) {
+    trackingData->idle = 0;
+    trackingData->stillDuration = 0;
+    trackingData->accMean[0] = 0;
+    trackingData->accMean[1] = 0;
+    trackingData->accMean[2] = 0;
+    trackingData->accVariance = 1.0f;
+    trackingData->idleGyroSum[0] = 0;
+    trackingData->idleGyroSum[1] = 0;
+    trackingData->idleGyroSum[2] = 0;
+    trackingData->idleFrameCounter = 0;
+    trackingData->idleMagDataFresh = 0;
+    trackingData->estimationUpdated = 1;
+}
+
+
+//=====================================================================================================
+// function integrateGyroscope
+//=====================================================================================================
+//
+// rotate the quaternion by the angular rate (gx, gy, gz) in rad/s during one sample period, according to gyroIntegrationMethod:
+//  0: first order, q += 0.5 q x (0,g) dt (the caller normalises the quaternion afterwards)
+//      the error grows with the square of the sample period and with the non-commutativity of the rotations (coning)
+//  1: exponential map, q = q x exp(phi), with the rotation vector phi = g.dt corrected for coning with the previous
+//      increment ("one plus previous sample" algorithm): phi = g.dt + 1/12 (previous increment x g.dt)
+//      this keeps the same accuracy at 250-500 Hz as the first order method at 1-2 kHz
+//
+void integrateGyroscope(headtrackerData *trackingData, float gx, float gy, float gz) {
     float qDot1, qDot2, qDot3, qDot4;
+    float ax, ay, az, *pa, dq1, dq2, dq3, dq4, q1, q2, q3, q4;
+    
+    if(trackingData->gyroIntegrationMethod == 1) {
+        // rotation vector of the current frame, and coning correction with the previous one
+        ax = gx * trackingData->samplePeriod;
+        ay = gy * trackingData->samplePeriod;
+        az = gz * trackingData->samplePeriod;
+        pa = trackingData->previousGyroIncrement;
+        quaternionFromRotationVector(ax + (pa[1] * az - pa[2] * ay) / 12.0f,
+                                     ay + (pa[2] * ax - pa[0] * az) / 12.0f,
+                                     az + (pa[0] * ay - pa[1] * ax) / 12.0f,
+                                     &dq1, &dq2, &dq3, &dq4);
+        pa[0] = ax;
+        pa[1] = ay;
+        pa[2] = az;
+        
+        q1 = trackingData->q1;
+        q2 = trackingData->q2;
+        q3 = trackingData->q3;
+        q4 = trackingData->q4;
+        quaternionComposition(q1, q2, q3, q4, dq1, dq2, dq3, dq4, &trackingData->q1, &trackingData->q2, &trackingData->q3, &trackingData->q4);
+    } else {
+        // Rate of change of quaternion from gyroscope
+        qDot1 = 0.5f * (-trackingData->q2 * gx - trackingData->q3 * gy - trackingData->q4 * gz);
+        qDot2 = 0.5f * (trackingData->q1 * gx + trackingData->q3 * gz - trackingData->q4 * gy);
+        qDot3 = 0.5f * (trackingData->q1 * gy - trackingData->q2 * gz + trackingData->q4 * gx);
+        qDot4 = 0.5f * (trackingData->q1 * gz + trackingData->q2 * gy - trackingData->q3 * gx);
+        
+        // Integrate rate of change of quaternion to yield quaternion
+        trackingData->q1 += qDot1 * trackingData->samplePeriod;
+        trackingData->q2 += qDot2 * trackingData->samplePeriod;
+        trackingData->q3 += qDot3 * trackingData->samplePeriod;
+        trackingData->q4 += qDot4 * trackingData->samplePeriod;
+    }
+}
+
+
+//=====================================================================================================
+// function initializeAttitude
+//=====================================================================================================
+//
+// initialize the quaternion from the current calibrated accelerometer and magnetometer vectors (TRIAD method),
+// so that the first estimated orientation is already correct instead of converging from the identity
+// earth frame (same as the estimators): Z = up (direction of the accelerometer at rest),
+// X = horizontal component of the magnetic field, Y = Z x X
+// the accelerometer lowpass filter is initialized with the current value as well
+//
+// returns 1 if the attitude has been initialized, 0 if the data is not valid yet (null vector, or magnetic field parallel to gravity)
+//
+char initializeAttitude(headtrackerData *trackingData) {
+    float R[3][3], a[3], m[3], ma, recipNorm;
+    int i;
+    
+    computeCalibratedAccMagData(trackingData);
+    
+    for(i = 0; i < 3; i++) {
+        a[i] = trackingData->accCalData[i];
+        m[i] = trackingData->magCalData[i];
+    }
+    
+    // earth Z in the sensor frame
+    recipNorm = a[0]*a[0] + a[1]*a[1] + a[2]*a[2];
+    if(recipNorm == 0.0f) return 0;
+    recipNorm = 1.0f / (float) sqrt(recipNorm);
+    for(i = 0; i < 3; i++) R[2][i] = a[i] * recipNorm;
+    
+    // earth X in the sensor frame: magnetic field minus its vertical component
+    ma = m[0]*R[2][0] + m[1]*R[2][1] + m[2]*R[2][2];
+    for(i = 0; i < 3; i++) R[0][i] = m[i] - ma * R[2][i];
+    recipNorm = R[0][0]*R[0][0] + R[0][1]*R[0][1] + R[0][2]*R[0][2];
+    if(recipNorm < 1e-6f * (m[0]*m[0] + m[1]*m[1] + m[2]*m[2]) || recipNorm == 0.0f) return 0;
+    recipNorm = 1.0f / (float) sqrt(recipNorm);
+    for(i = 0; i < 3; i++) R[0][i] *= recipNorm;
+    
+    // earth Y = Z x X
+    R[1][0] = R[2][1] * R[0][2] - R[2][2] * R[0][1];
+    R[1][1] = R[2][2] * R[0][0] - R[2][0] * R[0][2];
+    R[1][2] = R[2][0] * R[0][1] - R[2][1] * R[0][0];
+    
+    // the rows of R are the earth axes in the sensor frame => R rotates the sensor frame into the earth frame
+    quaternionFromRotationMatrix(R, &trackingData->q1, &trackingData->q2, &trackingData->q3, &trackingData->q4);
+    
+    // start the accelerometer lowpass filter from the current value instead of 0
+    for(i = 0; i < 3; i++) {
+        trackingData->accLPstate[i] = trackingData->accCalData[i];
+        trackingData->accCalDataLP[i] = trackingData->accCalData[i];
+    }
+    
+    trackingData->attitudeInitialized = 1;
+    trackingData->initialConvergenceCounter = (long) (trackingData->initialConvergenceTime * trackingData->samplerate);
+    
+    return 1;
+}
+
 
-    // Rate of change of quaternion from gyroscope
-    qDot1 = 0.5f * (-trackingData->q2 * trackingData->gyroCalData[0] - trackingData->q3 * trackingData->gyroCalData[1] - trackingData->q4 * trackingData->gyroCalData[2]);
-    qDot2 = 0.5f * (trackingData->q1 * trackingData->gyroCalData[0] + trackingData->q3 * trackingData->gyroCalData[2] - trackingData->q4 * trackingData->gyroCalData[1]);
-    qDot3 = 0.5f * (trackingData->q1 * trackingData->gyroCalData[1] - trackingData->q2 * trackingData->gyroCalData[2] + trackingData->q4 * trackingData->gyroCalData[0]);
-    qDot4 = 0.5f * (trackingData->q1 * trackingData->gyroCalData[2] + trackingData->q2 * trackingData->gyroCalData[1] - trackingData->q3 * trackingData->gyroCalData[0]);
+//=====================================================================================================
+// function ESKFupdate
+//=====================================================================================================
+//
+// AHRS algorithm update
+//
+// Error-state Kalman filter (9 axes) with online estimation of the gyroscope bias
+// . nominal state: quaternion (q1..q4) and residual gyroscope bias (ESKFgyroBias, in rad/s, on top of gyroOffset)
+// . error state (6 dimensions): attitude error (rad, body frame) and bias error (rad/s)
+// . the accelerometer (gravity) and the magnetometer (heading) are processed as 6 sequential scalar updates,
+//   so that no matrix inversion is needed
+// All matrix operations are written out on fixed-size arrays (no loop, no heap allocation), so that
+// one update stays far below the sample period at 2 kHz
+//
+//=====================================================================================================
+char ESKFupdate(headtrackerData *trackingData) {
+    float (*P)[6] = trackingData->ESKFcovariance;
+    float dx[6];
+    float recipNorm;
+    float gx, gy, gz;
+    float dt, dt2, thx, thy, thz, Qtheta, Qbias;
+    float MA00, MA01, MA02, MA10, MA11, MA12, MA20, MA21, MA22;
+    float MB00, MB01, MB02, MB10, MB11, MB12, MB20, MB21, MB22;
+    float R00, R01, R02, R10, R11, R12, R20, R21, R22;
+    float q1q2, q1q3, q1q4, q2q2, q2q3, q2q4, q3q3, q3q4, q4q4;
+    float a_norm2, m_norm2, a_norm, accNoise2, magNoise2;
+    float ax, ay, az, mx, my, mz, vx, vy, vz, hx, hy, bx, bz;
+    float dq2, dq3, dq4, q1, q2, q3, q4;
+    
+    computeCalibratedAccMagData(trackingData);
+    
+    dt = trackingData->samplePeriod;
+    dt2 = dt * dt;
     
-    // Integrate rate of change of quaternion to yield quaternion
-    trackingData->q1 += qDot1 * trackingData->samplePeriod;
-    trackingData->q2 += qDot2 * trackingData->samplePeriod;
-    trackingData->q3 += qDot3 * trackingData->samplePeriod;
-    trackingData->q4 += qDot4 * trackingData->samplePeriod;
+    // gyroscope data corrected by the estimated bias
+    gx = trackingData->gyroCalData[0] - trackingData->ESKFgyroBias[0];
+    gy = trackingData->gyroCalData[1] - trackingData->ESKFgyroBias[1];
+    gz = trackingData->gyroCalData[2] - trackingData->ESKFgyroBias[2];
+    
+    //---------------- 1/ prediction of the nominal state ----------------
+    integrateGyroscope(trackingData, gx, gy, gz);
     
     // Normalise quaternion
     recipNorm = invSqrt(trackingData->q1 * trackingData->q1 + trackingData->q2 * trackingData->q2 + trackingData->q3 * trackingData->q3 + trackingData->q4 * trackingData->q4);
@@ -1238,10 +2404,283 @@ char GyroscopeIntegrationUpdate(headtrackerData *trackingData) {
     trackingData->q3 *= recipNorm;
     trackingData->q4 *= recipNorm;
     
+    //---------------- 2/ propagation of the error-state covariance ----------------
+    // transition matrix F = [M -dt.I ; 0 I], with M = I - [w.dt]x
+    // P = F.P.F' + Q, computed by 3x3 blocks (A = attitude, B = cross terms, C = bias):
+    //      A' = M.A.M' - dt.(M.B + (M.B)') + dt^2.C + Qtheta
+    //      B' = M.B - dt.C
+    //      C' = C + Qbias
+    thx = gx * dt;
+    thy = gy * dt;
+    thz = gz * dt;
+    Qtheta = trackingData->ESKFgyroNoise * trackingData->ESKFgyroNoise * dt2;
+    Qbias = trackingData->ESKFgyroBiasNoise * trackingData->ESKFgyroBiasNoise * dt;
+    
+    MB00 = P[0][3] + thz * P[1][3] - thy * P[2][3];
+    MB01 = P[0][4] + thz * P[1][4] - thy * P[2][4];
+    MB02 = P[0][5] + thz * P[1][5] - thy * P[2][5];
+    MB10 = P[1][3] - thz * P[0][3] + thx * P[2][3];
+    MB11 = P[1][4] - thz * P[0][4] + thx * P[2][4];
+    MB12 = P[1][5] - thz * P[0][5] + thx * P[2][5];
+    MB20 = P[2][3] + thy * P[0][3] - thx * P[1][3];
+    MB21 = P[2][4] + thy * P[0][4] - thx * P[1][4];
+    MB22 = P[2][5] + thy * P[0][5] - thx * P[1][5];
+    
+    MA00 = P[0][0] + thz * P[1][0] - thy * P[2][0];
+    MA01 = P[0][1] + thz * P[1][1] - thy * P[2][1];
+    MA02 = P[0][2] + thz * P[1][2] - thy * P[2][2];
+    MA10 = P[1][0] - thz * P[0][0] + thx * P[2][0];
+    MA11 = P[1][1] - thz * P[0][1] + thx * P[2][1];
+    MA12 = P[1][2] - thz * P[0][2] + thx * P[2][2];
+    MA20 = P[2][0] + thy * P[0][0] - thx * P[1][0];
+    MA21 = P[2][1] + thy * P[0][1] - thx * P[1][1];
+    MA22 = P[2][2] + thy * P[0][2] - thx * P[1][2];
+    
+    P[0][0] = MA00 + thz * MA01 - thy * MA02 - dt * (MB00 + MB00) + dt2 * P[3][3] + Qtheta;
+    P[0][1] = MA01 - thz * MA00 + thx * MA02 - dt * (MB01 + MB10) + dt2 * P[3][4];
+    P[0][2] = MA02 + thy * MA00 - thx * MA01 - dt * (MB02 + MB20) + dt2 * P[3][5];
+    P[1][1] = MA11 - thz * MA10 + thx * MA12 - dt * (MB11 + MB11) + dt2 * P[4][4] + Qtheta;
+    P[1][2] = MA12 + thy * MA10 - thx * MA11 - dt * (MB12 + MB21) + dt2 * P[4][5];
+    P[2][2] = MA22 + thy * MA20 - thx * MA21 - dt * (MB22 + MB22) + dt2 * P[5][5] + Qtheta;
+    
+    P[0][3] = MB00 - dt * P[3][3];
+    P[0][4] = MB01 - dt * P[3][4];
+    P[0][5] = MB02 - dt * P[3][5];
+    P[1][3] = MB10 - dt * P[4][3];
+    P[1][4] = MB11 - dt * P[4][4];
+    P[1][5] = MB12 - dt * P[4][5];
+    P[2][3] = MB20 - dt * P[5][3];
+    P[2][4] = MB21 - dt * P[5][4];
+    P[2][5] = MB22 - dt * P[5][5];
+    
+    P[3][3] += Qbias;
+    P[4][4] += Qbias;
+    P[5][5] += Qbias;
+    
+    // symmetric part
+    P[1][0] = P[0][1];
+    P[2][0] = P[0][2];
+    P[2][1] = P[1][2];
+    P[3][0] = P[0][3];
+    P[3][1] = P[1][3];
+    P[3][2] = P[2][3];
+    P[4][0] = P[0][4];
+    P[4][1] = P[1][4];
+    P[4][2] = P[2][4];
+    P[5][0] = P[0][5];
+    P[5][1] = P[1][5];
+    P[5][2] = P[2][5];
+    
+    //---------------- 3/ measurement updates ----------------
+    dx[0] = 0; dx[1] = 0; dx[2] = 0; dx[3] = 0; dx[4] = 0; dx[5] = 0;
+    
+    // rotation matrix (sensor to earth) of the predicted quaternion
+    q1q2 = trackingData->q1 * trackingData->q2;
+    q1q3 = trackingData->q1 * trackingData->q3;
+    q1q4 = trackingData->q1 * trackingData->q4;
+    q2q2 = trackingData->q2 * trackingData->q2;
+    q2q3 = trackingData->q2 * trackingData->q3;
+    q2q4 = trackingData->q2 * trackingData->q4;
+    q3q3 = trackingData->q3 * trackingData->q3;
+    q3q4 = trackingData->q3 * trackingData->q4;
+    q4q4 = trackingData->q4 * trackingData->q4;
+    R00 = 1.0f - 2.0f * (q3q3 + q4q4);
+    R01 = 2.0f * (q2q3 - q1q4);
+    R02 = 2.0f * (q2q4 + q1q3);
+    R10 = 2.0f * (q2q3 + q1q4);
+    R11 = 1.0f - 2.0f * (q2q2 + q4q4);
+    R12 = 2.0f * (q3q4 - q1q2);
+    R20 = 2.0f * (q2q4 - q1q3);
+    R21 = 2.0f * (q3q4 + q1q2);
+    R22 = 1.0f - 2.0f * (q2q2 + q3q3);
+    
+    // compute squared norms
+    m_norm2 =  trackingData->magCalData[0] *  trackingData->magCalData[0] + trackingData->magCalData[1] *  trackingData->magCalData[1] + trackingData->magCalData[2] *  trackingData->magCalData[2];
+    a_norm2 =  trackingData->accCalDataLP[0] *  trackingData->accCalDataLP[0] + trackingData->accCalDataLP[1] *  trackingData->accCalDataLP[1] + trackingData->accCalDataLP[2] *  trackingData->accCalDataLP[2];
+    
+    // accelerometer: measured vs predicted direction of the gravity in the sensor frame
+    // (h = [v]x, the measurement noise is increased when the norm differs from 1g, i.e. when the sensor accelerates)
+    if(a_norm2 > 0.0f) {
+        recipNorm = invSqrt(a_norm2);
+        a_norm = a_norm2 * recipNorm;
+        ax = trackingData->accCalDataLP[0] * recipNorm;
+        ay = trackingData->accCalDataLP[1] * recipNorm;
+        az = trackingData->accCalDataLP[2] * recipNorm;
+        accNoise2 = trackingData->ESKFaccNoise * trackingData->ESKFaccNoise + (a_norm - 1.0f) * (a_norm - 1.0f);
+        
+        vx = R20;
+        vy = R21;
+        vz = R22;
+        
+        ESKFscalarUpdate(P, dx, 0.0f, -vz, vy, ax - vx, accNoise2);
+        ESKFscalarUpdate(P, dx, vz, 0.0f, -vx, ay - vy, accNoise2);
+        ESKFscalarUpdate(P, dx, -vy, vx, 0.0f, az - vz, accNoise2);
+    }
+    
+    // magnetometer: measured vs predicted direction of the magnetic field in the sensor frame
+    // the earth reference (bx, 0, bz) is computed from the measurement itself (same as Madgwick), so that only the heading is corrected
+    // (only when the magnetometer provides a new sample, see MadgwickAHRSupdateModified)
+    // the measurement noise is increased while the magnetic field is disturbed, the update is skipped if the weight drops to 0
+    if(m_norm2 > 0.0f && (!trackingData->magMultirateOn || trackingData->magDataFresh))
+        updateMagDisturbance(trackingData, m_norm2);
+    
+    if(m_norm2 > 0.0f && (!trackingData->magMultirateOn || trackingData->magDataFresh) && trackingData->magDisturbanceWeight > 0.0f) {
+        // when the held samples are skipped, the magnetometer sample is weighted as much as all its repetitions would have been
+        magNoise2 = trackingData->ESKFmagNoise * trackingData->ESKFmagNoise;
+        if(trackingData->magMultirateOn) magNoise2 /= trackingData->magHoldLength;
+        magNoise2 /= trackingData->magDisturbanceWeight * trackingData->magDisturbanceWeight;
+        
+        recipNorm = invSqrt(m_norm2);
+        mx = trackingData->magCalData[0] * recipNorm;
+        my = trackingData->magCalData[1] * recipNorm;
+        mz = trackingData->magCalData[2] * recipNorm;
+        
+        hx = R00 * mx + R01 * my + R02 * mz;
+        hy = R10 * mx + R11 * my + R12 * mz;
+        bz = R20 * mx + R21 * my + R22 * mz;
+        bx = (float) sqrt(hx * hx + hy * hy);
+        
+        vx = R00 * bx + R20 * bz;
+        vy = R01 * bx + R21 * bz;
+        vz = R02 * bx + R22 * bz;
+        
+        ESKFscalarUpdate(P, dx, 0.0f, -vz, vy, mx - vx, magNoise2);
+        ESKFscalarUpdate(P, dx, vz, 0.0f, -vx, my - vy, magNoise2);
+        ESKFscalarUpdate(P, dx, -vy, vx, 0.0f, mz - vz, magNoise2);
+    }
+    
+    //---------------- 4/ injection of the error state into the nominal state ----------------
+    // q = q x [1 dtheta/2]
+    dq2 = 0.5f * dx[0];
+    dq3 = 0.5f * dx[1];
+    dq4 = 0.5f * dx[2];
+    q1 = trackingData->q1;
+    q2 = trackingData->q2;
+    q3 = trackingData->q3;
+    q4 = trackingData->q4;
+    trackingData->q1 = q1 - q2 * dq2 - q3 * dq3 - q4 * dq4;
+    trackingData->q2 = q2 + q1 * dq2 + q3 * dq4 - q4 * dq3;
+    trackingData->q3 = q3 + q1 * dq3 - q2 * dq4 + q4 * dq2;
+    trackingData->q4 = q4 + q1 * dq4 + q2 * dq3 - q3 * dq2;
+    
+    // Normalise quaternion
+    recipNorm = invSqrt(trackingData->q1 * trackingData->q1 + trackingData->q2 * trackingData->q2 + trackingData->q3 * trackingData->q3 + trackingData->q4 * trackingData->q4);
+    trackingData->q1 *= recipNorm;
+    trackingData->q2 *= recipNorm;
+    trackingData->q3 *= recipNorm;
+    trackingData->q4 *= recipNorm;
+    
+    trackingData->ESKFgyroBias[0] += dx[3];
+    trackingData->ESKFgyroBias[1] += dx[4];
+    trackingData->ESKFgyroBias[2] += dx[5];
+    
+    // no correction gain in this method
+    trackingData->beta = 0;
+    
     return 0;
 }
 
 
+//=====================================================================================================
+// function ESKFscalarUpdate
+//=====================================================================================================
+//
+// scalar measurement update of the error-state Kalman filter
+// the measurement model is innovation = h.dtheta + noise (variance r), i.e. H = [h0 h1 h2 0 0 0]
+// P (covariance) and dx (error state) are updated in place
+//
+void ESKFscalarUpdate(float P[6][6], float dx[6], float h0, float h1, float h2, float innovation, float r) {
+    float PHt0, PHt1, PHt2, PHt3, PHt4, PHt5;
+    float K0, K1, K2, K3, K4, K5;
+    float invS;
+    
+    PHt0 = P[0][0] * h0 + P[0][1] * h1 + P[0][2] * h2;
+    PHt1 = P[1][0] * h0 + P[1][1] * h1 + P[1][2] * h2;
+    PHt2 = P[2][0] * h0 + P[2][1] * h1 + P[2][2] * h2;
+    PHt3 = P[3][0] * h0 + P[3][1] * h1 + P[3][2] * h2;
+    PHt4 = P[4][0] * h0 + P[4][1] * h1 + P[4][2] * h2;
+    PHt5 = P[5][0] * h0 + P[5][1] * h1 + P[5][2] * h2;
+    
+    invS = 1.0f / (h0 * PHt0 + h1 * PHt1 + h2 * PHt2 + r);
+    
+    // innovation, corrected by the error state already estimated by the previous scalar updates
+    innovation -= h0 * dx[0] + h1 * dx[1] + h2 * dx[2];
+    
+    K0 = PHt0 * invS;
+    K1 = PHt1 * invS;
+    K2 = PHt2 * invS;
+    K3 = PHt3 * invS;
+    K4 = PHt4 * invS;
+    K5 = PHt5 * invS;
+    
+    dx[0] += K0 * innovation;
+    dx[1] += K1 * innovation;
+    dx[2] += K2 * innovation;
+    dx[3] += K3 * innovation;
+    dx[4] += K4 * innovation;
+    dx[5] += K5 * innovation;
+    
+    // covariance update P = P - K.H.P (upper triangle, then mirrored)
+    P[0][0] -= K0 * PHt0;
+    P[0][1] -= K0 * PHt1;
+    P[0][2] -= K0 * PHt2;
+    P[0][3] -= K0 * PHt3;
+    P[0][4] -= K0 * PHt4;
+    P[0][5] -= K0 * PHt5;
+    P[1][1] -= K1 * PHt1;
+    P[1][2] -= K1 * PHt2;
+    P[1][3] -= K1 * PHt3;
+    P[1][4] -= K1 * PHt4;
+    P[1][5] -= K1 * PHt5;
+    P[2][2] -= K2 * PHt2;
+    P[2][3] -= K2 * PHt3;
+    P[2][4] -= K2 * PHt4;
+    P[2][5] -= K2 * PHt5;
+    P[3][3] -= K3 * PHt3;
+    P[3][4] -= K3 * PHt4;
+    P[3][5] -= K3 * PHt5;
+    P[4][4] -= K4 * PHt4;
+    P[4][5] -= K4 * PHt5;
+    P[5][5] -= K5 * PHt5;
+    P[1][0] = P[0][1];
+    P[2][0] = P[0][2];
+    P[2][1] = P[1][2];
+    P[3][0] = P[0][3];
+    P[3][1] = P[1][3];
+    P[3][2] = P[2][3];
+    P[4][0] = P[0][4];
+    P[4][1] = P[1][4];
+    P[4][2] = P[2][4];
+    P[4][3] = P[3][4];
+    P[5][0] = P[0][5];
+    P[5][1] = P[1][5];
+    P[5][2] = P[2][5];
+    P[5][3] = P[3][5];
+    P[5][4] = P[4][5];
+}
+
+
+//=====================================================================================================
+// function resetESKF
+//=====================================================================================================
+//
+// reset the bias estimate and the covariance of the error-state Kalman filter
+//
+void resetESKF(headtrackerData *trackingData) {
+    int i,j;
+    
+    for(i=0;i<6;i++)
+        for(j=0;j<6;j++)
+            trackingData->ESKFcovariance[i][j] = 0;
+    
+    for(i=0;i<3;i++) {
+        trackingData->ESKFcovariance[i][i] = ESKF_INITIAL_ATTITUDE_VARIANCE;
+        trackingData->ESKFcovariance[i+3][i+3] = ESKF_INITIAL_BIAS_VARIANCE;
+        trackingData->ESKFgyroBias[i] = 0;
+    }
+}
+
+
 
 
 //=====================================================================================================
@@ -1270,8 +2709,7 @@ int  processKeyValueSettingPair(headtrackerData *trackingData, char *keyBuffer,
             printf("firmware version OK\r\n");
         }
     } else if(strcmp(keyBuffer,"samplerate") == 0) {
-        trackingData->samplerate=strtol(valueBuffer,NULL,10);
-        trackingData->samplePeriod = 1.0f / trackingData->samplerate;
+        headtracker_setReceiverSamplerate(trackingData, strtol(valueBuffer,NULL,10));
         if(trackingData->verbose) printf("samplerate: %ld\r\n",trackingData->samplerate);
         if(UpdateHeadtrackerFlag) setSamplerate(trackingData, trackingData->samplerate, 0);
         
@@ -1418,6 +2856,34 @@ int  processKeyValueSettingPair(headtrackerData *trackingData, char *keyBuffer,
 }
 
 
+//=====================================================================================================
+// function processReceiverSettingPair
+//=====================================================================================================
+//
+// reads a key/value pair for one given parameter of the receiver (not transmitted to the head tracker), with the names
+// of the attributes of the Max external (see receiverSettings)
+// used to apply the settings of a recording header or of a text message
+//
+// returns 1 if the key is a receiver parameter, 0 otherwise
+//
+int processReceiverSettingPair(headtrackerData *trackingData, char *keyBuffer, char *valueBuffer) {
+    receiverSetting *setting;
+    
+    for(setting = receiverSettings; setting->name; setting++) {
+        if(strcmp(keyBuffer, setting->name) == 0) {
+            if(setting->charSetter) setting->charSetter(trackingData, (char) strtol(valueBuffer, NULL, 10));
+            else if(setting->longSetter) setting->longSetter(trackingData, strtol(valueBuffer, NULL, 10));
+            else setting->floatSetter(trackingData, (float) strtod(valueBuffer, NULL));
+            
+            if(trackingData->verbose) printf("receiver setting %s: %s\r\n", keyBuffer, valueBuffer);
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+
 
 //=====================================================================================================
 // function headtracker_open
@@ -1472,9 +2938,14 @@ void headtracker_close(headtrackerData *trackingData)
     if(trackingData->serialcomm->comhandle != INVALID_HANDLE_VALUE) {
         message = R2H_STOP_TRANSMISSION_CHAR;
         write_serial(trackingData->serialcomm,&message, 1); //stops sending raw data
+        
+        // store the gyroscope offset as tracked until now (drift since the end of the calibration)
+        if(trackingData->gyroOffsetAutocalOn && trackingData->gyroOffsetCalibratedState == 3)
+            storeGyroOffset(trackingData);
     }
     
     close_serial(trackingData->serialcomm);
+    trackingData->gyroOffsetStoreKey[0] = 0;
     
     headtracker_setReceptionStatus(trackingData,COMMUNICATION_STATE_NO_CONNECTED_HEADTRACKER);
 }
@@ -1626,8 +3097,109 @@ void center_angles(headtrackerData *trackingData) {
     trackingData->qref2 = - trackingData->q2;
     trackingData->qref3 = - trackingData->q3;
     trackingData->qref4 = - trackingData->q4;
+    
+    updateOutputTransform(trackingData);
+}
+
+//=====================================================================================================
+// function headtracker_hostTime2SampleTime
+//=====================================================================================================
+//
+// convert a time on the host clock (get_monotonic_time) into the time base of the headtracker timestamps
+//
+double headtracker_hostTime2SampleTime(headtrackerData *trackingData, double hostTime) {
+    return hostTime - trackingData->hostTimeOffset;
+}
+
+
+//=====================================================================================================
+// function headtracker_getResampledPose
+//=====================================================================================================
+//
+// centered quaternion and angles at the host time hostTime, interpolated in the history of the poses
+// (see libhedrot_resampling.c). Consumers running at their own rate should ask for a time slightly in the past
+// (at least the reception jitter plus half the smoothing time), so that the pose is interpolated and not clamped
+// (see headtracker_getPoseHistoryRange)
+//
+// lock-free: can be called from any thread (e.g. an audio callback asking for the pose at the presentation time
+// of its buffer), concurrently with headtracker_tick
+//
+// returns RESAMPLING_NO_DATA, RESAMPLING_OK or RESAMPLING_CLAMPED
+//
+char headtracker_getResampledPose(headtrackerData *trackingData, double hostTime, float *q1, float *q2, float *q3, float *q4, float *yaw, float *pitch, float *roll) {
+    char status;
+    
+    if(!trackingData->hostTimeOffsetValid) return RESAMPLING_NO_DATA;
+    
+    status = poseHistory_getPose(trackingData->outputPoseHistory, hostTime, q1, q2, q3, q4);
+    if(status == RESAMPLING_NO_DATA) return status;
+    
+    trackingData->quaternion2EulerAngles(*q1, *q2, *q3, *q4, yaw, pitch, roll);
+    
+    return status;
+}
+
+
+//=====================================================================================================
+// function headtracker_getResampledEstimate
+//=====================================================================================================
+//
+// estimated quaternion (before centering and change of axes) at the host time hostTime, interpolated in the history
+// of the estimates (OUTPUT_MASK_ESTIMATE_HISTORY). Unlike the centered quaternions, the estimates of several
+// headtrackers are expressed in the same earth frame (gravity and magnetic north) and can be combined
+// lock-free: can be called from any thread, concurrently with headtracker_tick
+//
+// returns RESAMPLING_NO_DATA, RESAMPLING_OK or RESAMPLING_CLAMPED
+//
+char headtracker_getResampledEstimate(headtrackerData *trackingData, double hostTime, float *q1, float *q2, float *q3, float *q4) {
+    if(!trackingData->hostTimeOffsetValid) return RESAMPLING_NO_DATA;
+    
+    return poseHistory_getPose(trackingData->estimatePoseHistory, hostTime, q1, q2, q3, q4);
+}
+
+
+//=====================================================================================================
+// function headtracker_getPoseHistoryRange
+//=====================================================================================================
+//
+// host times of the oldest and newest poses of the history: window in which headtracker_getResampledPose interpolates
+// lock-free, can be called from any thread
+//
+// returns 0 if no pose is available, 1 otherwise
+//
+char headtracker_getPoseHistoryRange(headtrackerData *trackingData, double *oldestHostTime, double *newestHostTime) {
+    if(!trackingData->hostTimeOffsetValid) return 0;
+    
+    return poseHistory_getTimeRange(trackingData->outputPoseHistory, oldestHostTime, newestHostTime);
 }
 
+
+//=====================================================================================================
+// function headtracker_getBlockPoses
+//=====================================================================================================
+//
+// centered quaternions for an audio block (blockLength samples starting at the audio clock time blockStartSampleTime),
+// one per sub-block of subBlockLength samples (1 = one per sample), interpolated in the history of the poses
+// mapping converts the audio clock to the host clock: it should be updated by the audio callback with the timestamps
+// given by the audio API (see audioClockMapping_update). As for headtracker_getResampledPose, the block should be
+// slightly in the past (e.g. by shifting blockStartSampleTime), so that the poses are interpolated and not clamped
+//
+// the renderer can then rotate smoothly within the block, at the resolution of the tracking data
+// lock-free: can be called from the audio callback, concurrently with headtracker_tick
+// quaternions must have room for 4*ceil(blockLength/subBlockLength) floats (W,X,Y,Z interleaved)
+//
+// returns the number of poses that could be interpolated (0 if no pose is available yet: identity quaternions)
+//
+long headtracker_getBlockPoses(headtrackerData *trackingData, audioClockMapping *mapping, double blockStartSampleTime, long blockLength, long subBlockLength, float *quaternions) {
+    long numberOfValidPoses;
+    
+    numberOfValidPoses = poseHistory_getBlockPoses(trackingData->outputPoseHistory, mapping, blockStartSampleTime, blockLength, subBlockLength, quaternions);
+    
+    // before the first estimation of the host time offset, the timestamps of the history are not on the host clock
+    return trackingData->hostTimeOffsetValid ? numberOfValidPoses : 0;
+}
+
+
 //=====================================================================================================
 // "public" setters for receiver parameters
 //=====================================================================================================
@@ -1667,6 +3239,18 @@ void setGyroOffsetAutocalOn(headtrackerData *trackingData, char gyroOffsetAutoca
 }
 
 
+void setGyroOffsetStoreFilename(headtrackerData *trackingData, char *gyroOffsetStoreFilename) {
+    strncpy(trackingData->gyroOffsetStoreFilename, gyroOffsetStoreFilename, MAX_GYRO_OFFSET_STORE_FILENAME_LENGTH - 1);
+    trackingData->gyroOffsetStoreFilename[MAX_GYRO_OFFSET_STORE_FILENAME_LENGTH - 1] = 0;
+    
+    // the offsets are kept in memory, the file is not accessed while receiving
+    import_gyroOffsetStore(trackingData);
+}
+
+
+// the window of the bias tracker is limited to GYRO_BIAS_TRACKER_MAX_WINDOW_LENGTH samples (e.g. about 30 s at 2 kHz):
+// a longer time is clamped when the window is updated, with the notification
+// NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED (see updateGyroBiasTrackerWindowLength)
 void setGyroOffsetAutocalTime(headtrackerData *trackingData, float gyroOffsetAutocalTime) {
     trackingData->gyroOffsetAutocalTime = gyroOffsetAutocalTime;
 }
@@ -1678,7 +3262,15 @@ void setGyroOffsetAutocalThreshold(headtrackerData *trackingData, long gyroOffse
 
 
 void setEstimationMethod(headtrackerData *trackingData, char estimationMethod) {
-     trackingData->estimationMethod = estimationMethod;
+    // restart the Kalman filter from scratch when it gets selected
+    if(estimationMethod == 2 && trackingData->estimationMethod != 2)
+        resetESKF(trackingData);
+    
+    // coming from gyroscope integration only: the drifted attitude is replaced by the one given by the accelerometer and the magnetometer
+    if(estimationMethod != 1 && trackingData->estimationMethod == 1)
+        trackingData->attitudeInitialized = 0;
+    
+    trackingData->estimationMethod = estimationMethod;
 }
 
 
@@ -1698,11 +3290,102 @@ void setAccLPtimeConstant(headtrackerData *trackingData, float accLPtimeConstant
 }
 
 
+void setInitialConvergenceTime(headtrackerData *trackingData, float initialConvergenceTime) {
+    trackingData->initialConvergenceTime = max(initialConvergenceTime, 0);
+}
+
+void setMagDisturbanceGatingOn(headtrackerData *trackingData, char magDisturbanceGatingOn) {
+    trackingData->magDisturbanceGatingOn = magDisturbanceGatingOn;
+    if(!magDisturbanceGatingOn) trackingData->magDisturbanceWeight = 1.0f;
+}
+
+void setMagDisturbanceNormThreshold(headtrackerData *trackingData, float magDisturbanceNormThreshold) {
+    trackingData->magDisturbanceNormThreshold = max(magDisturbanceNormThreshold, .001f);
+}
+
+void setMagDisturbanceInclinationThreshold(headtrackerData *trackingData, float magDisturbanceInclinationThreshold) {
+    trackingData->magDisturbanceInclinationThreshold = max(magDisturbanceInclinationThreshold, .01f);
+}
+
+void setGyroIntegrationMethod(headtrackerData *trackingData, char gyroIntegrationMethod) {
+    trackingData->gyroIntegrationMethod = min(max(gyroIntegrationMethod, 0), 1);
+    
+    trackingData->previousGyroIncrement[0] = 0;
+    trackingData->previousGyroIncrement[1] = 0;
+    trackingData->previousGyroIncrement[2] = 0;
+}
+
+void setIdleModeOn(headtrackerData *trackingData, char idleModeOn) {
+    // when switched off, the idle mode ends at the next frame
+    trackingData->idleModeOn = idleModeOn;
+}
+
+void setIdleGyroThreshold(headtrackerData *trackingData, float idleGyroThreshold) {
+    trackingData->idleGyroThreshold = max(idleGyroThreshold, 0);
+}
+
+void setIdleAccThreshold(headtrackerData *trackingData, float idleAccThreshold) {
+    trackingData->idleAccThreshold = max(idleAccThreshold, 0);
+}
+
+void setIdleDecimationFactor(headtrackerData *trackingData, long idleDecimationFactor) {
+    trackingData->idleDecimationFactor = max(idleDecimationFactor, 1);
+}
+
+void setIdleHeartbeatPeriod(headtrackerData *trackingData, float idleHeartbeatPeriod) {
+    trackingData->idleHeartbeatPeriod = max(idleHeartbeatPeriod, 0);
+}
+
+void setDeadbandOn(headtrackerData *trackingData, char deadbandOn) {
+    trackingData->deadbandOn = deadbandOn;
+    trackingData->deadbandPublishedOutputs = 0; // publish everything at the next call of headtracker_outputDue
+}
+
+void setDeadbandQuaternionAngle(headtrackerData *trackingData, float deadbandQuaternionAngle) {
+    trackingData->deadbandQuaternionAngle = max(deadbandQuaternionAngle, 0);
+    trackingData->deadbandQuaternionCosine = (float) cos(trackingData->deadbandQuaternionAngle * DEGREE_TO_RAD * .5f);
+}
+
+void setDeadbandEulerAngle(headtrackerData *trackingData, float deadbandEulerAngle) {
+    trackingData->deadbandEulerAngle = max(deadbandEulerAngle, 0);
+}
+
+void setDeadbandMaxSilence(headtrackerData *trackingData, float deadbandMaxSilence) {
+    trackingData->deadbandMaxSilence = max(deadbandMaxSilence, 0);
+}
+
+void setMagMultirateOn(headtrackerData *trackingData, char magMultirateOn) {
+    trackingData->magMultirateOn = magMultirateOn;
+}
+
+
+void setESKFgyroNoise(headtrackerData *trackingData, float ESKFgyroNoise) {
+    trackingData->ESKFgyroNoise = max(ESKFgyroNoise, 0);
+}
+
+
+void setESKFgyroBiasNoise(headtrackerData *trackingData, float ESKFgyroBiasNoise) {
+    trackingData->ESKFgyroBiasNoise = max(ESKFgyroBiasNoise, 0);
+}
+
+
+void setESKFaccNoise(headtrackerData *trackingData, float ESKFaccNoise) {
+    // strictly positive, since the Kalman filter divides by the measurement variance
+    trackingData->ESKFaccNoise = max(ESKFaccNoise, .0001f);
+}
+
+
+void setESKFmagNoise(headtrackerData *trackingData, float ESKFmagNoise) {
+    trackingData->ESKFmagNoise = max(ESKFmagNoise, .0001f);
+}
+
+
 //=====================================================================================================
 // public setter to change axes reference
 //=====================================================================================================
 void setAxesReference(headtrackerData *trackingData, char axesReference) {
     trackingData->axesReference = axesReference;
+    updateOutputTransform(trackingData);
 }
 
 
@@ -1711,6 +3394,7 @@ void setAxesReference(headtrackerData *trackingData, char axesReference) {
 //=====================================================================================================
 void setRotationOrder(headtrackerData *trackingData, char rotationOrder) {
     trackingData->rotationOrder = rotationOrder;
+    updateOutputTransform(trackingData);
 }
 
 
@@ -1719,6 +3403,70 @@ void setRotationOrder(headtrackerData *trackingData, char rotationOrder) {
 //=====================================================================================================
 void setInvertRotation(headtrackerData *trackingData, char invertRotation){
     trackingData->invertRotation = invertRotation;
+    updateOutputTransform(trackingData);
+}
+
+
+//=====================================================================================================
+// public setter to change the computation of the euler angles (0 = standard library, 1 = fast approximations)
+//=====================================================================================================
+void setFastAnglesOn(headtrackerData *trackingData, char fastAnglesOn){
+    trackingData->fastAnglesOn = fastAnglesOn;
+    updateOutputTransform(trackingData);
+}
+
+
+//=====================================================================================================
+// public setters to change the latency compensation (look-ahead in seconds, damping between 0 and 1)
+//=====================================================================================================
+void setPredictionTime(headtrackerData *trackingData, float predictionTime) {
+    trackingData->predictionTime = max(predictionTime, 0);
+}
+
+void setPredictionDamping(headtrackerData *trackingData, float predictionDamping) {
+    trackingData->predictionDamping = min(max(predictionDamping, 0), 1);
+}
+
+
+//=====================================================================================================
+// public setter to change the max order of the spherical harmonic rotation matrices (0 = not computed)
+//=====================================================================================================
+void setSHrotationOrder(headtrackerData *trackingData, long SHrotationOrder) {
+    trackingData->SHrotationOrder = min(max(SHrotationOrder, 0), SH_ROTATION_MAX_ORDER);
+    if(trackingData->SHrotationOrder > 0)
+        SHrotation_setOrder(trackingData->outputSHrotation, trackingData->SHrotationOrder);
+    
+    trackingData->outputsUpToDate = 0;
+    trackingData->deadbandPublishedOutputs &= ~OUTPUT_MASK_SH_ROTATION; // publish the new matrices without delay
+}
+
+
+//=====================================================================================================
+// public setters to change the resampling of the output poses (interpolation method, anti-alias window in seconds)
+//=====================================================================================================
+void setResamplingMethod(headtrackerData *trackingData, char resamplingMethod) {
+    poseHistory_setInterpolationMethod(trackingData->outputPoseHistory, resamplingMethod);
+    poseHistory_setInterpolationMethod(trackingData->estimatePoseHistory, resamplingMethod);
+}
+
+void setResamplingSmoothingTime(headtrackerData *trackingData, float resamplingSmoothingTime) {
+    poseHistory_setSmoothingTime(trackingData->outputPoseHistory, resamplingSmoothingTime);
+    poseHistory_setSmoothingTime(trackingData->estimatePoseHistory, resamplingSmoothingTime);
+}
+
+
+//=====================================================================================================
+// public setter to change the outputs needed by the consumers (combination of OUTPUT_MASK_* flags)
+//=====================================================================================================
+void setOutputMask(headtrackerData *trackingData, long outputMask) {
+    // the histories restart from scratch when switched on again (no interpolation across the gap)
+    if((outputMask & OUTPUT_MASK_POSE_HISTORY) && !(trackingData->outputMask & OUTPUT_MASK_POSE_HISTORY))
+        initPoseHistory(trackingData->outputPoseHistory);
+    if((outputMask & OUTPUT_MASK_ESTIMATE_HISTORY) && !(trackingData->outputMask & OUTPUT_MASK_ESTIMATE_HISTORY))
+        initPoseHistory(trackingData->estimatePoseHistory);
+    
+    trackingData->outputMask = outputMask & OUTPUT_MASK_ALL;
+    trackingData->outputsUpToDate = 0;
 }
 
 //=====================================================================================================
@@ -1789,13 +3537,7 @@ void setAccCalibratingFlag(headtrackerData *trackingData, char accCalibratingFla
 void setSamplerate(headtrackerData *trackingData, long samplerate, char requestSettingsFlag) {
     unsigned char message[3];
     
-    trackingData->samplerate = max(min(samplerate,65535),2);
-    trackingData->samplePeriod = 1.0f / trackingData->samplerate;
-    
-    // recalculate receiver parameters based on samplerate
-    trackingData->accLPalpha = 1 - (float) exp(-trackingData->samplePeriod/trackingData->accLPtimeConstant);
-    
-    changeRTMagCalTimeSettings(trackingData);
+    headtracker_setReceiverSamplerate(trackingData, samplerate);
     
     message[0] = R2H_TRANSMIT_SAMPLERATE;
     message[1] = (unsigned char) (trackingData->samplerate%256); //least significant byte first, then most significant byte
@@ -2047,6 +3789,19 @@ void setRTmagMaxDistanceError(headtrackerData *trackingData, float RTmagMaxDista
 //=====================================================================================================
 // "private" setters
 //=====================================================================================================
+
+// samplerate of the received frames and the receiver parameters depending on it (not transmitted to the headtracker)
+void headtracker_setReceiverSamplerate(headtrackerData *trackingData, long samplerate) {
+    trackingData->samplerate = max(min(samplerate,65535),2);
+    trackingData->samplePeriod = 1.0f / trackingData->samplerate;
+    
+    // recalculate receiver parameters based on samplerate
+    trackingData->accLPalpha = 1 - (float) exp(-trackingData->samplePeriod/trackingData->accLPtimeConstant);
+    trackingData->predictionLPalpha = 1 - (float) exp(-trackingData->samplePeriod/PREDICTION_LP_TIME_CONSTANT);
+    
+    changeRTMagCalTimeSettings(trackingData);
+}
+
 void headtracker_setReceptionStatus(headtrackerData *trackingData, int n) {
     trackingData->infoReceptionStatus = n;
     if(trackingData->verbose) printf("new reception status: %d \r\n",trackingData->infoReceptionStatus);
@@ -2062,17 +3817,63 @@ void headtracker_setReceptionStatus(headtrackerData *trackingData, int n) {
         trackingData->accLPstate[2] = 0;
         
         
-        //initialization of the quaternions
+        //initialization of the quaternions (replaced by the attitude given by the first valid frame, see initializeAttitude)
         trackingData->q1 = 1.0;
         trackingData->q2 = 0.0;
         trackingData->q3 = 0.0;
         trackingData->q4 = 0.0;
+        trackingData->attitudeInitialized = 0;
+        trackingData->initialConvergenceCounter = 0;
+        trackingData->previousGyroIncrement[0] = 0;
+        trackingData->previousGyroIncrement[1] = 0;
+        trackingData->previousGyroIncrement[2] = 0;
+        
+        // new session: new references for the magnetic disturbance detection
+        resetMagDisturbance(trackingData);
+        
+        // new session: full rate until the headtracker is found still
+        resetIdleMode(trackingData);
+        
+        // the first pose of the session is always published
+        trackingData->deadbandPublishedOutputs = 0;
+        
+        // no magnetometer correction until the first magnetometer sample is received
+        trackingData->magDataNorm[0] = 0;
+        trackingData->magDataNorm[1] = 0;
+        trackingData->magDataNorm[2] = 0;
+        trackingData->magReference[0] = 0;
+        trackingData->magReference[1] = 0;
+        
+        trackingData->magFramesSinceUpdate = 1;
+        trackingData->magHoldLength = 1;
+        
+        // reset the timestamps and the pose histories
+        trackingData->sampleCounter = 0;
+        trackingData->sampleTimestamp = 0;
+        trackingData->hostTimeOffsetValid = 0;
+        initPoseHistory(trackingData->outputPoseHistory);
+        initPoseHistory(trackingData->estimatePoseHistory);
+        
+        // reset the prediction state
+        trackingData->gyroDataLP[0] = 0;
+        trackingData->gyroDataLP[1] = 0;
+        trackingData->gyroDataLP[2] = 0;
+        trackingData->angularAcceleration[0] = 0;
+        trackingData->angularAcceleration[1] = 0;
+        trackingData->angularAcceleration[2] = 0;
+        trackingData->qpred1 = 1.0;
+        trackingData->qpred2 = 0.0;
+        trackingData->qpred3 = 0.0;
+        trackingData->qpred4 = 0.0;
         
         trackingData->rawDataBufferIndex = 0;
         
         // reset gyro auto calibration variables
         trackingData->gyroOffsetCalibratedState = 0;
         resetGyroOffsetCalibration(trackingData);
+        
+        // reset the Kalman filter
+        resetESKF(trackingData);
     }
     
     
@@ -2126,25 +3927,6 @@ void headtracker_sendSignedCharArray2Headtracker(headtrackerData *trackingData,
 }
 
 
-void changeQuaternionReference(headtrackerData *trackingData) {
-    // change the axes references of the quaternion if it does not fit the standard (X->right, Y->back, Z->down)
-    float qtemp;
-    switch (trackingData->axesReference) {
-        case 1: // X->right, Y->front, Z->up
-            trackingData->qcent3 *= -1.0f; // Y -> -Y
-            trackingData->qcent4 *= -1.0f; // Z -> -Z
-            break;
-        case 2: //X->front, Y->left, Z->up
-            qtemp = trackingData->qcent2; // store X
-            trackingData->qcent2 = -trackingData->qcent3; // Y -> -X
-            trackingData->qcent3 = -qtemp; // X -> -Y
-            trackingData->qcent4 *= -1.0f; // Z -> -Z
-            break;
-            // if 0 does nothing
-    }
-    
-}
-
 void changeRTMagCalTimeSettings(headtrackerData *trackingData) {
     // update all timing constants in samples based on their values in seconds
     
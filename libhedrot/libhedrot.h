@@ -19,6 +19,10 @@
 #include "libhedrot_serialcomm.h"
 #include "libhedrot_calibration.h"
 #include "libhedrot_RTmagCalibration.h"
+#include "libhedrot_resampling.h"
+#include "libhedrot_fastmath.h"
+#include "libhedrot_gyroBiasTracker.h"
+#include "libhedrot_SHrotation.h"
 
 
 // hedrot version
@@ -34,6 +38,48 @@
 #define PINGTIME                0.5  // time delay in seconds between two pings when the headtracker has been found
 #define AUTODISCOVER_MAX_TIME   0.1  // max time period in seconds between autodiscover ping and headtracker response
 
+// initial uncertainty of the error-state Kalman filter
+#define ESKF_INITIAL_ATTITUDE_VARIANCE  .1f     // in rad^2
+#define ESKF_INITIAL_BIAS_VARIANCE      .0001f  // in (rad/s)^2
+
+// time constant of the low-pass filter applied on the angular rate before estimating the angular acceleration (prediction)
+#define PREDICTION_LP_TIME_CONSTANT     .02f    // in seconds
+
+// time constant of the low-pass filter estimating the offset between the host clock and the headtracker clock
+#define HOST_TIME_OFFSET_TIME_CONSTANT  1.0     // in seconds
+
+// gain factor applied to MadgwickBetaMax during the convergence phase following the initialization of the attitude
+#define INITIAL_CONVERGENCE_BETA_FACTOR 4
+
+// stored gyroscope offsets (see export_gyroOffsetStore)
+#define MAX_GYRO_OFFSET_STORE_FILENAME_LENGTH   1024
+#define MAX_NUMBER_OF_STORED_GYRO_OFFSETS       64  // max number of board/samplerate combinations kept in the file
+#define GYRO_OFFSET_STORE_KEY_LENGTH            32
+
+// magnetic disturbance detection (see updateMagDisturbance)
+#define MAG_DISTURBANCE_REFERENCE_TIME_CONSTANT 10.0f   // in seconds, time constant of the references (norm and inclination of the undisturbed field)
+#define MAG_DISTURBANCE_MAX_DURATION            10.0f   // in seconds, a longer disturbance is considered as a new magnetic environment
+
+// idle mode (see updateStillness)
+#define IDLE_MODE_DELAY                 1.0f    // in seconds, duration of the still state before switching to idle mode
+#define STILLNESS_ACC_TIME_CONSTANT     .1f     // in seconds, time constant of the running mean and variance of the accelerometer data
+
+// max number of frames a magnetometer sample is considered to be held by the headtracker (multi-rate fusion)
+#define MAX_MAG_HOLD_LENGTH             100
+
+// output mask: outputs needed by the consumers (see setOutputMask and headtracker_updateOutputs)
+// raw and calibrated data are always computed (needed by the estimation), their flags only tell the publishers whether to send them
+// (see hedrot_receiver_output_data, the other front ends do not publish them)
+#define OUTPUT_MASK_RAW_DATA            1   // raw data of the three sensors
+#define OUTPUT_MASK_CALIBRATED_DATA     2   // calibrated data of the three sensors
+#define OUTPUT_MASK_QUATERNION          4   // centered quaternion (qcent1..4)
+#define OUTPUT_MASK_ANGLES              8   // euler angles (yaw, pitch, roll, and predictedYaw... if the prediction is on)
+#define OUTPUT_MASK_PREDICTION          16  // predicted quaternion (qpred1..4)
+#define OUTPUT_MASK_POSE_HISTORY        32  // history of the centered quaternions, for headtracker_getResampledPose
+#define OUTPUT_MASK_SH_ROTATION         64  // rotation matrices of the spherical harmonics (outputSHrotation), if SHrotationOrder > 0
+#define OUTPUT_MASK_ESTIMATE_HISTORY    128 // history of the estimated (not centered) quaternions, for headtracker_getResampledEstimate
+#define OUTPUT_MASK_ALL                 255
+
 
 
 // communication states
@@ -65,6 +111,9 @@
 #define NOTIFICATION_MESSAGE_CALIBRATION_NOT_VALID      9
 #define NOTIFICATION_MESSAGE_GYRO_CALIBRATION_STARTED   10
 #define NOTIFICATION_MESSAGE_GYRO_CALIBRATION_FINISHED  11
+#define NOTIFICATION_MESSAGE_GYRO_CALIBRATION_RESTORED  12
+#define NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED  13
+#define NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED 14
 #define NOTIFICATION_MESSAGE_MAG_CALIBRATION_STARTED    21
 #define NOTIFICATION_MESSAGE_MAG_CALIBRATION_SUCCEEDED  22
 #define NOTIFICATION_MESSAGE_MAG_CALIBRATION_FAILED     23
@@ -78,6 +127,10 @@
 #define NOTIFICATION_MESSAGE_MAG_RT_CALIBRATION_SUCCEEDED 40
 #define NOTIFICATION_MESSAGE_EXPORT_RTMAGCALDATARAWSAMPLES_FAILED 41
 #define NOTIFICATION_MESSAGE_BOARD_OVERLOAD             50
+#define NOTIFICATION_MESSAGE_MAG_DISTURBANCE_STARTED    60
+#define NOTIFICATION_MESSAGE_MAG_DISTURBANCE_ENDED      61
+#define NOTIFICATION_MESSAGE_IDLE_MODE_STARTED          70
+#define NOTIFICATION_MESSAGE_IDLE_MODE_ENDED            71
 
 
 //=====================================================================================================
@@ -102,13 +155,47 @@ typedef struct _headtrackerData {
     // estimation method
     // 0 = Madgwick 9 Axes
     // 1 = gyroscope integration only (no magnetometer)
+    // 2 = error-state Kalman filter 9 Axes, with online estimation of the gyroscope bias
     char            estimationMethod;
     
+    // integration of the gyroscope data (all estimation methods)
+    // 0 = first order (q += qDot.dt, then normalisation)
+    // 1 = exponential map with coning correction (exact for a constant rotation, accurate at lower samplerates)
+    char            gyroIntegrationMethod;
+    
     // angle estimation coefficients
     float           MadgwickBetaMax;
     float           MadgwickBetaGain;
     float           accLPtimeConstant; // lowpass filter time constant in seconds for the accel data
     float           accLPalpha; // lowpass filter coefficient for the accel data (internal)
+    float           initialConvergenceTime; // duration in seconds of the high-gain phase (Madgwick) after the initialization of the attitude
+    char            magDisturbanceGatingOn; // if 1, the magnetometer correction is reduced or skipped while the magnetic field is disturbed (off by default)
+    float           magDisturbanceNormThreshold; // relative deviation of the norm of the magnetic field from its reference above which the field is considered disturbed
+    float           magDisturbanceInclinationThreshold; // deviation of the inclination of the magnetic field from its reference (in degrees) above which the field is considered disturbed
+    // multi-rate fusion, off by default: the frames between two magnetometer samples are cheaper, the Kalman filter keeps its
+    // accuracy (its magnetometer noise is scaled by the number of held frames), but the Madgwick filter corrects the heading once
+    // per magnetometer sample instead of every frame, less accurate while moving when the samplerate is much higher than the
+    // magnetometer rate
+    char            magMultirateOn; // if 1, the magnetometer is only fused (Madgwick gradient step, Kalman filter correction) when the magnetometer provides a new sample
+    
+    // idle mode: when the headtracker stays still, the estimation runs at a reduced rate and the outputs are only due at a low rate
+    char            idleModeOn;
+    float           idleGyroThreshold; // max norm of the angular rate in the still state, in rad/s
+    float           idleAccThreshold; // max standard deviation of the accelerometer data in the still state, normalized units (1 = 1g)
+    long            idleDecimationFactor; // in idle mode, the estimation runs once every idleDecimationFactor frames
+    float           idleHeartbeatPeriod; // in idle mode, period of the outputs (see headtracker_outputDue), in seconds
+    
+    // deadband: the pose outputs are only due when they changed by more than a threshold since they were last published
+    char            deadbandOn;
+    float           deadbandQuaternionAngle; // min rotation angle between two published quaternions (centered and predicted), in degrees
+    float           deadbandEulerAngle; // min change of one of the published euler angles, in degrees
+    float           deadbandMaxSilence; // max time between two publications of an output (heartbeat), in seconds (0 = no heartbeat)
+    
+    // error-state Kalman filter settings (standard deviations)
+    float           ESKFgyroNoise; // gyroscope noise, in rad/s
+    float           ESKFgyroBiasNoise; // gyroscope bias random walk, in rad/s/sqrt(s)
+    float           ESKFaccNoise; // accelerometer noise, normalized units (1 = 1g)
+    float           ESKFmagNoise; // magnetometer noise, normalized units (1 = norm of the earth magnetic field)
     
     // axes reference setting
     // 0: X->right, Y->back, Z->down
@@ -126,6 +213,24 @@ typedef struct _headtrackerData {
     // 1: invert
     char            invertRotation;
     
+    // computation of the euler angles
+    // 0: standard library (atan2, asin in double precision)
+    // 1: fast approximations (see libhedrot_fastmath.h, max error FAST_ATAN2_MAX_ERROR_DEGREES)
+    char            fastAnglesOn;
+    
+    // latency compensation: the output orientation is extrapolated forward by predictionTime
+    float           predictionTime; // look-ahead in seconds (0 = no prediction)
+    float           predictionDamping; // 0 = full extrapolation, 1 = no extrapolation (reduces overshoot on fast head turns)
+    float           predictionLPalpha; // lowpass filter coefficient for the angular rate (internal)
+    
+    // rotation matrices of the real spherical harmonics (ambisonics), computed from the centered quaternion, i.e. in the
+    // output axes (axesReference 2 for the ambisonic convention X->front, Y->left, Z->up). The matrices rotate a sound field
+    // with the head: to keep a sound field fixed while the head turns, invert the rotation (invertRotation)
+    long            SHrotationOrder; // max order of the matrices (0 = not computed, max SH_ROTATION_MAX_ORDER)
+    
+    // outputs needed by the consumers, combination of OUTPUT_MASK_* flags (the outputs that are not requested are not computed)
+    long            outputMask;
+    
     // sensor infos and settings
     char            sensorBoardType; //headtracker sensor board type
     char            firmwareVersion; //headtracker firmware version
@@ -163,12 +268,14 @@ typedef struct _headtrackerData {
     
     //---------------  calibration internal values und settings -------------------
     float           gyroOffset[3];
-    float           gyroOffsetAutocalTime; // in ms
+    float           gyroOffsetAutocalTime; // in ms, length of the sliding window of the bias tracker
     long            gyroOffsetAutocalThreshold; //in LSB units
-    long            gyroOffsetAutocalCounter; //internal
-    long            gyroOffsetAutocalMin[3]; //internal, in LSB units
-    long            gyroOffsetAutocalMax[3]; //internal, in LSB units
-    long            gyroOffsetAutocalSum[3]; //internal, in LSB units
+    char            gyroOffsetStoreFilename[MAX_GYRO_OFFSET_STORE_FILENAME_LENGTH]; // file where the calibrated offsets are stored (per board and samplerate), disabled if empty
+    char            gyroOffsetStoreKey[GYRO_OFFSET_STORE_KEY_LENGTH]; // internal, key of the connected board in the store (see getGyroOffsetStoreKey)
+    char            gyroOffsetStoreKeys[MAX_NUMBER_OF_STORED_GYRO_OFFSETS][GYRO_OFFSET_STORE_KEY_LENGTH]; // internal, copy of the store file
+    float           gyroOffsetStoreValues[MAX_NUMBER_OF_STORED_GYRO_OFFSETS][3]; // internal, copy of the store file
+    int             numberOfStoredGyroOffsets; // internal
+    gyroBiasTracker* gyroBiasTrackerData; //internal, continuous estimation of the offset (see libhedrot_gyroBiasTracker.c)
     float           gyroscopeCalibrationFactor; //internal, in rad/sec/LSB
     char            gyroOffsetCalibratedState; // internal
     long            gyroHalfScaleSensitivity; // internal
@@ -206,6 +313,9 @@ typedef struct _headtrackerData {
     short           magRawData[3];
     short           accRawData[3];
     short           gyroRawData[3];
+    char            magDataFresh; // 1 if the magnetometer data has been updated in the last frame (detected by a change of the raw value)
+    short           magFramesSinceUpdate; // number of frames received since the last magnetometer update
+    short           magHoldLength; // number of frames the previous magnetometer sample has been held
     
     // calibrated data pro sensor
     float           magCalData[3];
@@ -225,15 +335,78 @@ typedef struct _headtrackerData {
     // centered quaternion
     float           qcent1, qcent2, qcent3, qcent4;
     
+    // predicted (latency-compensated) quaternion and angles, same conventions as qcent and yaw/pitch/roll
+    float           qpred1, qpred2, qpred3, qpred4;
+    float           predictedYaw, predictedPitch, predictedRoll;
+    
+    // the outputs above are computed on demand (see headtracker_updateOutputs), these flags tell if they match the latest frame
+    char            outputsUpToDate;
+    char            centeredQuaternionUpToDate;
+    
     // internal variables for the computation of the angles
     float           accCalDataLP[3]; // low-pass filtered acc data
     float           accLPstate[3]; // history
     float           beta; //dynamically calculated
+    float           previousGyroIncrement[3]; // rotation vector of the previous frame (gyroIntegrationMethod 1), in rad
+    char            attitudeInitialized; // 0 until the quaternion has been initialized from the accelerometer and magnetometer (see initializeAttitude)
+    long            initialConvergenceCounter; // remaining number of frames of the high-gain phase
+    float           magDataNorm[3]; // last normalized magnetometer sample, held between two magnetometer updates
+    char            magDisturbed; // 1 while the magnetic field is disturbed (see updateMagDisturbance)
+    float           magDisturbanceWeight; // weight of the magnetometer correction, from 1 (undisturbed) to 0 (disturbed)
+    char            magDisturbanceReferenceValid; // 0 until the references have been initialized
+    float           magNormReference; // norm of the undisturbed calibrated magnetic field
+    float           magInclinationReference; // inclination of the undisturbed magnetic field, in degrees
+    float           magDisturbanceDuration; // in seconds
+    char            idle; // 1 in idle mode (see updateStillness)
+    float           stillDuration; // duration of the current still state, in seconds
+    float           accMean[3]; // running mean of the accelerometer data (stillness detection)
+    float           accVariance; // running variance of the accelerometer data (sum of the 3 axes)
+    float           idleGyroSum[3]; // in idle mode, sum of the angular rates of the frames since the last estimation
+    long            idleFrameCounter; // in idle mode, number of frames since the last estimation
+    char            idleMagDataFresh; // in idle mode, 1 if a new magnetometer sample has been received since the last estimation
+    char            estimationUpdated; // 0 if the estimation has been skipped for the current frame (idle mode)
+    double          lastIdleOutputTime; // host time of the last output due in idle mode
+    float           deadbandQuaternionCosine; // cosine of half deadbandQuaternionAngle (internal)
+    long            deadbandPublishedOutputs; // outputs published at least once since the beginning of the transmission (output mask)
+    float           publishedQuaternion[4]; // last published centered quaternion
+    float           publishedAngles[3]; // last published euler angles
+    float           publishedPredictedQuaternion[4]; // last published predicted quaternion
+    double          quaternionPublicationTime, anglesPublicationTime, predictionPublicationTime; // host times of the last publications
+    float           publishedSHrotationQuaternion[4]; // centered quaternion of the last published spherical harmonic rotation matrices
+    double          SHrotationPublicationTime; // host time of the last publication of the spherical harmonic rotation matrices
+    float           magReference[2]; // last reference direction of the Earth's magnetic field (horizontal and vertical components, times 2)
+    float           ESKFcovariance[6][6]; // covariance of the error state (attitude, gyro bias) of the Kalman filter
+    float           ESKFgyroBias[3]; // gyroscope bias estimated by the Kalman filter, in rad/s
+    float           gyroDataLP[3]; // low-pass filtered angular rate, in rad/s
+    float           angularAcceleration[3]; // estimated angular acceleration, in rad/s^2
+    
+    // output transform, precomputed by updateOutputTransform from qref, axesReference, invertRotation, rotationOrder and fastAnglesOn
+    // output quaternion = outputTransformSign * (outputTransformLeft x q x outputTransformRight) (component-wise sign)
+    float           outputTransformLeft[4];
+    float           outputTransformRight[4];
+    float           outputTransformSign[4];
+    quaternion2EulerFunction quaternion2EulerAngles; // conversion to euler angles according to the rotation order
     
     // internal variables for timing
     double          scheduledNextPingTime;
     double          autodiscoverResponseTimeLimit;
     
+    // timestamps of the frames, on the headtracker clock (number of received frames * sample period, no jitter)
+    long            sampleCounter; // number of frames received since the beginning of the transmission
+    double          sampleTimestamp; // timestamp of the current frame, in seconds
+    double          hostTimeOffset; // estimated host time (get_monotonic_time) - headtracker time, in seconds
+    char            hostTimeOffsetValid; // 0 until the first estimation of hostTimeOffset
+    
+    // history of the centered quaternions, for resampling at arbitrary time points
+    poseHistory*    outputPoseHistory;
+    
+    // history of the estimated quaternions (earth frame of the estimation, before centering and change of axes),
+    // for combining several headtrackers (see libhedrot_relativeOrientation)
+    poseHistory*    estimatePoseHistory;
+    
+    // rotation matrices of the spherical harmonics for the centered quaternion (see SHrotationOrder)
+    SHrotation*     outputSHrotation;
+    
     // notification message FIFO list (implemented as a circular buffer)
     int             numberOfMessages;
     int             firstMessageToNotify;
@@ -242,6 +415,23 @@ typedef struct _headtrackerData {
 } headtrackerData;
 
 
+//=====================================================================================================
+// structure definition: receiverSetting
+//=====================================================================================================
+//
+// receiver parameter accessible by name (see processReceiverSettingPair)
+// one of the three setters is defined, depending on the type of the value
+//
+typedef struct _receiverSetting {
+    const char          *name;
+    void                (*charSetter)(headtrackerData *trackingData, char value);
+    void                (*longSetter)(headtrackerData *trackingData, long value);
+    void                (*floatSetter)(headtrackerData *trackingData, float value);
+} receiverSetting;
+
+extern receiverSetting receiverSettings[];
+
+
 //=====================================================================================================
 // "public" functions declarations
 //=====================================================================================================
@@ -249,6 +439,7 @@ headtrackerData* headtracker_new();
 void headtracker_free(headtrackerData* trackingData);
 void headtracker_init(headtrackerData *trackingData);
 void headtracker_tick(headtrackerData *trackingData);
+void headtracker_compute_rawData(headtrackerData *trackingData, short *magRawData, short *accRawData, short *gyroRawData);
 void center_angles(headtrackerData *trackingData);
 void headtracker_open(headtrackerData *trackingData, int portnum);
 void headtracker_close(headtrackerData *trackingData);
@@ -259,10 +450,22 @@ int import_headtracker_settings(headtrackerData *trackingData, char* filename);
 int export_magCalDataRawSamples(headtrackerData *trackingData, char* filename);
 int export_accCalDataRawSamples(headtrackerData *trackingData, char* filename);
 int export_RTmagCalDataRawSamples(headtrackerData *trackingData, char* filename);
+int export_gyroOffsetStore(headtrackerData *trackingData);
+int import_gyroOffsetStore(headtrackerData *trackingData);
 
 int calibrateAcc(headtrackerData *trackingData);
 int calibrateMag(headtrackerData *trackingData);
 
+double get_monotonic_time();
+double headtracker_hostTime2SampleTime(headtrackerData *trackingData, double hostTime);
+char headtracker_getResampledPose(headtrackerData *trackingData, double hostTime, float *q1, float *q2, float *q3, float *q4, float *yaw, float *pitch, float *roll);
+char headtracker_getResampledEstimate(headtrackerData *trackingData, double hostTime, float *q1, float *q2, float *q3, float *q4);
+char headtracker_getPoseHistoryRange(headtrackerData *trackingData, double *oldestHostTime, double *newestHostTime);
+long headtracker_getBlockPoses(headtrackerData *trackingData, audioClockMapping *mapping, double blockStartSampleTime, long blockLength, long subBlockLength, float *quaternions);
+void headtracker_updateOutputs(headtrackerData *trackingData);
+long headtracker_outputDue(headtrackerData *trackingData, double hostTime);
+long headtracker_outputDueForPose(headtrackerData *trackingData, double hostTime, float q1, float q2, float q3, float q4, float yaw, float pitch, float roll);
+
 //=====================================================================================================
 // "public" setters for receiver parameters
 //=====================================================================================================
@@ -272,13 +475,40 @@ void setAutoDiscover(headtrackerData *trackingData, char autoDiscover);
 void setGyroOffsetAutocalOn(headtrackerData *trackingData, char gyroOffsetAutocalOn);
 void setGyroOffsetAutocalTime(headtrackerData *trackingData, float gyroOffsetAutocalTime);
 void setGyroOffsetAutocalThreshold(headtrackerData *trackingData, long gyroOffsetAutocalThreshold);
+void setGyroOffsetStoreFilename(headtrackerData *trackingData, char *gyroOffsetStoreFilename);
 void setEstimationMethod(headtrackerData *trackingData, char estimationMethod);
 void setMadgwickBetaGain(headtrackerData *trackingData, float MadgwickBetaGain);
 void setMadgwickBetaMax(headtrackerData *trackingData, float MadgwickBetaMax);
 void setAccLPtimeConstant(headtrackerData *trackingData, float accLPtimeConstant);
+void setInitialConvergenceTime(headtrackerData *trackingData, float initialConvergenceTime);
+void setMagMultirateOn(headtrackerData *trackingData, char magMultirateOn);
+void setMagDisturbanceGatingOn(headtrackerData *trackingData, char magDisturbanceGatingOn);
+void setMagDisturbanceNormThreshold(headtrackerData *trackingData, float magDisturbanceNormThreshold);
+void setMagDisturbanceInclinationThreshold(headtrackerData *trackingData, float magDisturbanceInclinationThreshold);
+void setGyroIntegrationMethod(headtrackerData *trackingData, char gyroIntegrationMethod);
+void setIdleModeOn(headtrackerData *trackingData, char idleModeOn);
+void setIdleGyroThreshold(headtrackerData *trackingData, float idleGyroThreshold);
+void setIdleAccThreshold(headtrackerData *trackingData, float idleAccThreshold);
+void setIdleDecimationFactor(headtrackerData *trackingData, long idleDecimationFactor);
+void setIdleHeartbeatPeriod(headtrackerData *trackingData, float idleHeartbeatPeriod);
+void setDeadbandOn(headtrackerData *trackingData, char deadbandOn);
+void setDeadbandQuaternionAngle(headtrackerData *trackingData, float deadbandQuaternionAngle);
+void setDeadbandEulerAngle(headtrackerData *trackingData, float deadbandEulerAngle);
+void setDeadbandMaxSilence(headtrackerData *trackingData, float deadbandMaxSilence);
+void setESKFgyroNoise(headtrackerData *trackingData, float ESKFgyroNoise);
+void setESKFgyroBiasNoise(headtrackerData *trackingData, float ESKFgyroBiasNoise);
+void setESKFaccNoise(headtrackerData *trackingData, float ESKFaccNoise);
+void setESKFmagNoise(headtrackerData *trackingData, float ESKFmagNoise);
 void setAxesReference(headtrackerData *trackingData, char axesReference);
 void setRotationOrder(headtrackerData *trackingData, char rotationOrder);
 void setInvertRotation(headtrackerData *trackingData, char invertRotation);
+void setFastAnglesOn(headtrackerData *trackingData, char fastAnglesOn);
+void setPredictionTime(headtrackerData *trackingData, float predictionTime);
+void setPredictionDamping(headtrackerData *trackingData, float predictionDamping);
+void setSHrotationOrder(headtrackerData *trackingData, long SHrotationOrder);
+void setResamplingMethod(headtrackerData *trackingData, char resamplingMethod);
+void setResamplingSmoothingTime(headtrackerData *trackingData, float resamplingSmoothingTime);
+void setOutputMask(headtrackerData *trackingData, long outputMask);
 void setMagCalibratingFlag(headtrackerData *trackingData, char magCalibratingFlag);
 void setAccCalibratingFlag(headtrackerData *trackingData, char accCalibratingFlag);
 void setAccCalMaxGyroNorm(headtrackerData *trackingData, float accCalMaxGyroNorm);
@@ -325,6 +555,7 @@ void setRTmagMaxDistanceError(headtrackerData *trackingData, float RTmagMaxDista
 //=====================================================================================================
 // "private" setters
 //=====================================================================================================
+void headtracker_setReceiverSamplerate(headtrackerData *trackingData, long samplerate);
 void headtracker_setReceptionStatus(headtrackerData *trackingData, int n);
 
 //=====================================================================================================
@@ -332,6 +563,7 @@ void headtracker_setReceptionStatus(headtrackerData *trackingData, int n);
 //=====================================================================================================
 void headtracker_requestHeadtrackerSettings(headtrackerData *trackingData);
 int processInfoFromHeadtracker(headtrackerData *trackingData, int offset, int numberOfBytes);
+void updateGyroBiasTrackerWindowLength(headtrackerData *trackingData);
 void gyroOffsetCalibration(headtrackerData *trackingData);
 void headtracker_autodiscover(headtrackerData *trackingData);
 void headtracker_autodiscover_tryNextPort(headtrackerData *trackingData);
@@ -340,13 +572,33 @@ void convert_7bytes_to_3int16(unsigned char *rawDataBuffer,int baseIndex,short *
 
 char MadgwickAHRSupdateModified(headtrackerData *trackingData);
 char GyroscopeIntegrationUpdate(headtrackerData *trackingData);
+void integrateGyroscope(headtrackerData *trackingData, float gx, float gy, float gz);
+char initializeAttitude(headtrackerData *trackingData);
+char ESKFupdate(headtrackerData *trackingData);
+void ESKFscalarUpdate(float P[6][6], float dx[6], float h0, float h1, float h2, float innovation, float r);
+void resetESKF(headtrackerData *trackingData);
+void computeCalibratedAccMagData(headtrackerData *trackingData);
+void updateMagDisturbance(headtrackerData *trackingData, float m_norm2);
+void resetMagDisturbance(headtrackerData *trackingData);
+void updateOrientation(headtrackerData *trackingData);
+char updateStillness(headtrackerData *trackingData);
+void resetIdleMode(headtrackerData *trackingData);
+void updateAngularAcceleration(headtrackerData *trackingData);
+void predictOrientation(headtrackerData *trackingData);
+void computeOutputQuaternion(headtrackerData *trackingData, float q1, float q2, float q3, float q4, float *qout1, float *qout2, float *qout3, float *qout4);
+void updateOutputTransform(headtrackerData *trackingData);
+char deadbandQuaternionDue(headtrackerData *trackingData, long output, float *publishedQuaternion, float q1, float q2, float q3, float q4, double *publicationTime, double hostTime);
+char deadbandAnglesDue(headtrackerData *trackingData, long output, float *publishedAngles, float yaw, float pitch, float roll, double *publicationTime, double hostTime);
 
 void pushNotificationMessage(headtrackerData *trackingData, char messageNumber);
 void headtracker_sendFloatArray2Headtracker(headtrackerData *trackingData, float* data, int numValues, unsigned char StartTransmitChar, unsigned char StopTransmitChar);
 void headtracker_sendSignedCharArray2Headtracker(headtrackerData *trackingData, char* data, int numValues, unsigned char StartTransmitChar, unsigned char StopTransmitChar);
 void resetGyroOffsetCalibration(headtrackerData *trackingData);
+void getGyroOffsetStoreKey(headtrackerData *trackingData, char *key);
+void storeGyroOffset(headtrackerData *trackingData);
+int  restoreGyroOffset(headtrackerData *trackingData);
 int  processKeyValueSettingPair(headtrackerData *trackingData, char *key, char *value, char UpdateHeadtrackerFlag);
-void changeQuaternionReference(headtrackerData *trackingData);
+int  processReceiverSettingPair(headtrackerData *trackingData, char *key, char *value);
 void changeRTMagCalTimeSettings(headtrackerData *trackingData);
 
 
@@ -0,0 +1,236 @@
+//
+//  libhedrot_HOArotator.c
+//  hedrot_receiver
+//
+//  in-place rotation of ambisonic (HOA) audio buffers, with crossfade between the rotation matrices within each block
+//
+//  the rotation matrix of the spherical harmonics is block-diagonal (see libhedrot_SHrotation), so each degree l is
+//  rotated separately: the 2l+1 channels of the degree are copied by chunks of HOA_ROTATOR_CHUNK_SIZE samples to a
+//  planar work buffer, multiplied by the (2l+1)x(2l+1) block, and copied back (which makes the rotation in place).
+//  The degree 0 (omni channel) is left untouched.
+//
+//  the matrix-vector products are computed on 4 samples at a time with SSE (if available). During a crossfade,
+//  output = current x input + gain * ((target - current) x input), with a gain ramping from 1/N to 1 over the block
+//  of N samples: the target matrices are reached exactly at the last sample of the block
+//
+//  typical use in an audio callback (same process as the tracking, no added latency):
+//      headtracker_getResampledPose(trackingData, host time of the block, &q1, &q2, &q3, &q4, ...);
+//      HOArotator_setRotation(rotator, q1, q2, q3, q4);
+//      HOArotator_processPlanar(rotator, channels, blockSize);
+//  (to keep the sound field fixed while the head turns, invert the rotation with invertRotation or by conjugating q)
+//
+
+
+#include "libhedrot_HOArotator.h"
+
+
+HOArotator* newHOArotator() {
+    HOArotator* data = (HOArotator*) malloc(sizeof(HOArotator));
+    
+    data->targetRotation = newSHrotation();
+    data->targetQuaternion[0] = 1;
+    data->targetQuaternion[1] = 0;
+    data->targetQuaternion[2] = 0;
+    data->targetQuaternion[3] = 0;
+    data->order = -1;
+    HOArotator_setOrder(data, 1);
+    
+    return data;
+}
+
+void freeHOArotator(HOArotator* data) {
+    freeSHrotation(data->targetRotation);
+    free(data);
+}
+
+
+//=====================================================================================================
+// function HOArotator_setOrder
+//=====================================================================================================
+//
+// set the ambisonic order (0..SH_ROTATION_MAX_ORDER). The next block is rotated by the target rotation without crossfade
+//
+void HOArotator_setOrder(HOArotator* data, long order) {
+    order = min(max(order, 0), SH_ROTATION_MAX_ORDER);
+    if(order == data->order) return;
+    
+    data->order = order;
+    data->numberOfChannels = (order+1) * (order+1);
+    
+    SHrotation_setOrder(data->targetRotation, order);
+    SHrotation_update(data->targetRotation, data->targetQuaternion[0], data->targetQuaternion[1], data->targetQuaternion[2], data->targetQuaternion[3]);
+    data->targetChanged = 1;
+    data->currentMatricesValid = 0;
+}
+
+
+//=====================================================================================================
+// function HOArotator_setRotation
+//=====================================================================================================
+//
+// set the rotation (unit quaternion, see SHrotation_update) reached at the end of the next processed block
+// can be called several times between two blocks, only the last rotation is used
+//
+void HOArotator_setRotation(HOArotator* data, float q1, float q2, float q3, float q4) {
+    if(q1 == data->targetQuaternion[0] && q2 == data->targetQuaternion[1]
+       && q3 == data->targetQuaternion[2] && q4 == data->targetQuaternion[3])
+        return;
+    
+    data->targetQuaternion[0] = q1;
+    data->targetQuaternion[1] = q2;
+    data->targetQuaternion[2] = q3;
+    data->targetQuaternion[3] = q4;
+    
+    SHrotation_update(data->targetRotation, q1, q2, q3, q4);
+    data->targetChanged = 1;
+}
+
+
+//=====================================================================================================
+// function HOArotator_processPlanar
+//=====================================================================================================
+//
+// rotate in place a planar buffer: channels[0..(order+1)^2-1], numberOfSamples samples each
+//
+void HOArotator_processPlanar(HOArotator* data, float **channels, long numberOfSamples) {
+    HOArotator_process(data, channels, NULL, data->numberOfChannels, numberOfSamples);
+}
+
+
+//=====================================================================================================
+// function HOArotator_processInterleaved
+//=====================================================================================================
+//
+// rotate in place an interleaved buffer of numberOfChannels channels (ACN order). If numberOfChannels < (order+1)^2,
+// only the complete degrees are rotated. The channels above (order+1)^2 are left untouched
+//
+void HOArotator_processInterleaved(HOArotator* data, float *buffer, long numberOfChannels, long numberOfSamples) {
+    HOArotator_process(data, NULL, buffer, numberOfChannels, numberOfSamples);
+}
+
+
+//=====================================================================================================
+// "private" functions
+//=====================================================================================================
+
+//=====================================================================================================
+// function HOArotator_process
+//=====================================================================================================
+//
+// rotate a planar (planarChannels) or interleaved (interleavedBuffer) buffer, degree by degree and chunk by chunk
+//
+void HOArotator_process(HOArotator* data, float **planarChannels, float *interleavedBuffer, long numberOfChannels, long numberOfSamples) {
+    long order, l, j, n, start, chunkLength, size, firstChannel, bufferSize;
+    float *targetMatrices = SHrotation_getBlock(data->targetRotation, 0), *frame;
+    char crossfade;
+    
+    if(numberOfSamples <= 0) return;
+    
+    order = min(data->order, (long) sqrt((double) numberOfChannels) - 1);
+    bufferSize = SHrotation_blockOffset(data->order + 1);
+    
+    // first block: no crossfade
+    if(!data->currentMatricesValid) {
+        memcpy(data->currentMatrices, targetMatrices, bufferSize * sizeof(float));
+        data->currentMatricesValid = 1;
+        data->targetChanged = 0;
+    }
+    
+    crossfade = data->targetChanged;
+    if(crossfade)
+        for(j = 0; j < bufferSize; j++)
+            data->differenceMatrices[j] = targetMatrices[j] - data->currentMatrices[j];
+    
+    for(l = 1; l <= order; l++) {
+        size = 2*l + 1;
+        firstChannel = l*l;
+        
+        for(start = 0; start < numberOfSamples; start += HOA_ROTATOR_CHUNK_SIZE) {
+            chunkLength = min(HOA_ROTATOR_CHUNK_SIZE, numberOfSamples - start);
+            
+            // copy the chunk to the work buffer
+            if(planarChannels) {
+                for(j = 0; j < size; j++)
+                    memcpy(data->input[j], planarChannels[firstChannel + j] + start, chunkLength * sizeof(float));
+            } else {
+                frame = interleavedBuffer + start * numberOfChannels + firstChannel;
+                for(n = 0; n < chunkLength; n++, frame += numberOfChannels)
+                    for(j = 0; j < size; j++)
+                        data->input[j][n] = frame[j];
+            }
+            
+            if(crossfade)
+                for(n = 0; n < chunkLength; n++)
+                    data->gains[n] = (float) (start + n + 1) / numberOfSamples;
+            
+            HOArotator_processChunk(data, l, chunkLength, crossfade);
+            
+            // copy the result back
+            if(planarChannels) {
+                for(j = 0; j < size; j++)
+                    memcpy(planarChannels[firstChannel + j] + start, data->output[j], chunkLength * sizeof(float));
+            } else {
+                frame = interleavedBuffer + start * numberOfChannels + firstChannel;
+                for(n = 0; n < chunkLength; n++, frame += numberOfChannels)
+                    for(j = 0; j < size; j++)
+                        frame[j] = data->output[j][n];
+            }
+        }
+    }
+    
+    // the target is reached at the end of the block
+    if(crossfade) {
+        memcpy(data->currentMatrices, targetMatrices, bufferSize * sizeof(float));
+        data->targetChanged = 0;
+    }
+}
+
+
+//=====================================================================================================
+// function HOArotator_processChunk
+//=====================================================================================================
+//
+// output = current x input (+ gains * difference x input if crossfade), for the block of degree "degree"
+// (work buffers input, output, gains)
+//
+void HOArotator_processChunk(HOArotator* data, long degree, long chunkLength, char crossfade) {
+    long i, j, n, size = 2*degree + 1, offset = SHrotation_blockOffset(degree);
+    float *current = data->currentMatrices + offset, *difference = data->differenceMatrices + offset, sum, differenceSum;
+#ifdef HEDROT_FASTMATH_SSE
+    __m128 x, sum4, differenceSum4;
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+    
+    for(i = 0; i < size; i++) {
+        n = 0;
+
+#ifdef HEDROT_FASTMATH_SSE
+        for(; n + 4 <= chunkLength; n += 4) {
+            sum4 = _mm_setzero_ps();
+            if(crossfade) {
+                differenceSum4 = _mm_setzero_ps();
+                for(j = 0; j < size; j++) {
+                    x = _mm_loadu_ps(data->input[j] + n);
+                    sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_set1_ps(current[i*size + j]), x));
+                    differenceSum4 = _mm_add_ps(differenceSum4, _mm_mul_ps(_mm_set1_ps(difference[i*size + j]), x));
+                }
+                sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_loadu_ps(data->gains + n), differenceSum4));
+            } else {
+                for(j = 0; j < size; j++)
+                    sum4 = _mm_add_ps(sum4, _mm_mul_ps(_mm_set1_ps(current[i*size + j]), _mm_loadu_ps(data->input[j] + n)));
+            }
+            _mm_storeu_ps(data->output[i] + n, sum4);
+        }
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+        
+        // remaining samples (all of them without SSE)
+        for(; n < chunkLength; n++) {
+            sum = 0;
+            differenceSum = 0;
+            for(j = 0; j < size; j++) {
+                sum += current[i*size + j] * data->input[j][n];
+                if(crossfade) differenceSum += difference[i*size + j] * data->input[j][n];
+            }
+            data->output[i][n] = sum + (crossfade ? data->gains[n] * differenceSum : 0);
+        }
+    }
+}
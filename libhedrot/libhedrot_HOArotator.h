@@ -0,0 +1,64 @@
+//
+//  libhedrot_HOArotator.h
+//  hedrot_receiver
+//
+//  in-place rotation of ambisonic (HOA) audio buffers, with crossfade between the rotation matrices within each block
+//
+
+#ifndef __hedrot_receiver__libhedrot_HOArotator__
+#define __hedrot_receiver__libhedrot_HOArotator__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "libhedrot_utils.h"
+#include "libhedrot_fastmath.h" // for HEDROT_FASTMATH_SSE
+#include "libhedrot_SHrotation.h"
+
+#define HOA_ROTATOR_CHUNK_SIZE      64  // the blocks are processed by chunks of HOA_ROTATOR_CHUNK_SIZE samples (multiple of 4)
+#define HOA_ROTATOR_MAX_DEGREE_SIZE (2*SH_ROTATION_MAX_ORDER+1) // max number of channels of one degree
+
+//=====================================================================================================
+// structure definition: HOArotator
+//=====================================================================================================
+//
+// the channels are in ACN order (any normalization: N3D, SN3D...), (order+1)^2 channels.
+// The rotation set by HOArotator_setRotation is reached at the end of the next processed block: the output of each
+// sample is crossfaded between the matrices of the previous block and the new matrices (linear ramp over the block),
+// which is the same as interpolating the matrices linearly
+//
+typedef struct _HOArotator {
+    // parameters
+    long                order;
+    long                numberOfChannels; // (order+1)^2
+    
+    // rotation matrices (layout of SHrotation): reached at the end of the next block, and current (end of the last block)
+    SHrotation*         targetRotation;
+    float               currentMatrices[SH_ROTATION_BUFFER_SIZE];
+    float               differenceMatrices[SH_ROTATION_BUFFER_SIZE]; // target - current, during the crossfade (internal)
+    float               targetQuaternion[4];
+    char                targetChanged; // 1 if the target differs from the current matrices
+    char                currentMatricesValid; // 0 until the first block (no crossfade from an undefined rotation)
+    
+    // work buffers for one degree and one chunk (planar)
+    float               input[HOA_ROTATOR_MAX_DEGREE_SIZE][HOA_ROTATOR_CHUNK_SIZE];
+    float               output[HOA_ROTATOR_MAX_DEGREE_SIZE][HOA_ROTATOR_CHUNK_SIZE];
+    float               gains[HOA_ROTATOR_CHUNK_SIZE]; // crossfade gains of the chunk
+} HOArotator;
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+HOArotator* newHOArotator();
+void freeHOArotator(HOArotator* data);
+
+void HOArotator_setOrder(HOArotator* data, long order);
+void HOArotator_setRotation(HOArotator* data, float q1, float q2, float q3, float q4);
+void HOArotator_processPlanar(HOArotator* data, float **channels, long numberOfSamples);
+void HOArotator_processInterleaved(HOArotator* data, float *buffer, long numberOfChannels, long numberOfSamples);
+
+void HOArotator_process(HOArotator* data, float **planarChannels, float *interleavedBuffer, long numberOfChannels, long numberOfSamples);
+void HOArotator_processChunk(HOArotator* data, long degree, long chunkLength, char crossfade);
+
+#endif /* defined(__hedrot_receiver__libhedrot_HOArotator__) */
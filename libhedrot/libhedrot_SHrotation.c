@@ -0,0 +1,265 @@
+//
+//  libhedrot_SHrotation.c
+//  hedrot_receiver
+//
+//  rotation matrices for real spherical harmonics (ambisonics)
+//
+//  the block of degree 1 is the rotation matrix itself (the real spherical harmonics of degree 1 are proportional
+//  to y, z, x), the block of degree l is computed from the block of degree 1 and the block of degree l-1
+//  (J. Ivanic, K. Ruedenberg, "Rotation Matrices for Real Spherical Harmonics. Direct Determination by Recursion",
+//  J. Phys. Chem. 1996, with the corrections of 1998):
+//
+//      R_l[m][n] = u(l,m,n) U(l,m,n) + v(l,m,n) V(l,m,n) + w(l,m,n) W(l,m,n)
+//
+//  where U, V, W are combinations of products of elements of R_1 and R_l-1, and u, v, w only depend on the indexes
+//  (precomputed by SHrotation_setOrder). The cost of the block of degree l grows with (2l+1)^2, i.e. the cost of all
+//  the blocks up to order N grows with N^3 (see SHrotation_getNumberOfOperations)
+//
+
+
+#include "libhedrot_SHrotation.h"
+
+
+SHrotation* newSHrotation() {
+    SHrotation* data = (SHrotation*) malloc(sizeof(SHrotation));
+    
+    data->order = -1;
+    SHrotation_setOrder(data, 1);
+    SHrotation_update(data, 1, 0, 0, 0);
+    
+    return data;
+}
+
+void freeSHrotation(SHrotation* data) {
+    free(data);
+}
+
+
+//=====================================================================================================
+// function SHrotation_setOrder
+//=====================================================================================================
+//
+// set the max degree of the computed blocks (0..SH_ROTATION_MAX_ORDER), precompute the coefficients of the recursion
+// and count the operations needed for each block. The blocks are computed at the next call of SHrotation_update
+//
+void SHrotation_setOrder(SHrotation* data, long order) {
+    long l, m, n, offset, size, denominator, absm;
+    float d;
+    
+    order = min(max(order, 0), SH_ROTATION_MAX_ORDER);
+    if(order == data->order) return;
+    data->order = order;
+    
+    data->numberOfOperations[0] = 0;
+    if(order >= 1) data->numberOfOperations[1] = 0; // copied from the rotation matrix
+    
+    for(l = 2; l <= order; l++) {
+        offset = SHrotation_blockOffset(l);
+        size = 2*l + 1;
+        data->numberOfOperations[l] = 0;
+        
+        for(m = -l; m <= l; m++) {
+            absm = labs(m);
+            d = (m == 0) ? 1.0f : 0.0f;
+            
+            for(n = -l; n <= l; n++) {
+                denominator = (labs(n) == l) ? (2*l) * (2*l - 1) : (l + n) * (l - n);
+                
+                data->u[offset + (m+l)*size + (n+l)] = (float) sqrt((double) ((l + m) * (l - m)) / denominator);
+                data->v[offset + (m+l)*size + (n+l)] = .5f * (float) sqrt((1 + d) * (l + absm - 1) * (l + absm) / denominator) * (1 - 2*d);
+                data->w[offset + (m+l)*size + (n+l)] = -.5f * (float) sqrt((double) ((l - absm - 1) * (l - absm)) / denominator) * (1 - d);
+                
+                // cost: P functions, then one multiplication and one addition per non-zero term
+                if(data->u[offset + (m+l)*size + (n+l)] != 0)
+                    data->numberOfOperations[l] += SHrotation_PnumberOfOperations(l, n) + 2;
+                if(data->v[offset + (m+l)*size + (n+l)] != 0)
+                    data->numberOfOperations[l] += 2 * SHrotation_PnumberOfOperations(l, n) + 3 + (absm == 1);
+                if(data->w[offset + (m+l)*size + (n+l)] != 0)
+                    data->numberOfOperations[l] += 2 * SHrotation_PnumberOfOperations(l, n) + 3;
+            }
+        }
+    }
+}
+
+
+//=====================================================================================================
+// function SHrotation_update
+//=====================================================================================================
+//
+// compute the blocks of degree 0..order for the rotation given by the unit quaternion (q1, q2, q3, q4)
+// (convention of quaternionComposition: v' = q x v x q^-1). The spherical harmonics are defined with the axes of the
+// quaternion: for the usual ambisonic convention, the quaternion should be expressed with X->front, Y->left, Z->up
+//
+// applied to the ambisonic signals of a sound field (see SHrotation_apply), the matrix rotates the sound field by q
+//
+void SHrotation_update(SHrotation* data, float q1, float q2, float q3, float q4) {
+    float R[3][3], *block, u, v, w, U, V, W, sqrt2 = (float) sqrt(2.0);
+    long l, m, n, i, j, offset, size;
+    int axes[3] = {1, 2, 0}; // axis of each real spherical harmonic of degree 1 (m = -1, 0, 1 <=> y, z, x)
+    
+    // degree 0
+    data->matrices[0] = 1;
+    if(data->order < 1) return;
+    
+    // degree 1: rotation matrix with the rows and columns in the order y, z, x
+    quaternionToRotationMatrix(q1, q2, q3, q4, R);
+    block = data->matrices + 1;
+    for(i = 0; i < 3; i++)
+        for(j = 0; j < 3; j++)
+            block[i*3 + j] = R[axes[i]][axes[j]];
+    
+    // degrees 2..order, by recursion
+    for(l = 2; l <= data->order; l++) {
+        offset = SHrotation_blockOffset(l);
+        size = 2*l + 1;
+        block = data->matrices + offset;
+        
+        for(m = -l; m <= l; m++) {
+            for(n = -l; n <= l; n++) {
+                u = data->u[offset + (m+l)*size + (n+l)];
+                v = data->v[offset + (m+l)*size + (n+l)];
+                w = data->w[offset + (m+l)*size + (n+l)];
+                
+                U = 0;
+                V = 0;
+                W = 0;
+                
+                if(u != 0) U = SHrotation_P(data, 0, l, m, n);
+                
+                if(v != 0) {
+                    if(m == 0)
+                        V = SHrotation_P(data, 1, l, 1, n) + SHrotation_P(data, -1, l, -1, n);
+                    else if(m == 1)
+                        V = sqrt2 * SHrotation_P(data, 1, l, 0, n);
+                    else if(m == -1)
+                        V = sqrt2 * SHrotation_P(data, -1, l, 0, n);
+                    else if(m > 0)
+                        V = SHrotation_P(data, 1, l, m-1, n) - SHrotation_P(data, -1, l, -m+1, n);
+                    else
+                        V = SHrotation_P(data, 1, l, m+1, n) + SHrotation_P(data, -1, l, -m-1, n);
+                }
+                
+                if(w != 0) {
+                    if(m > 0)
+                        W = SHrotation_P(data, 1, l, m+1, n) + SHrotation_P(data, -1, l, -m-1, n);
+                    else
+                        W = SHrotation_P(data, 1, l, m-1, n) - SHrotation_P(data, -1, l, -m+1, n);
+                }
+                
+                block[(m+l)*size + (n+l)] = u*U + v*V + w*W;
+            }
+        }
+    }
+}
+
+
+//=====================================================================================================
+// function SHrotation_apply
+//=====================================================================================================
+//
+// rotate one set of (order+1)^2 ambisonic coefficients (ACN order): rotatedCoefficients = R x coefficients
+// (coefficients and rotatedCoefficients must not overlap)
+//
+void SHrotation_apply(SHrotation* data, float *coefficients, float *rotatedCoefficients) {
+    long l, i, j, size, channel = 0;
+    float *block, sum;
+    
+    for(l = 0; l <= data->order; l++) {
+        size = 2*l + 1;
+        block = data->matrices + SHrotation_blockOffset(l);
+        
+        for(i = 0; i < size; i++) {
+            sum = 0;
+            for(j = 0; j < size; j++)
+                sum += block[i*size + j] * coefficients[channel + j];
+            rotatedCoefficients[channel + i] = sum;
+        }
+        
+        channel += size;
+    }
+}
+
+
+//=====================================================================================================
+// function SHrotation_getBlock
+//=====================================================================================================
+//
+// block of degree "degree" ((2l+1)x(2l+1), row major), NULL if degree > order
+//
+float* SHrotation_getBlock(SHrotation* data, long degree) {
+    if(degree < 0 || degree > data->order) return NULL;
+    
+    return data->matrices + SHrotation_blockOffset(degree);
+}
+
+
+//=====================================================================================================
+// function SHrotation_getNumberOfOperations
+//=====================================================================================================
+//
+// number of floating point operations (multiplications and additions) of SHrotation_update for the blocks of degree
+// 0..order (order <= data->order). Reported as a cost independent of the machine, e.g. to choose the order
+//
+long SHrotation_getNumberOfOperations(SHrotation* data, long order) {
+    long l, numberOfOperations = 0;
+    
+    for(l = 0; l <= min(order, data->order); l++)
+        numberOfOperations += data->numberOfOperations[l];
+    
+    return numberOfOperations;
+}
+
+
+//=====================================================================================================
+// function SHrotation_blockOffset
+//=====================================================================================================
+//
+// offset of the block of degree "degree" in the buffer: sum of (2l+1)^2 for l < degree
+//
+long SHrotation_blockOffset(long degree) {
+    return degree * (2*degree - 1) * (2*degree + 1) / 3;
+}
+
+
+//=====================================================================================================
+// "private" functions
+//=====================================================================================================
+
+//=====================================================================================================
+// function SHrotation_P
+//=====================================================================================================
+//
+// function P of the recursion: products of the elements (i, -1..1) of R_1 and (a, -l+1..l-1) of R_l-1
+// (i in -1..1, a in -l+1..l-1, b in -l..l)
+//
+float SHrotation_P(SHrotation* data, int i, long l, long a, long b) {
+    float *R1, *Rprevious, ri1, rim1, ri0;
+    long size;
+    
+    R1 = data->matrices + 1 + (i+1)*3;
+    ri1 = R1[2];
+    rim1 = R1[0];
+    ri0 = R1[1];
+    
+    // row a of the block of degree l-1
+    size = 2*l - 1;
+    Rprevious = data->matrices + SHrotation_blockOffset(l-1) + (a + l - 1)*size;
+    
+    if(b == -l)
+        return ri1 * Rprevious[0] + rim1 * Rprevious[size-1];
+    else if(b == l)
+        return ri1 * Rprevious[size-1] - rim1 * Rprevious[0];
+    else
+        return ri0 * Rprevious[b + l - 1];
+}
+
+
+//=====================================================================================================
+// function SHrotation_PnumberOfOperations
+//=====================================================================================================
+//
+// number of operations of SHrotation_P
+//
+long SHrotation_PnumberOfOperations(long l, long b) {
+    return (labs(b) == l) ? 3 : 1;
+}
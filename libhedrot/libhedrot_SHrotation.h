@@ -0,0 +1,60 @@
+//
+//  libhedrot_SHrotation.h
+//  hedrot_receiver
+//
+//  rotation matrices for real spherical harmonics (ambisonics), computed recursively from the rotation matrix
+//  (Ivanic & Ruedenberg)
+//
+
+#ifndef __hedrot_receiver__libhedrot_SHrotation__
+#define __hedrot_receiver__libhedrot_SHrotation__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libhedrot_utils.h"
+
+#define SH_ROTATION_MAX_ORDER       15  // max ambisonic order
+#define SH_ROTATION_BUFFER_SIZE     ((SH_ROTATION_MAX_ORDER+1)*(2*SH_ROTATION_MAX_ORDER+1)*(2*SH_ROTATION_MAX_ORDER+3)/3) // sum of (2l+1)^2 for l = 0..SH_ROTATION_MAX_ORDER
+
+//=====================================================================================================
+// structure definition: SHrotation
+//=====================================================================================================
+//
+// the rotation matrix of real spherical harmonics is block-diagonal: one (2l+1)x(2l+1) block per degree l.
+// The blocks of the degrees 0..order are stored one after the other (see SHrotation_blockOffset), row major,
+// rows and columns in the order m = -l..l (ACN order within the degree). The matrices are the same for N3D and SN3D
+//
+typedef struct _SHrotation {
+    // parameters
+    long                order; // max degree of the computed blocks
+    
+    // blocks of the rotation matrix
+    float               matrices[SH_ROTATION_BUFFER_SIZE];
+    
+    // coefficients of the recursion (depend only on l, m, n), same layout as the blocks
+    float               u[SH_ROTATION_BUFFER_SIZE];
+    float               v[SH_ROTATION_BUFFER_SIZE];
+    float               w[SH_ROTATION_BUFFER_SIZE];
+    
+    // cost of the computation of each block (number of multiplications and additions)
+    long                numberOfOperations[SH_ROTATION_MAX_ORDER+1];
+} SHrotation;
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+SHrotation* newSHrotation();
+void freeSHrotation(SHrotation* data);
+
+void SHrotation_setOrder(SHrotation* data, long order);
+void SHrotation_update(SHrotation* data, float q1, float q2, float q3, float q4);
+void SHrotation_apply(SHrotation* data, float *coefficients, float *rotatedCoefficients);
+float* SHrotation_getBlock(SHrotation* data, long degree);
+long SHrotation_getNumberOfOperations(SHrotation* data, long order);
+long SHrotation_blockOffset(long degree);
+
+float SHrotation_P(SHrotation* data, int i, long l, long a, long b);
+long SHrotation_PnumberOfOperations(long l, long b);
+
+#endif /* defined(__hedrot_receiver__libhedrot_SHrotation__) */
@@ -13,11 +13,9 @@
 // include cblas and lapack for matrix operations
 #ifdef __MACH__  // if mach (mac os X)
 #include <Accelerate/Accelerate.h>
-#else
-#if defined(_WIN32) || defined(_WIN64)
+#else // windows and linux
 #include "lapacke.h"
 #endif
-#endif
 
 #include "libhedrot_calibration.h"
 #include "libhedrot_utils.h"
@@ -277,12 +275,10 @@ int nonRotatedEllipsoidFit(calibrationData* calData, float* estimatedOffset, flo
     __CLPK_integer lda = (int) calData->numberOfSamples, ldb = (int) calData->numberOfSamples;
     __CLPK_integer lwork, info;
 #else
-#if defined(_WIN32) || defined(_WIN64)
     // constants
     lapack_int rank; // effective rank of the matrix
     int n = calData->numberOfSamples;
     int lda = calData->numberOfSamples, ldb = calData->numberOfSamples;
-#endif
 #endif
     
     // check if there are enough points (at least 6 are needed to define an ellipsoid). If not, error
@@ -324,9 +320,7 @@ int nonRotatedEllipsoidFit(calibrationData* calData, float* estimatedOffset, flo
      return 1;
      }*/
 #else
-#if defined(_WIN32) || defined(_WIN64)
     LAPACKE_dgelss( LAPACK_COL_MAJOR, n, 6, 1, matrixA, lda, matrixB, ldb, vectorS, rcond, &rank );
-#endif
 #endif
     
     // check if the rank is different than 6
@@ -399,10 +393,8 @@ end:
 #ifdef __MACH__  // if mach (mac os X)
     free( (void*)work );
 #else
-#if defined(_WIN32) || defined(_WIN64)
     free(matrixA);
     free(matrixB);
-#endif
 #endif
     
     return err;
@@ -446,7 +438,6 @@ int rotatedEllipsoidFit(calibrationData* calData, double *quadricCoefficients, d
     __CLPK_integer lda = (int) calData->numberOfSamples, ldb = (int) calData->numberOfSamples;
     __CLPK_integer lwork, info;
 #else
-#if defined(_WIN32) || defined(_WIN64)
     // constants
     double rcond = 1/maxConditionNumber; // reverse maximum condition number
     
@@ -457,7 +448,6 @@ int rotatedEllipsoidFit(calibrationData* calData, double *quadricCoefficients, d
     int n = calData->numberOfSamples;
     int lda = calData->numberOfSamples, ldb = calData->numberOfSamples;
 #endif
-#endif
     
     
     // Build the matrix D (rows = X^2, Y^2, Z^2, X*Y, X*Z, Y*Z, 2*X, 2*Y, 2*Z) and the matrix ONES (N*1)
@@ -495,9 +485,7 @@ int rotatedEllipsoidFit(calibrationData* calData, double *quadricCoefficients, d
      return 1;
      }*/
 #else
-#if defined(_WIN32) || defined(_WIN64)
     LAPACKE_dgelss( LAPACK_COL_MAJOR, n, 9, 1, matrixA, lda, matrixB, ldb, vectorS, rcond, &rank );
-#endif
 #endif
     
     // check if the rank is different than 6
@@ -537,10 +525,8 @@ end:
     if(work)
         free( (void*)work );
 #else
-#if defined(_WIN32) || defined(_WIN64)
     free(matrixA);
     free(matrixB);
-#endif
 #endif
     
     return err;
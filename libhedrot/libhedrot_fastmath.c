@@ -0,0 +1,246 @@
+//
+//  libhedrot_fastmath.c
+//  hedrot_receiver
+//
+//  fast approximations of atan2 and asin (single precision), scalar and batch (SSE) versions
+//
+//  atan2 is reduced to atan(a) with a = min(|x|,|y|) / max(|x|,|y|) in [0,1], approximated by a minimax polynomial
+//  of degree 9, then unfolded according to the octant. Max absolute error: 1.2e-5 rad (0.0007 degree)
+//  asin(x) is computed as atan2(x, sqrt(1-x^2)), with the same max error
+//
+//  the euler conversions are the same formulas as quaternion2YawPitchRoll and quaternion2RollPitchYaw (libhedrot_utils.c),
+//  which use the double precision atan2 and asin of the standard library
+//
+
+
+#include "libhedrot_fastmath.h"
+
+#include <float.h>
+
+// coefficients of the minimax polynomial approximating atan(a) on [0,1] (odd powers 1 to 9)
+#define FAST_ATAN_C1    .9998660f
+#define FAST_ATAN_C3    -.3302995f
+#define FAST_ATAN_C5    .1801410f
+#define FAST_ATAN_C7    -.0851330f
+#define FAST_ATAN_C9    .0208351f
+
+#define FAST_HALF_PI    1.57079632679489661923f
+
+
+//=====================================================================================================
+// function fastAtan2
+//=====================================================================================================
+//
+// approximation of atan2(y,x), in radians
+//
+float fastAtan2(float y, float x) {
+    float ax, ay, a, s, r;
+    
+    ax = (float) fabs(x);
+    ay = (float) fabs(y);
+    
+    if(ax == 0.0f && ay == 0.0f) return 0.0f;
+    
+    a = min(ax, ay) / max(ax, ay);
+    s = a * a;
+    r = a * (FAST_ATAN_C1 + s * (FAST_ATAN_C3 + s * (FAST_ATAN_C5 + s * (FAST_ATAN_C7 + s * FAST_ATAN_C9))));
+    
+    if(ay > ax) r = FAST_HALF_PI - r;
+    if(x < 0.0f) r = M_PI_float - r;
+    if(y < 0.0f) r = -r;
+    
+    return r;
+}
+
+
+//=====================================================================================================
+// function fastAsin
+//=====================================================================================================
+//
+// approximation of asin(x), in radians (x is clipped to [-1,1])
+//
+float fastAsin(float x) {
+    x = min(max(x, -1.0f), 1.0f);
+    return fastAtan2(x, (float) sqrt(1.0f - x * x));
+}
+
+
+//=====================================================================================================
+// functions fastQuaternion2YawPitchRoll and fastQuaternion2RollPitchYaw
+//=====================================================================================================
+//
+// same as quaternion2YawPitchRoll and quaternion2RollPitchYaw, with the fast approximations (angles in degrees)
+//
+void fastQuaternion2YawPitchRoll(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll) {
+    // zyx Talt-Bryan rotation sequence
+    *yaw = RAD_TO_DEGREE * fastAtan2(2.0f * (q1*q4 + q2*q3), 1.0f - 2.0f * (q3*q3 + q4*q4));
+    *pitch = RAD_TO_DEGREE * fastAsin(2.0f * (q1*q3 - q4*q2));
+    *roll = RAD_TO_DEGREE * fastAtan2(2.0f * (q1*q2 + q3*q4), 1.0f - 2.0f * (q2*q2 + q3*q3));
+}
+
+void fastQuaternion2RollPitchYaw(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll) {
+    // xyz Talt-Bryan rotation sequence
+    *roll = RAD_TO_DEGREE * fastAtan2(2.0f * (q1*q2 - q3*q4), 1.0f - 2.0f * (q2*q2 + q3*q3));
+    *pitch = RAD_TO_DEGREE * fastAsin(2.0f * (q1*q3 + q4*q2));
+    *yaw = RAD_TO_DEGREE * fastAtan2(2.0f * (q1*q4 - q2*q3), 1.0f - 2.0f * (q3*q3 + q4*q4));
+}
+
+
+#ifdef HEDROT_FASTMATH_SSE
+//=====================================================================================================
+// function fastAtan2SSE
+//=====================================================================================================
+//
+// same as fastAtan2 on 4 values at once (branchless)
+//
+__m128 fastAtan2SSE(__m128 y, __m128 x) {
+    __m128 signMask, ax, ay, a, s, r, mask;
+    
+    signMask = _mm_set1_ps(-0.0f);
+    ax = _mm_andnot_ps(signMask, x);
+    ay = _mm_andnot_ps(signMask, y);
+    
+    // FLT_MIN avoids the division by zero for x = y = 0 (the result is then 0)
+    a = _mm_div_ps(_mm_min_ps(ax, ay), _mm_max_ps(_mm_max_ps(ax, ay), _mm_set1_ps(FLT_MIN)));
+    s = _mm_mul_ps(a, a);
+    r = _mm_add_ps(_mm_set1_ps(FAST_ATAN_C7), _mm_mul_ps(s, _mm_set1_ps(FAST_ATAN_C9)));
+    r = _mm_add_ps(_mm_set1_ps(FAST_ATAN_C5), _mm_mul_ps(s, r));
+    r = _mm_add_ps(_mm_set1_ps(FAST_ATAN_C3), _mm_mul_ps(s, r));
+    r = _mm_add_ps(_mm_set1_ps(FAST_ATAN_C1), _mm_mul_ps(s, r));
+    r = _mm_mul_ps(a, r);
+    
+    // octant
+    mask = _mm_cmpgt_ps(ay, ax);
+    r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(_mm_set1_ps(FAST_HALF_PI), r)), _mm_andnot_ps(mask, r));
+    mask = _mm_cmplt_ps(x, _mm_setzero_ps());
+    r = _mm_or_ps(_mm_and_ps(mask, _mm_sub_ps(_mm_set1_ps(M_PI_float), r)), _mm_andnot_ps(mask, r));
+    
+    // sign of y
+    return _mm_xor_ps(r, _mm_and_ps(signMask, y));
+}
+
+
+//=====================================================================================================
+// function fastAsinSSE
+//=====================================================================================================
+//
+// same as fastAsin on 4 values at once
+//
+__m128 fastAsinSSE(__m128 x) {
+    __m128 one = _mm_set1_ps(1.0f);
+    
+    x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-1.0f)), one);
+    return fastAtan2SSE(x, _mm_sqrt_ps(_mm_sub_ps(one, _mm_mul_ps(x, x))));
+}
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+
+
+//=====================================================================================================
+// function fastAtan2Batch
+//=====================================================================================================
+//
+// result[i] = fastAtan2(y[i], x[i]) for numberOfValues values
+//
+void fastAtan2Batch(float *y, float *x, float *result, long numberOfValues) {
+    long i = 0;
+    
+#ifdef HEDROT_FASTMATH_SSE
+    for(; i + 4 <= numberOfValues; i += 4)
+        _mm_storeu_ps(result + i, fastAtan2SSE(_mm_loadu_ps(y + i), _mm_loadu_ps(x + i)));
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+    
+    for(; i < numberOfValues; i++)
+        result[i] = fastAtan2(y[i], x[i]);
+}
+
+
+//=====================================================================================================
+// functions fastQuaternions2YawPitchRoll and fastQuaternions2RollPitchYaw
+//=====================================================================================================
+//
+// batch versions of fastQuaternion2YawPitchRoll and fastQuaternion2RollPitchYaw
+// quaternions: numberOfQuaternions quaternions (W,X,Y,Z interleaved, as returned by poseHistory_getPoses)
+// angles: room for 3*numberOfQuaternions floats, written as yaw,pitch,roll interleaved (in degrees)
+//
+void fastQuaternions2YawPitchRoll(float *quaternions, long numberOfQuaternions, float *angles) {
+    long i = 0;
+#ifdef HEDROT_FASTMATH_SSE
+    __m128 q1, q2, q3, q4, one, two, toDegrees;
+    float yaw[4], pitch[4], roll[4];
+    int j;
+    
+    one = _mm_set1_ps(1.0f);
+    two = _mm_set1_ps(2.0f);
+    toDegrees = _mm_set1_ps(RAD_TO_DEGREE);
+    
+    for(; i + 4 <= numberOfQuaternions; i += 4) {
+        // deinterleave 4 quaternions
+        q1 = _mm_loadu_ps(quaternions + 4*i);
+        q2 = _mm_loadu_ps(quaternions + 4*i + 4);
+        q3 = _mm_loadu_ps(quaternions + 4*i + 8);
+        q4 = _mm_loadu_ps(quaternions + 4*i + 12);
+        _MM_TRANSPOSE4_PS(q1, q2, q3, q4);
+        
+        _mm_storeu_ps(yaw, _mm_mul_ps(toDegrees, fastAtan2SSE(
+                      _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q1, q4), _mm_mul_ps(q2, q3))),
+                      _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q3, q3), _mm_mul_ps(q4, q4)))))));
+        _mm_storeu_ps(pitch, _mm_mul_ps(toDegrees, fastAsinSSE(
+                      _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q1, q3), _mm_mul_ps(q4, q2))))));
+        _mm_storeu_ps(roll, _mm_mul_ps(toDegrees, fastAtan2SSE(
+                      _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q1, q2), _mm_mul_ps(q3, q4))),
+                      _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q2, q2), _mm_mul_ps(q3, q3)))))));
+        
+        for(j = 0; j < 4; j++) {
+            angles[3*(i+j)] = yaw[j];
+            angles[3*(i+j)+1] = pitch[j];
+            angles[3*(i+j)+2] = roll[j];
+        }
+    }
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+    
+    for(; i < numberOfQuaternions; i++)
+        fastQuaternion2YawPitchRoll(quaternions[4*i], quaternions[4*i+1], quaternions[4*i+2], quaternions[4*i+3],
+                                    angles + 3*i, angles + 3*i + 1, angles + 3*i + 2);
+}
+
+void fastQuaternions2RollPitchYaw(float *quaternions, long numberOfQuaternions, float *angles) {
+    long i = 0;
+#ifdef HEDROT_FASTMATH_SSE
+    __m128 q1, q2, q3, q4, one, two, toDegrees;
+    float yaw[4], pitch[4], roll[4];
+    int j;
+    
+    one = _mm_set1_ps(1.0f);
+    two = _mm_set1_ps(2.0f);
+    toDegrees = _mm_set1_ps(RAD_TO_DEGREE);
+    
+    for(; i + 4 <= numberOfQuaternions; i += 4) {
+        // deinterleave 4 quaternions
+        q1 = _mm_loadu_ps(quaternions + 4*i);
+        q2 = _mm_loadu_ps(quaternions + 4*i + 4);
+        q3 = _mm_loadu_ps(quaternions + 4*i + 8);
+        q4 = _mm_loadu_ps(quaternions + 4*i + 12);
+        _MM_TRANSPOSE4_PS(q1, q2, q3, q4);
+        
+        _mm_storeu_ps(roll, _mm_mul_ps(toDegrees, fastAtan2SSE(
+                      _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q1, q2), _mm_mul_ps(q3, q4))),
+                      _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q2, q2), _mm_mul_ps(q3, q3)))))));
+        _mm_storeu_ps(pitch, _mm_mul_ps(toDegrees, fastAsinSSE(
+                      _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q1, q3), _mm_mul_ps(q4, q2))))));
+        _mm_storeu_ps(yaw, _mm_mul_ps(toDegrees, fastAtan2SSE(
+                      _mm_mul_ps(two, _mm_sub_ps(_mm_mul_ps(q1, q4), _mm_mul_ps(q2, q3))),
+                      _mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(_mm_mul_ps(q3, q3), _mm_mul_ps(q4, q4)))))));
+        
+        // same output order as quaternion2RollPitchYaw (yaw, pitch, roll)
+        for(j = 0; j < 4; j++) {
+            angles[3*(i+j)] = yaw[j];
+            angles[3*(i+j)+1] = pitch[j];
+            angles[3*(i+j)+2] = roll[j];
+        }
+    }
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+    
+    for(; i < numberOfQuaternions; i++)
+        fastQuaternion2RollPitchYaw(quaternions[4*i], quaternions[4*i+1], quaternions[4*i+2], quaternions[4*i+3],
+                                    angles + 3*i, angles + 3*i + 1, angles + 3*i + 2);
+}
@@ -0,0 +1,46 @@
+//
+//  libhedrot_fastmath.h
+//  hedrot_receiver
+//
+//  fast approximations of atan2 and asin (single precision), scalar and batch (SSE) versions,
+//  and fast conversions from quaternions to euler angles based on them
+//
+
+#ifndef __hedrot_receiver__libhedrot_fastmath__
+#define __hedrot_receiver__libhedrot_fastmath__
+
+#include <stdio.h>
+#include <math.h>
+#include "libhedrot_utils.h"
+
+// SSE is used for the batch functions if available (always the case on x86-64)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HEDROT_FASTMATH_SSE
+#include <emmintrin.h>
+#endif
+
+// maximum absolute error of the approximations (measured over the whole domain)
+#define FAST_ATAN2_MAX_ERROR_DEGREES    .0007f  // fastAtan2, in degrees
+#define FAST_ASIN_MAX_ERROR_DEGREES     .0007f  // fastAsin, in degrees
+
+//=====================================================================================================
+// scalar functions
+//=====================================================================================================
+float fastAtan2(float y, float x);
+float fastAsin(float x);
+void fastQuaternion2YawPitchRoll(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll);
+void fastQuaternion2RollPitchYaw(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll);
+
+//=====================================================================================================
+// batch functions
+//=====================================================================================================
+void fastAtan2Batch(float *y, float *x, float *result, long numberOfValues);
+void fastQuaternions2YawPitchRoll(float *quaternions, long numberOfQuaternions, float *angles);
+void fastQuaternions2RollPitchYaw(float *quaternions, long numberOfQuaternions, float *angles);
+
+#ifdef HEDROT_FASTMATH_SSE
+__m128 fastAtan2SSE(__m128 y, __m128 x);
+__m128 fastAsinSSE(__m128 x);
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+
+#endif /* defined(__hedrot_receiver__libhedrot_fastmath__) */
@@ -0,0 +1,258 @@
+//
+//  libhedrot_gyroBiasTracker.c
+//  hedrot_receiver
+//
+//  continuous estimation of the gyroscope offset (bias) on sliding windows of still samples
+//
+//  the last windowLength raw samples are kept, with their sum and their max and min on each axis.
+//  The max and min are maintained with monotonic deques, so that each update costs O(1) (amortized)
+//  whatever the length of the window. A window is considered still if max-min is below the threshold on all axes.
+//  The buffers are allocated for the window length (they grow when a longer window is set)
+//
+//  - as long as no still window has been found, the offset is the mean of the stillest window seen so far, if it is
+//    not too far from still, then follows the almost still windows (the estimation never blocks, even in a noisy environment)
+//  - the first still window gives the offset
+//    (an offset known in advance, e.g. from a previous session, can be given as provisional offset with gyroBiasTracker_setOffset)
+//  - then the offset follows the mean of the still windows with a slow lowpass filter (temperature drift).
+//    Still windows too far from the current offset are ignored (slow constant head rotations)
+//
+
+
+#include "libhedrot_gyroBiasTracker.h"
+
+
+gyroBiasTracker* newGyroBiasTracker() {
+    gyroBiasTracker* data = (gyroBiasTracker*) malloc(sizeof(gyroBiasTracker));
+    int i;
+    
+    data->capacity = 0;
+    data->samples = NULL;
+    for(i = 0; i < 3; i++) {
+        data->maxDeque[i] = NULL;
+        data->minDeque[i] = NULL;
+    }
+    allocateGyroBiasTrackerBuffers(data, 2);
+    
+    data->windowLength = 1;
+    data->requestedWindowLength = 1;
+    initGyroBiasTracker(data);
+    
+    return data;
+}
+
+void freeGyroBiasTracker(gyroBiasTracker* data) {
+    int i;
+    
+    free(data->samples);
+    for(i = 0; i < 3; i++) {
+        free(data->maxDeque[i]);
+        free(data->minDeque[i]);
+    }
+    free(data);
+}
+
+
+//=====================================================================================================
+// function allocateGyroBiasTrackerBuffers
+//=====================================================================================================
+//
+// replace the circular buffers by new buffers of "capacity" elements (power of 2), whose content is undefined
+// returns 0 if the allocation failed (the current buffers are then kept)
+//
+int allocateGyroBiasTrackerBuffers(gyroBiasTracker* data, long capacity) {
+    short (*samples)[3];
+    long *maxDeque[3], *minDeque[3];
+    int i, ok;
+    
+    samples = (short (*)[3]) malloc(capacity * sizeof(*samples));
+    ok = (samples != NULL);
+    for(i = 0; i < 3; i++) {
+        maxDeque[i] = (long*) malloc(capacity * sizeof(long));
+        minDeque[i] = (long*) malloc(capacity * sizeof(long));
+        ok = ok && maxDeque[i] && minDeque[i];
+    }
+    
+    if(!ok) {
+        free(samples);
+        for(i = 0; i < 3; i++) {
+            free(maxDeque[i]);
+            free(minDeque[i]);
+        }
+        return 0;
+    }
+    
+    free(data->samples);
+    data->samples = samples;
+    for(i = 0; i < 3; i++) {
+        free(data->maxDeque[i]);
+        free(data->minDeque[i]);
+        data->maxDeque[i] = maxDeque[i];
+        data->minDeque[i] = minDeque[i];
+    }
+    data->capacity = capacity;
+    data->mask = capacity - 1;
+    
+    return 1;
+}
+
+void initGyroBiasTracker(gyroBiasTracker* data) {
+    // empty the window and forget the estimation (the window length is kept)
+    int i;
+    
+    data->numberOfSamples = 0;
+    for(i = 0; i < 3; i++) {
+        data->sum[i] = 0;
+        data->maxDequeHead[i] = 0;
+        data->maxDequeTail[i] = 0;
+        data->minDequeHead[i] = 0;
+        data->minDequeTail[i] = 0;
+        data->offset[i] = 0;
+    }
+    
+    data->state = GYRO_BIAS_TRACKER_NO_ESTIMATE;
+    data->bestRange = -1;
+}
+
+
+//=====================================================================================================
+// function gyroBiasTracker_setWindowLength
+//=====================================================================================================
+//
+// change the length of the window (in samples), restarts the estimation if the length changes.
+// The buffers grow if needed (the deques may temporarily hold windowLength+1 indexes). The length is clamped to
+// GYRO_BIAS_TRACKER_MAX_WINDOW_LENGTH - 1, or to the current buffers if the allocation fails
+//
+// returns the length actually used (smaller than windowLength if it has been clamped)
+//
+long gyroBiasTracker_setWindowLength(gyroBiasTracker* data, long windowLength) {
+    long capacity;
+    
+    // called for every frame: nothing to do if the requested length did not change
+    if(windowLength == data->requestedWindowLength) return data->windowLength;
+    data->requestedWindowLength = windowLength;
+    
+    windowLength = min(max(windowLength, 1), GYRO_BIAS_TRACKER_MAX_WINDOW_LENGTH - 1);
+    
+    if(windowLength + 1 > data->capacity) {
+        for(capacity = data->capacity; capacity < windowLength + 1; capacity *= 2);
+        if(!allocateGyroBiasTrackerBuffers(data, capacity))
+            windowLength = data->capacity - 1;
+    }
+    
+    if(windowLength != data->windowLength) {
+        data->windowLength = windowLength;
+        initGyroBiasTracker(data);
+    }
+    
+    return data->windowLength;
+}
+
+
+//=====================================================================================================
+// function gyroBiasTracker_update
+//=====================================================================================================
+//
+// add a new raw sample (3 axes, in LSB) and update the estimated offset
+// threshold: max allowed difference max-min (in LSB) in a still window
+//
+// returns the state of the estimation (see "states of the estimation")
+//
+char gyroBiasTracker_update(gyroBiasTracker* data, short *gyroRawData, long threshold) {
+    long n = data->numberOfSamples, oldest, range = 0, maxDrift, *deque;
+    float mean[3], alpha;
+    int i;
+    char farFromOffset = 0;
+    
+    oldest = n - data->windowLength; // index of the sample leaving the window
+    
+    for(i = 0; i < 3; i++) {
+        // running sum
+        data->sum[i] += gyroRawData[i];
+        if(oldest >= 0) data->sum[i] -= data->samples[oldest & data->mask][i];
+        
+        // sliding max: remove the smaller values from the tail, then the expired index from the head
+        deque = data->maxDeque[i];
+        while(data->maxDequeTail[i] > data->maxDequeHead[i]
+              && data->samples[deque[(data->maxDequeTail[i]-1) & data->mask] & data->mask][i] <= gyroRawData[i])
+            data->maxDequeTail[i]--;
+        deque[data->maxDequeTail[i] & data->mask] = n;
+        data->maxDequeTail[i]++;
+        if(deque[data->maxDequeHead[i] & data->mask] <= oldest) data->maxDequeHead[i]++;
+        
+        // sliding min: same thing with the larger values
+        deque = data->minDeque[i];
+        while(data->minDequeTail[i] > data->minDequeHead[i]
+              && data->samples[deque[(data->minDequeTail[i]-1) & data->mask] & data->mask][i] >= gyroRawData[i])
+            data->minDequeTail[i]--;
+        deque[data->minDequeTail[i] & data->mask] = n;
+        data->minDequeTail[i]++;
+        if(deque[data->minDequeHead[i] & data->mask] <= oldest) data->minDequeHead[i]++;
+    }
+    
+    // store the sample (after the deques, since the oldest sample is overwritten)
+    data->samples[n & data->mask][0] = gyroRawData[0];
+    data->samples[n & data->mask][1] = gyroRawData[1];
+    data->samples[n & data->mask][2] = gyroRawData[2];
+    data->numberOfSamples++;
+    
+    // nothing to estimate until the window is full
+    if(data->numberOfSamples < data->windowLength) return data->state;
+    
+    maxDrift = threshold / GYRO_BIAS_TRACKER_MAX_DRIFT_RATIO;
+    for(i = 0; i < 3; i++) {
+        range = max(range, data->samples[data->maxDeque[i][data->maxDequeHead[i] & data->mask] & data->mask][i]
+                    - data->samples[data->minDeque[i][data->minDequeHead[i] & data->mask] & data->mask][i]);
+        mean[i] = (float) data->sum[i] / data->windowLength;
+        if(fabs(mean[i] - data->offset[i]) > maxDrift) farFromOffset = 1;
+    }
+    
+    alpha = 1.0f / (GYRO_BIAS_TRACKER_SMOOTHING * data->windowLength);
+    
+    if(range <= threshold) {
+        // still window
+        if(data->state != GYRO_BIAS_TRACKER_CALIBRATED) {
+            data->offset[0] = mean[0];
+            data->offset[1] = mean[1];
+            data->offset[2] = mean[2];
+            data->state = GYRO_BIAS_TRACKER_CALIBRATED;
+        } else if(!farFromOffset) {
+            data->offset[0] += alpha * (mean[0] - data->offset[0]);
+            data->offset[1] += alpha * (mean[1] - data->offset[1]);
+            data->offset[2] += alpha * (mean[2] - data->offset[2]);
+        }
+    } else if(data->state != GYRO_BIAS_TRACKER_CALIBRATED && range <= threshold * GYRO_BIAS_TRACKER_PROVISIONAL_RANGE_RATIO) {
+        // not still, but close to: provisional offset
+        if(data->bestRange < 0 || range < data->bestRange) {
+            // stillest window so far
+            data->bestRange = range;
+            data->offset[0] = mean[0];
+            data->offset[1] = mean[1];
+            data->offset[2] = mean[2];
+            data->state = GYRO_BIAS_TRACKER_PROVISIONAL;
+        } else if(!farFromOffset) {
+            // follow the drift in the same way as when calibrated (noisy environment)
+            data->offset[0] += alpha * (mean[0] - data->offset[0]);
+            data->offset[1] += alpha * (mean[1] - data->offset[1]);
+            data->offset[2] += alpha * (mean[2] - data->offset[2]);
+        }
+    }
+    
+    return data->state;
+}
+
+
+//=====================================================================================================
+// function gyroBiasTracker_setOffset
+//=====================================================================================================
+//
+// start from a known offset (in LSB), considered as provisional: it is followed while no still window is found
+// (almost still windows close to it refine it) and replaced by the mean of the first still window
+//
+void gyroBiasTracker_setOffset(gyroBiasTracker* data, float *offset) {
+    data->offset[0] = offset[0];
+    data->offset[1] = offset[1];
+    data->offset[2] = offset[2];
+    
+    data->state = GYRO_BIAS_TRACKER_PROVISIONAL;
+    data->bestRange = 0; // no provisional window can be "stiller" than the known offset
+}
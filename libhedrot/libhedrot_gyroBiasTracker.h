@@ -0,0 +1,69 @@
+//
+//  libhedrot_gyroBiasTracker.h
+//  hedrot_receiver
+//
+//  continuous estimation of the gyroscope offset (bias) on sliding windows of still samples
+//
+
+#ifndef __hedrot_receiver__libhedrot_gyroBiasTracker__
+#define __hedrot_receiver__libhedrot_gyroBiasTracker__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libhedrot_utils.h"
+
+#define GYRO_BIAS_TRACKER_MAX_WINDOW_LENGTH 65536 // max length of the sliding window in samples (about 30 seconds at 2 kHz), must be a power of 2
+
+#define GYRO_BIAS_TRACKER_SMOOTHING         4   // once calibrated, time constant of the offset update, in window lengths
+#define GYRO_BIAS_TRACKER_PROVISIONAL_RANGE_RATIO 4 // before calibration, windows with max-min up to threshold*GYRO_BIAS_TRACKER_PROVISIONAL_RANGE_RATIO may give a provisional offset
+#define GYRO_BIAS_TRACKER_MAX_DRIFT_RATIO   8   // once calibrated, the still windows whose mean differs from the offset by more than threshold/GYRO_BIAS_TRACKER_MAX_DRIFT_RATIO are ignored (slow constant rotations)
+
+// states of the estimation
+#define GYRO_BIAS_TRACKER_NO_ESTIMATE       0 // the window is not full yet, no offset available
+#define GYRO_BIAS_TRACKER_PROVISIONAL       1 // no still window yet, the offset is the mean of the stillest window seen so far
+#define GYRO_BIAS_TRACKER_CALIBRATED        2 // the offset has been estimated on (at least) one still window
+
+//=====================================================================================================
+// structure definition: gyroBiasTracker
+//=====================================================================================================
+typedef struct _gyroBiasTracker {
+    // parameters
+    long                windowLength; // in samples
+    long                requestedWindowLength; // last length given to gyroBiasTracker_setWindowLength (windowLength may be clamped)
+    
+    // size of the circular buffers below (power of 2 larger than windowLength, grows with it), and size-1
+    long                capacity;
+    long                mask;
+    
+    // circular buffer of the raw samples
+    short               (*samples)[3];
+    long                numberOfSamples; // total number of samples received since the last init
+    long                sum[3]; // sum of the samples in the window
+    
+    // monotonic deques of the (absolute) sample indexes, for the sliding max and min:
+    // the values of the indexes between head and tail are decreasing (max) or increasing (min)
+    long                *maxDeque[3];
+    long                maxDequeHead[3], maxDequeTail[3];
+    long                *minDeque[3];
+    long                minDequeHead[3], minDequeTail[3];
+    
+    // results
+    char                state; // see "states of the estimation"
+    float               offset[3]; // estimated offset, in LSB
+    long                bestRange; // smallest max-min range seen so far (used while the state is GYRO_BIAS_TRACKER_PROVISIONAL)
+} gyroBiasTracker;
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+gyroBiasTracker* newGyroBiasTracker();
+void freeGyroBiasTracker(gyroBiasTracker* data);
+void initGyroBiasTracker(gyroBiasTracker* data);
+int allocateGyroBiasTrackerBuffers(gyroBiasTracker* data, long capacity);
+
+long gyroBiasTracker_setWindowLength(gyroBiasTracker* data, long windowLength);
+char gyroBiasTracker_update(gyroBiasTracker* data, short *gyroRawData, long threshold);
+void gyroBiasTracker_setOffset(gyroBiasTracker* data, float *offset);
+
+#endif /* defined(__hedrot_receiver__libhedrot_gyroBiasTracker__) */
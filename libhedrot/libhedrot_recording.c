@@ -0,0 +1,426 @@
+//
+//  libhedrot_recording.c
+//  hedrot_receiver
+//
+//  recorded sessions (text format of the Max external, or binary format): reading and writing, and replay of the raw
+//  data through the estimation
+//
+//  the replay uses the same code path as the reception (headtracker_compute_rawData): the settings of the header are
+//  applied to the receiver, then the frames are processed one by one. Any setting can be changed between
+//  recordedSession_initReplay and the first frame (e.g. to compare estimation parameters on the same data)
+//
+//  typical use:
+//      session = newRecordedSession();
+//      recordedSession_read(session, filename);
+//      trackingData = headtracker_new();
+//      recordedSession_initReplay(session, trackingData);
+//      setMadgwickBetaGain(trackingData, ...);
+//      for(n = 0; n < session->numberOfFrames; n++) {
+//          recordedSession_replayFrame(session, trackingData, n);
+//          ... trackingData->q1..q4 (or headtracker_updateOutputs, then the outputs)
+//      }
+//
+
+
+#include "libhedrot_recording.h"
+
+
+recordedSession* newRecordedSession() {
+    recordedSession* session = (recordedSession*) malloc(sizeof(recordedSession));
+    
+    session->numberOfSettings = 0;
+    session->samplerate = 0;
+    session->numberOfFrames = 0;
+    session->allocatedNumberOfFrames = 0; // allocated with the first frame
+    session->rawData = NULL;
+    
+    return session;
+}
+
+void freeRecordedSession(recordedSession* session) {
+    free(session->rawData);
+    free(session);
+}
+
+
+//=====================================================================================================
+// function recordedSession_read
+//=====================================================================================================
+//
+// read a recording, in the text format of the Max external or in the binary format (see recordedSession_writeBinary,
+// detected by its signature). The frames are appended to the session
+//
+// returns 1 if successful, 0 if the file cannot be read or has no header
+//
+int recordedSession_read(recordedSession* session, char *filename) {
+    FILE *file;
+    char line[RECORDING_MAX_LINE_LENGTH], *value, *end, *samplerate;
+    short rawData[RECORDING_NUMBER_OF_RAW_VALUES];
+    char headerFlag = 0, headerRead = 0;
+    long i;
+    
+    if((file = fopen(filename, "rb")) == NULL) {
+        printf("[hedrot] cannot open recording %s\r\n", filename);
+        return 0;
+    }
+    
+    if(fread(line, 1, RECORDING_BINARY_SIGNATURE_LENGTH, file) == RECORDING_BINARY_SIGNATURE_LENGTH
+       && !memcmp(line, RECORDING_BINARY_SIGNATURE, RECORDING_BINARY_SIGNATURE_LENGTH)) {
+        headerRead = recordedSession_readBinary(session, file);
+    } else {
+        rewind(file);
+        while(fgets(line, RECORDING_MAX_LINE_LENGTH, file)) {
+            if(!strncmp(line, "<header>", 8)) {
+                headerFlag = 1;
+            } else if(!strncmp(line, "</header>", 9)) {
+                headerFlag = 0;
+                headerRead = 1;
+            } else if(headerFlag) {
+                recordedSession_parseSetting(session, line);
+            } else if(headerRead) {
+                // "index, raw data (9 values) ..."
+                end = strchr(line, ',');
+                if(end == NULL) continue;
+                for(i = 0; i < RECORDING_NUMBER_OF_RAW_VALUES; i++) {
+                    value = end + 1;
+                    rawData[i] = (short) strtol(value, &end, 10);
+                    if(end == value) break;
+                }
+                if(i == RECORDING_NUMBER_OF_RAW_VALUES) recordedSession_addFrame(session, rawData);
+            }
+        }
+    }
+    
+    fclose(file);
+    
+    if(!headerRead) {
+        printf("[hedrot] no header found in recording %s\r\n", filename);
+        return 0;
+    }
+    
+    if(!session->samplerate && (samplerate = recordedSession_getSetting(session, "samplerate")) != NULL)
+        session->samplerate = strtol(samplerate, NULL, 10);
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function recordedSession_readSettings
+//=====================================================================================================
+//
+// read a settings file (see export_headtracker_settings) and append its settings to the header of the session:
+// they are applied after those of the recording by recordedSession_initReplay (e.g. another calibration)
+//
+// returns 1 if successful, 0 if the file cannot be read
+//
+int recordedSession_readSettings(recordedSession* session, char *filename) {
+    FILE *file;
+    char line[RECORDING_MAX_LINE_LENGTH];
+    
+    if((file = fopen(filename, "r")) == NULL) {
+        printf("[hedrot] cannot open settings file %s\r\n", filename);
+        return 0;
+    }
+    
+    while(fgets(line, RECORDING_MAX_LINE_LENGTH, file))
+        recordedSession_parseSetting(session, line);
+    
+    fclose(file);
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function recordedSession_getSetting
+//=====================================================================================================
+//
+// value of a setting of the header (the last one if the key is repeated), NULL if not found
+//
+char* recordedSession_getSetting(recordedSession* session, char *key) {
+    long i;
+    
+    for(i = session->numberOfSettings - 1; i >= 0; i--)
+        if(!strcmp(session->settings[i].key, key))
+            return session->settings[i].value;
+    
+    return NULL;
+}
+
+
+//=====================================================================================================
+// function recordedSession_initReplay
+//=====================================================================================================
+//
+// prepare trackingData for the replay of the session: the settings of the header are applied (headtracker settings,
+// calibration, gyroscope offsets and receiver settings except the connection ones, not transmitted to any headtracker),
+// the samplerate is set to the rate of the recorded frames, and the estimation is reset as at the beginning of a transmission
+//
+void recordedSession_initReplay(recordedSession* session, headtrackerData *trackingData) {
+    char value[RECORDING_MAX_VALUE_LENGTH];
+    char *key;
+    long i;
+    
+    trackingData->calibrationValid = 1; // unless the calibration of the header is not valid
+    trackingData->gyroHalfScaleSensitivity = RECORDING_DEFAULT_GYRO_HALFSCALE_SENSITIVITY;
+    trackingData->gyroBitDepth = RECORDING_DEFAULT_GYRO_BITDEPTH;
+    
+    for(i = 0; i < session->numberOfSettings; i++) {
+        // the value is parsed in place: work on a copy, the session is left unchanged (and can be shared by several threads)
+        key = session->settings[i].key;
+        strcpy(value, session->settings[i].value);
+        
+        if(!strcmp(key, "gyroOffset")) {
+            // offsets used at recording time (calibrated by the receiver, not a headtracker setting)
+            stringToFloats(value, trackingData->gyroOffset, 3);
+        } else if(!strcmp(key, "headtracker_on") || !strcmp(key, "autoDiscover")) {
+            // connection settings, not relevant for the replay
+        } else if(!processReceiverSettingPair(trackingData, key, value)) {
+            processKeyValueSettingPair(trackingData, key, value, 0);
+        }
+    }
+    
+    trackingData->gyroscopeCalibrationFactor = trackingData->gyroHalfScaleSensitivity * M_PI_float / 180.0f
+                                                / (float) pow((double) 2,(int) trackingData->gyroBitDepth-1);
+    
+    if(session->samplerate > 0)
+        headtracker_setReceiverSamplerate(trackingData, session->samplerate);
+    
+    // beginning of a transmission
+    headtracker_setReceptionStatus(trackingData, COMMUNICATION_STATE_RECEIVING_INFO);
+    headtracker_setReceptionStatus(trackingData, COMMUNICATION_STATE_HEADTRACKER_TRANSMITTING);
+}
+
+
+//=====================================================================================================
+// function recordedSession_replayFrame
+//=====================================================================================================
+//
+// process the frame number "frame" of the session, as if it was received from the headtracker
+//
+void recordedSession_replayFrame(recordedSession* session, headtrackerData *trackingData, long frame) {
+    short *rawData = session->rawData + frame * RECORDING_NUMBER_OF_RAW_VALUES;
+    
+    headtracker_compute_rawData(trackingData, rawData, rawData + 3, rawData + 6);
+}
+
+
+//=====================================================================================================
+// function recordedSession_writeBinary
+//=====================================================================================================
+//
+// write the session in the binary format, much faster to read than the text format:
+//      signature (RECORDING_BINARY_SIGNATURE, 8 bytes)
+//      number of settings (int32), then for each setting: key and value (null-terminated strings)
+//      number of frames (int32), then the raw data of the frames (RECORDING_NUMBER_OF_RAW_VALUES int16 per frame)
+// the numbers are written in the byte order of the host (little-endian on all supported platforms)
+//
+// returns 1 if successful, 0 otherwise
+//
+int recordedSession_writeBinary(recordedSession* session, char *filename) {
+    FILE *file;
+    int32_t number;
+    long i;
+    int result;
+    
+    if((file = fopen(filename, "wb")) == NULL) {
+        printf("[hedrot] cannot open %s for writing\r\n", filename);
+        return 0;
+    }
+    
+    result = (fwrite(RECORDING_BINARY_SIGNATURE, 1, RECORDING_BINARY_SIGNATURE_LENGTH, file) == RECORDING_BINARY_SIGNATURE_LENGTH);
+    
+    number = (int32_t) session->numberOfSettings;
+    result = result && (fwrite(&number, sizeof(int32_t), 1, file) == 1);
+    for(i = 0; i < session->numberOfSettings; i++) {
+        result = result && (fwrite(session->settings[i].key, 1, strlen(session->settings[i].key) + 1, file) == strlen(session->settings[i].key) + 1);
+        result = result && (fwrite(session->settings[i].value, 1, strlen(session->settings[i].value) + 1, file) == strlen(session->settings[i].value) + 1);
+    }
+    
+    number = (int32_t) session->numberOfFrames;
+    result = result && (fwrite(&number, sizeof(int32_t), 1, file) == 1);
+    result = result && (fwrite(session->rawData, RECORDING_NUMBER_OF_RAW_VALUES * sizeof(short), session->numberOfFrames, file) == (size_t) session->numberOfFrames);
+    
+    if(fclose(file)) result = 0;
+    
+    if(!result) printf("[hedrot] write error on %s\r\n", filename);
+    
+    return result;
+}
+
+
+//=====================================================================================================
+// function recordedSession_writeHeader
+//=====================================================================================================
+//
+// write the header of the session in the text format of the Max external
+//
+// returns 1 if successful, 0 otherwise
+//
+int recordedSession_writeHeader(recordedSession* session, FILE *file) {
+    long i;
+    
+    if(fprintf(file, "<header>\n") < 0) return 0;
+    for(i = 0; i < session->numberOfSettings; i++)
+        if(fprintf(file, "%s, %s;\n", session->settings[i].key, session->settings[i].value) < 0) return 0;
+    if(fprintf(file, "</header>\n") < 0) return 0;
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function recordedSession_writeFrame
+//=====================================================================================================
+//
+// write the current frame of trackingData in the text format of the Max external (raw and calibrated data,
+// estimated quaternion and angles, see hedrot_receiver_tick), so that the output of a replay can be read
+// as a recording (e.g. by matlab/readTextDataFromHeadtracker.m)
+// the angles are those of the last call to headtracker_updateOutputs (output mask OUTPUT_MASK_ANGLES)
+//
+// returns 1 if successful, 0 otherwise
+//
+int recordedSession_writeFrame(headtrackerData *trackingData, FILE *file, long index) {
+    return fprintf(file,
+                   "%li, %i %i %i %i %i %i %i %i %i %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f %.15f;\n",
+                   index,
+                   trackingData->magRawData[0], trackingData->magRawData[1], trackingData->magRawData[2],
+                   trackingData->accRawData[0], trackingData->accRawData[1], trackingData->accRawData[2],
+                   trackingData->gyroRawData[0], trackingData->gyroRawData[1], trackingData->gyroRawData[2],
+                   trackingData->magCalData[0], trackingData->magCalData[1], trackingData->magCalData[2],
+                   trackingData->accCalData[0], trackingData->accCalData[1], trackingData->accCalData[2],
+                   trackingData->accCalDataLP[0], trackingData->accCalDataLP[1], trackingData->accCalDataLP[2],
+                   trackingData->gyroCalData[0], trackingData->gyroCalData[1], trackingData->gyroCalData[2],
+                   trackingData->q1, trackingData->q2, trackingData->q3, trackingData->q4,
+                   trackingData->yaw, trackingData->pitch, trackingData->roll) >= 0;
+}
+
+
+//=====================================================================================================
+// "private" functions
+//=====================================================================================================
+
+//=====================================================================================================
+// function recordedSession_addSetting
+//=====================================================================================================
+//
+// returns 1 if successful, 0 if the header is full
+//
+int recordedSession_addSetting(recordedSession* session, char *key, char *value) {
+    recordingSetting *setting;
+    
+    if(session->numberOfSettings >= RECORDING_MAX_NUMBER_OF_SETTINGS) return 0;
+    
+    setting = session->settings + session->numberOfSettings;
+    strncpy(setting->key, key, RECORDING_MAX_KEY_LENGTH - 1);
+    setting->key[RECORDING_MAX_KEY_LENGTH - 1] = 0;
+    strncpy(setting->value, value, RECORDING_MAX_VALUE_LENGTH - 1);
+    setting->value[RECORDING_MAX_VALUE_LENGTH - 1] = 0;
+    session->numberOfSettings++;
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function recordedSession_parseSetting
+//=====================================================================================================
+//
+// add the setting of a line "key, value(s);" (header of a recording, or settings file)
+// returns 1 if successful, 0 if the line is not a setting or if the header is full
+//
+int recordedSession_parseSetting(recordedSession* session, char *line) {
+    char *value, *end;
+    
+    if((value = strstr(line, ", ")) == NULL) return 0;
+    *value = 0;
+    value += 2;
+    if((end = strchr(value, ';')) != NULL) *end = 0;
+    
+    return recordedSession_addSetting(session, line, value);
+}
+
+
+//=====================================================================================================
+// function recordedSession_readBinary
+//=====================================================================================================
+//
+// read the rest of a binary recording (see recordedSession_writeBinary), after its signature
+// returns 1 if successful, 0 if the file is truncated or out of memory
+//
+int recordedSession_readBinary(recordedSession* session, FILE *file) {
+    char key[RECORDING_MAX_KEY_LENGTH], value[RECORDING_MAX_VALUE_LENGTH];
+    int32_t numberOfSettings, numberOfFrames;
+    short *newRawData;
+    long i;
+    
+    if(fread(&numberOfSettings, sizeof(int32_t), 1, file) != 1) return 0;
+    for(i = 0; i < numberOfSettings; i++) {
+        if(!recordedSession_readString(file, key, RECORDING_MAX_KEY_LENGTH)
+           || !recordedSession_readString(file, value, RECORDING_MAX_VALUE_LENGTH)) return 0;
+        recordedSession_addSetting(session, key, value);
+    }
+    
+    if(fread(&numberOfFrames, sizeof(int32_t), 1, file) != 1 || numberOfFrames < 0) return 0;
+    if(session->numberOfFrames + numberOfFrames > session->allocatedNumberOfFrames) {
+        newRawData = (short*) realloc(session->rawData, (session->numberOfFrames + numberOfFrames) * RECORDING_NUMBER_OF_RAW_VALUES * sizeof(short));
+        if(newRawData == NULL) return 0;
+        session->rawData = newRawData;
+        session->allocatedNumberOfFrames = session->numberOfFrames + numberOfFrames;
+    }
+    
+    session->numberOfFrames += (long) fread(session->rawData + session->numberOfFrames * RECORDING_NUMBER_OF_RAW_VALUES,
+                                            RECORDING_NUMBER_OF_RAW_VALUES * sizeof(short), numberOfFrames, file);
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function recordedSession_readString
+//=====================================================================================================
+//
+// read a null-terminated string (binary format), truncated to maxLength - 1 characters
+// returns 1 if successful, 0 at the end of the file
+//
+int recordedSession_readString(FILE *file, char *string, long maxLength) {
+    long n = 0;
+    int c;
+    
+    while((c = fgetc(file)) != EOF) {
+        if(!c) {
+            string[min(n, maxLength - 1)] = 0;
+            return 1;
+        }
+        if(n < maxLength - 1) string[n] = (char) c;
+        n++;
+    }
+    
+    return 0;
+}
+
+
+//=====================================================================================================
+// function recordedSession_addFrame
+//=====================================================================================================
+//
+// returns 1 if successful, 0 if out of memory
+//
+int recordedSession_addFrame(recordedSession* session, short *rawData) {
+    short *newRawData;
+    long allocatedNumberOfFrames;
+    
+    if(session->numberOfFrames >= session->allocatedNumberOfFrames) {
+        allocatedNumberOfFrames = session->allocatedNumberOfFrames ? 2 * session->allocatedNumberOfFrames : RECORDING_INITIAL_NUMBER_OF_FRAMES;
+        newRawData = (short*) realloc(session->rawData, allocatedNumberOfFrames * RECORDING_NUMBER_OF_RAW_VALUES * sizeof(short));
+        if(newRawData == NULL) return 0;
+        session->rawData = newRawData;
+        session->allocatedNumberOfFrames = allocatedNumberOfFrames;
+    }
+    
+    memcpy(session->rawData + session->numberOfFrames * RECORDING_NUMBER_OF_RAW_VALUES, rawData, RECORDING_NUMBER_OF_RAW_VALUES * sizeof(short));
+    session->numberOfFrames++;
+    
+    return 1;
+}
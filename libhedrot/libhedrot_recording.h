@@ -0,0 +1,91 @@
+//
+//  libhedrot_recording.h
+//  hedrot_receiver
+//
+//  recorded sessions (text format of the Max external, or binary format): reading and writing, and replay of the raw
+//  data through the estimation
+//
+
+#ifndef __hedrot_receiver__libhedrot_recording__
+#define __hedrot_receiver__libhedrot_recording__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "libhedrot.h"
+
+#define RECORDING_MAX_LINE_LENGTH                   4096
+#define RECORDING_MAX_NUMBER_OF_SETTINGS            128
+#define RECORDING_MAX_KEY_LENGTH                    64
+#define RECORDING_MAX_VALUE_LENGTH                  256
+#define RECORDING_INITIAL_NUMBER_OF_FRAMES          65536 // the buffer of the frames grows by doubling its size
+#define RECORDING_BINARY_SIGNATURE                  "HEDROTR1" // first bytes of a binary recording (format version 1)
+#define RECORDING_BINARY_SIGNATURE_LENGTH           8
+#define RECORDING_NUMBER_OF_RAW_VALUES              9 // mag, acc, gyro (x, y, z each)
+
+// gyroscope sensitivity of the firmware (not stored in the header of the recordings)
+#define RECORDING_DEFAULT_GYRO_HALFSCALE_SENSITIVITY 2000
+#define RECORDING_DEFAULT_GYRO_BITDEPTH             16
+
+//=====================================================================================================
+// structure definition: recordingSetting (key/value pair of the header)
+//=====================================================================================================
+typedef struct _recordingSetting {
+    char                key[RECORDING_MAX_KEY_LENGTH];
+    char                value[RECORDING_MAX_VALUE_LENGTH];
+} recordingSetting;
+
+//=====================================================================================================
+// structure definition: recordedSession
+//=====================================================================================================
+//
+// text format written by the Max external (see hedrot_receiver_doopenforwrite):
+//      <header>
+//      key, value(s);          (headtracker and receiver settings, same keys as the settings files)
+//      ...
+//      </header>
+//      index, magRaw(3) accRaw(3) gyroRaw(3) followed by the calibrated data, quaternion and angles computed at recording;
+//
+// only the raw data is kept: the rest is computed again by the replay. The binary format (see
+// recordedSession_writeBinary) stores the header and the raw data only
+// the Max external records one frame per output tick: the rate of the frames is then 1000/outputDataPeriod instead
+// of the samplerate of the header, and should be given to the replay (samplerate)
+//
+typedef struct _recordedSession {
+    // header
+    recordingSetting    settings[RECORDING_MAX_NUMBER_OF_SETTINGS];
+    long                numberOfSettings;
+    
+    // rate of the recorded frames, in Hz (samplerate of the header by default)
+    long                samplerate;
+    
+    // frames: RECORDING_NUMBER_OF_RAW_VALUES values per frame (magRaw, accRaw, gyroRaw)
+    short*              rawData;
+    long                numberOfFrames;
+    long                allocatedNumberOfFrames;
+} recordedSession;
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+recordedSession* newRecordedSession();
+void freeRecordedSession(recordedSession* session);
+
+int recordedSession_read(recordedSession* session, char *filename);
+int recordedSession_readSettings(recordedSession* session, char *filename);
+char* recordedSession_getSetting(recordedSession* session, char *key);
+void recordedSession_initReplay(recordedSession* session, headtrackerData *trackingData);
+void recordedSession_replayFrame(recordedSession* session, headtrackerData *trackingData, long frame);
+
+int recordedSession_writeBinary(recordedSession* session, char *filename);
+int recordedSession_writeHeader(recordedSession* session, FILE *file);
+int recordedSession_writeFrame(headtrackerData *trackingData, FILE *file, long index);
+
+int recordedSession_addSetting(recordedSession* session, char *key, char *value);
+int recordedSession_parseSetting(recordedSession* session, char *line);
+int recordedSession_readBinary(recordedSession* session, FILE *file);
+int recordedSession_readString(FILE *file, char *string, long maxLength);
+int recordedSession_addFrame(recordedSession* session, short *rawData);
+
+#endif /* defined(__hedrot_receiver__libhedrot_recording__) */
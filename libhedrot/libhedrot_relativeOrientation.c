@@ -0,0 +1,129 @@
+//
+//  libhedrot_relativeOrientation.c
+//  hedrot_receiver
+//
+//  orientation of a headtracker relative to a second one (e.g. head relative to the torso or to a rotating chair)
+//
+//  both headtrackers keep the history of their estimates on the host clock (OUTPUT_MASK_ESTIMATE_HISTORY), which
+//  aligns them in time whatever the arrival time of their frames: the relative orientation is computed on the
+//  estimates interpolated at the same host time. The estimates are used before centering, since the centered
+//  quaternions of two headtrackers are not expressed in the same frame (the relative stream has its own centering)
+//
+//  typical use (one thread ticking both headtrackers, each one on its own port):
+//      headtracker_tick(head); headtracker_tick(torso);
+//      relativeOrientation_update(relative, get_monotonic_time() - delay);
+//      ... relative->qcent, relative->yaw, relative->pitch, relative->roll
+//  (as for headtracker_getResampledPose, the delay should cover the reception jitter of both headtrackers, so that
+//  the estimates are interpolated and not clamped)
+//
+
+
+#include "libhedrot_relativeOrientation.h"
+
+
+relativeOrientation* newRelativeOrientation(headtrackerData *head, headtrackerData *reference) {
+    relativeOrientation* data = (relativeOrientation*) malloc(sizeof(relativeOrientation));
+    
+    data->head = head;
+    data->reference = reference;
+    
+    // both headtrackers need the history of their estimates
+    setOutputMask(head, head->outputMask | OUTPUT_MASK_ESTIMATE_HISTORY);
+    setOutputMask(reference, reference->outputMask | OUTPUT_MASK_ESTIMATE_HISTORY);
+    
+    relativeOrientation_resetCenter(data);
+    
+    data->qrel[0] = 1;
+    data->qrel[1] = 0;
+    data->qrel[2] = 0;
+    data->qrel[3] = 0;
+    data->qcent[0] = 1;
+    data->qcent[1] = 0;
+    data->qcent[2] = 0;
+    data->qcent[3] = 0;
+    data->yaw = 0;
+    data->pitch = 0;
+    data->roll = 0;
+    data->status = RESAMPLING_NO_DATA;
+    
+    return data;
+}
+
+void freeRelativeOrientation(relativeOrientation* data) {
+    free(data);
+}
+
+
+//=====================================================================================================
+// function relativeOrientation_update
+//=====================================================================================================
+//
+// compute the relative orientation at the host time hostTime (in seconds, see get_monotonic_time)
+// the outputs are kept unchanged if one of the headtrackers has no estimate yet
+//
+// returns RESAMPLING_NO_DATA, RESAMPLING_OK, or RESAMPLING_CLAMPED if at least one of the estimates was clamped
+//
+char relativeOrientation_update(relativeOrientation* data, double hostTime) {
+    float h1, h2, h3, h4, r1, r2, r3, r4, p1, p2, p3, p4;
+    float *right = data->head->outputTransformRight, *sign = data->head->outputTransformSign;
+    char headStatus, referenceStatus;
+    
+    headStatus = headtracker_getResampledEstimate(data->head, hostTime, &h1, &h2, &h3, &h4);
+    referenceStatus = headtracker_getResampledEstimate(data->reference, hostTime, &r1, &r2, &r3, &r4);
+    
+    if(headStatus == RESAMPLING_NO_DATA || referenceStatus == RESAMPLING_NO_DATA) {
+        data->status = RESAMPLING_NO_DATA;
+        return data->status;
+    }
+    
+    // relative quaternion q_reference^-1 x q_head
+    quaternionComposition(r1, -r2, -r3, -r4, h1, h2, h3, h4, &data->qrel[0], &data->qrel[1], &data->qrel[2], &data->qrel[3]);
+    
+    // output transform (see updateOutputTransform), with the centering of the relative stream:
+    // r x (qref x qrel) x r^-1, r being the change of axes of the head tracker (r = right^-1)
+    quaternionComposition(data->qref[0], data->qref[1], data->qref[2], data->qref[3],
+                          data->qrel[0], data->qrel[1], data->qrel[2], data->qrel[3], &p1, &p2, &p3, &p4);
+    quaternionComposition(right[0], -right[1], -right[2], -right[3], p1, p2, p3, p4, &h1, &h2, &h3, &h4);
+    quaternionComposition(h1, h2, h3, h4, right[0], right[1], right[2], right[3],
+                          &data->qcent[0], &data->qcent[1], &data->qcent[2], &data->qcent[3]);
+    
+    data->qcent[0] *= sign[0];
+    data->qcent[1] *= sign[1];
+    data->qcent[2] *= sign[2];
+    data->qcent[3] *= sign[3];
+    
+    data->head->quaternion2EulerAngles(data->qcent[0], data->qcent[1], data->qcent[2], data->qcent[3],
+                                       &data->yaw, &data->pitch, &data->roll);
+    
+    data->status = (headStatus == RESAMPLING_CLAMPED || referenceStatus == RESAMPLING_CLAMPED) ? RESAMPLING_CLAMPED : RESAMPLING_OK;
+    return data->status;
+}
+
+
+//=====================================================================================================
+// function relativeOrientation_center
+//=====================================================================================================
+//
+// the current relative orientation (last update) becomes the reference of the relative stream
+// (independent of center_angles on the headtrackers)
+//
+void relativeOrientation_center(relativeOrientation* data) {
+    data->qref[0] = data->qrel[0];
+    data->qref[1] = - data->qrel[1];
+    data->qref[2] = - data->qrel[2];
+    data->qref[3] = - data->qrel[3];
+}
+
+
+//=====================================================================================================
+// function relativeOrientation_resetCenter
+//=====================================================================================================
+//
+// no centering: the output is the relative orientation itself (identity when both headtrackers have the same orientation)
+//
+void relativeOrientation_resetCenter(relativeOrientation* data) {
+    data->qref[0] = 1;
+    data->qref[1] = 0;
+    data->qref[2] = 0;
+    data->qref[3] = 0;
+}
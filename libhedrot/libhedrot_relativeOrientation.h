@@ -0,0 +1,50 @@
+//
+//  libhedrot_relativeOrientation.h
+//  hedrot_receiver
+//
+//  orientation of a headtracker relative to a second one (e.g. head relative to the torso or to a rotating chair),
+//  computed on time-aligned interpolated estimates of both headtrackers
+//
+
+#ifndef __hedrot_receiver__libhedrot_relativeOrientation__
+#define __hedrot_receiver__libhedrot_relativeOrientation__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "libhedrot.h"
+
+//=====================================================================================================
+// structure definition: relativeOrientation
+//=====================================================================================================
+//
+// relative quaternion q_reference^-1 x q_head, where q_head and q_reference are the estimates of both headtrackers
+// (body -> earth) interpolated at the same host time. The output is centered by its own reference (independent of the
+// centering of both headtrackers), then expressed in the axes reference of the head tracker (axesReference,
+// invertRotation, rotationOrder and fastAnglesOn of the head tracker)
+//
+typedef struct _relativeOrientation {
+    // paired headtrackers (not owned)
+    headtrackerData*    head;
+    headtrackerData*    reference; // torso, chair...
+    
+    // reference quaternion for centering
+    float               qref[4];
+    
+    // outputs of the last update
+    float               qrel[4]; // relative quaternion, not centered
+    float               qcent[4]; // centered relative quaternion, in the axes reference of the head tracker
+    float               yaw, pitch, roll; // angles of qcent, in degrees
+    char                status; // RESAMPLING_NO_DATA until both headtrackers transmit (see relativeOrientation_update)
+} relativeOrientation;
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+relativeOrientation* newRelativeOrientation(headtrackerData *head, headtrackerData *reference);
+void freeRelativeOrientation(relativeOrientation* data);
+
+char relativeOrientation_update(relativeOrientation* data, double hostTime);
+void relativeOrientation_center(relativeOrientation* data);
+void relativeOrientation_resetCenter(relativeOrientation* data);
+
+#endif /* defined(__hedrot_receiver__libhedrot_relativeOrientation__) */
@@ -0,0 +1,467 @@
+//
+//  libhedrot_resampling.c
+//  hedrot_receiver
+//
+//  history of timestamped poses and resampling at arbitrary time points
+//
+//  the estimated orientation is computed at the headtracker samplerate (1-2 kHz), while the consumers of the data
+//  (Max clock, network, UI) run at their own rate. Instead of picking the latest sample (which aliases the output
+//  timing against the sensor clock), the consumers ask for the pose at a given time, interpolated in the history
+//  with slerp or squad, optionally smoothed with a box window (anti-alias filter when decimating)
+//
+//  the history is written by one thread (the receiving thread), and can be read by any other thread (audio callback,
+//  network sender...) without lock: the writer increments a sequence counter before and after each modification,
+//  a reader retries if the counter was odd or changed during its read (sequence lock). The writer never waits
+//
+
+
+#include "libhedrot_resampling.h"
+
+
+poseHistory* newPoseHistory() {
+    poseHistory* data = (poseHistory*) malloc(sizeof(poseHistory));
+    
+    data->interpolationMethod = RESAMPLING_METHOD_SLERP;
+    data->smoothingTime = 0;
+    data->timeOffset = 0;
+    data->sequence = 0;
+    initPoseHistory(data);
+    
+    return data;
+}
+
+void freePoseHistory(poseHistory* data) {
+    free(data);
+}
+
+void initPoseHistory(poseHistory* data) {
+    // empty the history (the parameters are kept)
+    poseHistory_beginWrite(data);
+    data->numberOfPoses = 0;
+    poseHistory_endWrite(data);
+}
+
+
+void poseHistory_setInterpolationMethod(poseHistory* data, char interpolationMethod) {
+    data->interpolationMethod = min(max(interpolationMethod, RESAMPLING_METHOD_SLERP), RESAMPLING_METHOD_SQUAD);
+}
+
+void poseHistory_setSmoothingTime(poseHistory* data, float smoothingTime) {
+    data->smoothingTime = max(smoothingTime, 0);
+}
+
+
+//=====================================================================================================
+// function poseHistory_addPose
+//=====================================================================================================
+//
+// add a new pose to the history
+// the timestamps must be strictly increasing, poses that are not more recent than the last one are ignored
+// the sign of the quaternion is chosen to be continuous with the previous pose (needed for interpolation and averaging)
+//
+void poseHistory_addPose(poseHistory* data, double timestamp, float q1, float q2, float q3, float q4) {
+    long index;
+    float *previousPose;
+    
+    if(data->numberOfPoses) {
+        index = (data->numberOfPoses - 1) & POSE_HISTORY_MASK;
+        if(timestamp <= data->timestamps[index]) return;
+        
+        previousPose = data->poses[index];
+        if(previousPose[0]*q1 + previousPose[1]*q2 + previousPose[2]*q3 + previousPose[3]*q4 < 0) {
+            q1 = -q1; q2 = -q2; q3 = -q3; q4 = -q4;
+        }
+    }
+    
+    poseHistory_beginWrite(data);
+    index = data->numberOfPoses & POSE_HISTORY_MASK;
+    data->timestamps[index] = timestamp;
+    data->poses[index][0] = q1;
+    data->poses[index][1] = q2;
+    data->poses[index][2] = q3;
+    data->poses[index][3] = q4;
+    data->numberOfPoses++;
+    poseHistory_endWrite(data);
+}
+
+
+//=====================================================================================================
+// function poseHistory_setTimeOffset
+//=====================================================================================================
+//
+// set the offset between the time base of the queries and the time base of the timestamps
+// (e.g. host clock - headtracker clock), so that the readers get it consistent with the history
+//
+void poseHistory_setTimeOffset(poseHistory* data, double timeOffset) {
+    poseHistory_beginWrite(data);
+    data->timeOffset = timeOffset;
+    poseHistory_endWrite(data);
+}
+
+
+//=====================================================================================================
+// function poseHistory_getPose
+//=====================================================================================================
+//
+// pose at time "time" (time base of the queries, i.e. timestamps + timeOffset), see poseHistory_computePose
+// can be called from any thread
+//
+// returns RESAMPLING_NO_DATA, RESAMPLING_OK or RESAMPLING_CLAMPED
+// (RESAMPLING_NO_DATA as well if no consistent read was possible after POSE_HISTORY_MAX_READ_ATTEMPTS attempts)
+//
+char poseHistory_getPose(poseHistory* data, double time, float *q1, float *q2, float *q3, float *q4) {
+    long sequence;
+    int attempt;
+    char status;
+    
+    for(attempt = 0; attempt < POSE_HISTORY_MAX_READ_ATTEMPTS; attempt++) {
+        sequence = poseHistory_beginRead(data);
+        status = poseHistory_computePose(data, time - data->timeOffset, q1, q2, q3, q4);
+        if(poseHistory_endRead(data, sequence)) return status;
+    }
+    
+    return RESAMPLING_NO_DATA;
+}
+
+
+//=====================================================================================================
+// function poseHistory_getPoses
+//=====================================================================================================
+//
+// poses at regularly spaced time points startTime, startTime + period, ... (numberOfPoses poses)
+// quaternions must have room for 4*numberOfPoses floats (W,X,Y,Z interleaved)
+// each pose is read consistently (the writer may add poses between two of them)
+// returns the number of poses that could be computed without clamping
+//
+long poseHistory_getPoses(poseHistory* data, double startTime, double period, long numberOfPoses, float *quaternions) {
+    long i, numberOfValidPoses = 0;
+    
+    for(i = 0; i < numberOfPoses; i++) {
+        if(poseHistory_getPose(data, startTime + i * period, quaternions, quaternions+1, quaternions+2, quaternions+3) == RESAMPLING_OK)
+            numberOfValidPoses++;
+        quaternions += 4;
+    }
+    
+    return numberOfValidPoses;
+}
+
+
+//=====================================================================================================
+// function poseHistory_getTimeRange
+//=====================================================================================================
+//
+// times of the oldest and newest poses of the history (time base of the queries): window in which the poses
+// are interpolated. Can be called from any thread
+//
+// returns 0 if the history is empty (or if no consistent read was possible), 1 otherwise
+//
+char poseHistory_getTimeRange(poseHistory* data, double *oldestTime, double *newestTime) {
+    long sequence, numberOfPoses;
+    int attempt;
+    
+    for(attempt = 0; attempt < POSE_HISTORY_MAX_READ_ATTEMPTS; attempt++) {
+        sequence = poseHistory_beginRead(data);
+        numberOfPoses = data->numberOfPoses;
+        if(numberOfPoses) {
+            *oldestTime = data->timestamps[max(numberOfPoses - POSE_HISTORY_SIZE, 0) & POSE_HISTORY_MASK] + data->timeOffset;
+            *newestTime = data->timestamps[(numberOfPoses - 1) & POSE_HISTORY_MASK] + data->timeOffset;
+        }
+        if(poseHistory_endRead(data, sequence)) return (numberOfPoses > 0);
+    }
+    
+    return 0;
+}
+
+
+//=====================================================================================================
+// function poseHistory_getBlockPoses
+//=====================================================================================================
+//
+// poses for an audio block of blockLength samples starting at the audio clock time blockStartSampleTime (in samples),
+// one pose per sub-block of subBlockLength samples (1 = one pose per sample), taken at the center of the sub-block
+// the audio clock is converted to the time base of the queries by mapping (see audioClockMapping)
+// quaternions must have room for 4*ceil(blockLength/subBlockLength) floats (W,X,Y,Z interleaved)
+// can be called from any thread (typically the audio callback)
+//
+// returns the number of poses that could be computed without clamping. If the history is empty or the mapping has no
+// reference yet, the poses are set to the identity quaternion
+//
+long poseHistory_getBlockPoses(poseHistory* data, audioClockMapping* mapping, double blockStartSampleTime, long blockLength,
+                               long subBlockLength, float *quaternions) {
+    long i, numberOfPoses;
+    double startTime;
+    
+    subBlockLength = max(subBlockLength, 1);
+    numberOfPoses = (blockLength + subBlockLength - 1) / subBlockLength;
+    
+    // default poses (kept if no pose can be read)
+    for(i = 0; i < numberOfPoses; i++) {
+        quaternions[4*i] = 1;
+        quaternions[4*i+1] = 0;
+        quaternions[4*i+2] = 0;
+        quaternions[4*i+3] = 0;
+    }
+    
+    if(!mapping->referenceValid) return 0;
+    
+    startTime = audioClockMapping_sampleTime2HostTime(mapping, blockStartSampleTime + .5 * (subBlockLength - 1));
+    return poseHistory_getPoses(data, startTime, subBlockLength * mapping->samplePeriod, numberOfPoses, quaternions);
+}
+
+
+//=====================================================================================================
+// function audioClockMapping_init
+//=====================================================================================================
+//
+// forget the reference point (the next timestamp becomes the reference), nominal samplerate of the audio clock
+//
+void audioClockMapping_init(audioClockMapping* mapping, double samplerate) {
+    mapping->samplerate = samplerate;
+    mapping->samplePeriod = 1.0 / samplerate;
+    mapping->referenceSampleTime = 0;
+    mapping->referenceHostTime = 0;
+    mapping->referenceValid = 0;
+}
+
+
+//=====================================================================================================
+// function audioClockMapping_update
+//=====================================================================================================
+//
+// new timestamp from the audio API: the sample at audio clock time sampleTime was (or will be) played at host time hostTime
+// (typically once per callback, e.g. the frame time and the host time of the buffer)
+//
+// second order delay-locked loop (F. Adriaensen, "Using a DLL to filter time", 2005) with a bandwidth of
+// AUDIO_CLOCK_DLL_BANDWIDTH: the jitter of the timestamps is filtered out, the drift between the clocks is followed
+//
+void audioClockMapping_update(audioClockMapping* mapping, double sampleTime, double hostTime) {
+    double elapsedSamples, predictedHostTime, error, omega;
+    
+    elapsedSamples = sampleTime - mapping->referenceSampleTime;
+    predictedHostTime = mapping->referenceHostTime + elapsedSamples * mapping->samplePeriod;
+    error = hostTime - predictedHostTime;
+    
+    if(!mapping->referenceValid || elapsedSamples <= 0 || fabs(error) > AUDIO_CLOCK_MAX_ERROR) {
+        // first timestamp or discontinuity: restart from this timestamp
+        mapping->referenceSampleTime = sampleTime;
+        mapping->referenceHostTime = hostTime;
+        mapping->samplePeriod = 1.0 / mapping->samplerate;
+        mapping->referenceValid = 1;
+        return;
+    }
+    
+    omega = 2 * M_PI * AUDIO_CLOCK_DLL_BANDWIDTH * elapsedSamples * mapping->samplePeriod;
+    mapping->referenceSampleTime = sampleTime;
+    mapping->referenceHostTime = predictedHostTime + sqrt(2.0) * omega * error;
+    mapping->samplePeriod += omega * omega * error / elapsedSamples;
+}
+
+
+//=====================================================================================================
+// function audioClockMapping_sampleTime2HostTime
+//=====================================================================================================
+//
+// host time (in seconds) of the sample at audio clock time sampleTime (in samples, may be fractional)
+//
+double audioClockMapping_sampleTime2HostTime(audioClockMapping* mapping, double sampleTime) {
+    return mapping->referenceHostTime + (sampleTime - mapping->referenceSampleTime) * mapping->samplePeriod;
+}
+
+
+//=====================================================================================================
+// "private" functions
+//=====================================================================================================
+
+//=====================================================================================================
+// function poseHistory_beginWrite / poseHistory_endWrite
+//=====================================================================================================
+//
+// enclose each modification of the history by the writer (sequence odd during the modification)
+//
+void poseHistory_beginWrite(poseHistory* data) {
+    data->sequence++;
+    POSE_HISTORY_MEMORY_BARRIER();
+}
+
+void poseHistory_endWrite(poseHistory* data) {
+    POSE_HISTORY_MEMORY_BARRIER();
+    data->sequence++;
+}
+
+
+//=====================================================================================================
+// function poseHistory_beginRead / poseHistory_endRead
+//=====================================================================================================
+//
+// enclose a read: poseHistory_beginRead returns the sequence number, poseHistory_endRead returns 1
+// if the data read in between is consistent (no modification started before or during the read)
+// the data read may be inconsistent before poseHistory_endRead is called (it should only be used afterwards)
+//
+long poseHistory_beginRead(poseHistory* data) {
+    long sequence = data->sequence;
+    POSE_HISTORY_MEMORY_BARRIER();
+    return sequence;
+}
+
+char poseHistory_endRead(poseHistory* data, long sequence) {
+    POSE_HISTORY_MEMORY_BARRIER();
+    return !(sequence & 1) && (data->sequence == sequence);
+}
+
+
+//=====================================================================================================
+// function poseHistory_computePose
+//=====================================================================================================
+//
+// pose at time "time" (same time base as the timestamps)
+// if smoothingTime > 0, the pose is the average of MAX_NUMBER_OF_SMOOTHING_SUBSAMPLES poses interpolated
+// in [time - smoothingTime/2, time + smoothingTime/2] (the caller should therefore ask for poses at least
+// smoothingTime/2 in the past so that the window is entirely inside the history)
+//
+// returns RESAMPLING_NO_DATA, RESAMPLING_OK or RESAMPLING_CLAMPED
+//
+char poseHistory_computePose(poseHistory* data, double time, float *q1, float *q2, float *q3, float *q4) {
+    int i;
+    char status, subsampleStatus;
+    float p1, p2, p3, p4, sum1, sum2, sum3, sum4, recipNorm;
+    double subsampleTime, subsamplePeriod;
+    
+    if(data->smoothingTime <= 0) return poseHistory_interpolate(data, time, q1, q2, q3, q4);
+    
+    subsamplePeriod = data->smoothingTime / MAX_NUMBER_OF_SMOOTHING_SUBSAMPLES;
+    subsampleTime = time - 0.5 * data->smoothingTime + 0.5 * subsamplePeriod;
+    
+    status = poseHistory_interpolate(data, subsampleTime, &sum1, &sum2, &sum3, &sum4);
+    if(status == RESAMPLING_NO_DATA) return RESAMPLING_NO_DATA;
+    
+    for(i = 1; i < MAX_NUMBER_OF_SMOOTHING_SUBSAMPLES; i++) {
+        subsampleTime += subsamplePeriod;
+        subsampleStatus = poseHistory_interpolate(data, subsampleTime, &p1, &p2, &p3, &p4);
+        if(subsampleStatus == RESAMPLING_CLAMPED) status = RESAMPLING_CLAMPED;
+        
+        // the history is sign-continuous, but the sign is checked anyway (the window may straddle a reset)
+        if(sum1*p1 + sum2*p2 + sum3*p3 + sum4*p4 < 0) {
+            p1 = -p1; p2 = -p2; p3 = -p3; p4 = -p4;
+        }
+        sum1 += p1;
+        sum2 += p2;
+        sum3 += p3;
+        sum4 += p4;
+    }
+    
+    // average of close unit quaternions = normalized sum
+    recipNorm = 1.0f / (float) sqrt(sum1*sum1 + sum2*sum2 + sum3*sum3 + sum4*sum4);
+    *q1 = sum1 * recipNorm;
+    *q2 = sum2 * recipNorm;
+    *q3 = sum3 * recipNorm;
+    *q4 = sum4 * recipNorm;
+    
+    return status;
+}
+
+
+//=====================================================================================================
+// function poseHistory_interpolate
+//=====================================================================================================
+//
+// interpolated pose at time "time", without smoothing
+//
+char poseHistory_interpolate(poseHistory* data, double time, float *q1, float *q2, float *q3, float *q4) {
+    long index, oldest, newest;
+    float *pa, *pb, sa1, sa2, sa3, sa4, sb1, sb2, sb3, sb4, t;
+    float qa1, qa2, qa3, qa4, qb1, qb2, qb3, qb4;
+    
+    if(!data->numberOfPoses) return RESAMPLING_NO_DATA;
+    
+    newest = data->numberOfPoses - 1;
+    oldest = max(data->numberOfPoses - POSE_HISTORY_SIZE, 0);
+    
+    // outside the history: clamp to the oldest or newest pose
+    if(time >= data->timestamps[newest & POSE_HISTORY_MASK] || time <= data->timestamps[oldest & POSE_HISTORY_MASK]) {
+        index = (time >= data->timestamps[newest & POSE_HISTORY_MASK]) ? newest : oldest;
+        pa = data->poses[index & POSE_HISTORY_MASK];
+        *q1 = pa[0];
+        *q2 = pa[1];
+        *q3 = pa[2];
+        *q4 = pa[3];
+        return (time == data->timestamps[index & POSE_HISTORY_MASK]) ? RESAMPLING_OK : RESAMPLING_CLAMPED;
+    }
+    
+    index = poseHistory_findIndex(data, time);
+    pa = data->poses[index & POSE_HISTORY_MASK];
+    pb = data->poses[(index+1) & POSE_HISTORY_MASK];
+    t = (float) ((time - data->timestamps[index & POSE_HISTORY_MASK])
+                 / (data->timestamps[(index+1) & POSE_HISTORY_MASK] - data->timestamps[index & POSE_HISTORY_MASK]));
+    
+    switch(data->interpolationMethod) {
+        case RESAMPLING_METHOD_SQUAD:
+            // squad(qa, qb, sa, sb, t) = slerp( slerp(qa, qb, t), slerp(sa, sb, t), 2t(1-t))
+            poseHistory_squadControlPoint(data, index, &sa1, &sa2, &sa3, &sa4);
+            poseHistory_squadControlPoint(data, index+1, &sb1, &sb2, &sb3, &sb4);
+            quaternionSlerp(pa[0], pa[1], pa[2], pa[3], pb[0], pb[1], pb[2], pb[3], t, &qa1, &qa2, &qa3, &qa4);
+            quaternionSlerp(sa1, sa2, sa3, sa4, sb1, sb2, sb3, sb4, t, &qb1, &qb2, &qb3, &qb4);
+            quaternionSlerp(qa1, qa2, qa3, qa4, qb1, qb2, qb3, qb4, 2.0f * t * (1.0f - t), q1, q2, q3, q4);
+            break;
+        default: // RESAMPLING_METHOD_SLERP
+            quaternionSlerp(pa[0], pa[1], pa[2], pa[3], pb[0], pb[1], pb[2], pb[3], t, q1, q2, q3, q4);
+            break;
+    }
+    
+    return RESAMPLING_OK;
+}
+
+
+//=====================================================================================================
+// function poseHistory_findIndex
+//=====================================================================================================
+//
+// binary search of the (absolute) index i such that timestamp(i) <= time < timestamp(i+1)
+// the time must be strictly inside the history (checked by the caller)
+//
+long poseHistory_findIndex(poseHistory* data, double time) {
+    long low, high, middle;
+    
+    low = max(data->numberOfPoses - POSE_HISTORY_SIZE, 0);
+    high = data->numberOfPoses - 1;
+    
+    while(high - low > 1) {
+        middle = (low + high) / 2;
+        if(data->timestamps[middle & POSE_HISTORY_MASK] <= time)
+            low = middle;
+        else
+            high = middle;
+    }
+    
+    return low;
+}
+
+
+//=====================================================================================================
+// function poseHistory_squadControlPoint
+//=====================================================================================================
+//
+// intermediate control point of the squad interpolation for the pose "index":
+//      s_i = q_i x exp( -( log(q_i^-1 x q_i+1) + log(q_i^-1 x q_i-1) ) / 4 )
+// (the neighbours are clamped to the history boundaries)
+//
+void poseHistory_squadControlPoint(poseHistory* data, long index, float *s1, float *s2, float *s3, float *s4) {
+    long previous, next;
+    float *p, *pp, *pn, d1, d2, d3, d4, ra1, ra2, ra3, rb1, rb2, rb3;
+    
+    previous = max(index - 1, max(data->numberOfPoses - POSE_HISTORY_SIZE, 0));
+    next = min(index + 1, data->numberOfPoses - 1);
+    
+    p = data->poses[index & POSE_HISTORY_MASK];
+    pp = data->poses[previous & POSE_HISTORY_MASK];
+    pn = data->poses[next & POSE_HISTORY_MASK];
+    
+    // rotation vectors of q_i^-1 x q_i+1 and q_i^-1 x q_i-1
+    quaternionComposition(p[0], -p[1], -p[2], -p[3], pn[0], pn[1], pn[2], pn[3], &d1, &d2, &d3, &d4);
+    quaternionToRotationVector(d1, d2, d3, d4, &ra1, &ra2, &ra3);
+    quaternionComposition(p[0], -p[1], -p[2], -p[3], pp[0], pp[1], pp[2], pp[3], &d1, &d2, &d3, &d4);
+    quaternionToRotationVector(d1, d2, d3, d4, &rb1, &rb2, &rb3);
+    
+    // log of a unit quaternion = half of the rotation vector => the factor -1/4 applies to the rotation vectors as well
+    quaternionFromRotationVector(-.25f * (ra1 + rb1), -.25f * (ra2 + rb2), -.25f * (ra3 + rb3), &d1, &d2, &d3, &d4);
+    quaternionComposition(p[0], p[1], p[2], p[3], d1, d2, d3, d4, s1, s2, s3, s4);
+}
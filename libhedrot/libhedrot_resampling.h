@@ -0,0 +1,116 @@
+//
+//  libhedrot_resampling.h
+//  hedrot_receiver
+//
+//  history of timestamped poses and resampling at arbitrary time points (slerp or squad interpolation)
+//  one writer thread, any number of lock-free reader threads (sequence lock)
+//
+
+#ifndef __hedrot_receiver__libhedrot_resampling__
+#define __hedrot_receiver__libhedrot_resampling__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "libhedrot_utils.h"
+
+#define POSE_HISTORY_SIZE                   4096 // number of poses kept in the history (about 2 seconds at 2 kHz), must be a power of 2
+#define POSE_HISTORY_MASK                   (POSE_HISTORY_SIZE-1)
+
+#define MAX_NUMBER_OF_SMOOTHING_SUBSAMPLES  16 // max number of poses averaged by the anti-alias smoothing
+
+#define POSE_HISTORY_MAX_READ_ATTEMPTS      100 // max number of attempts of a reader overlapping with the writer
+
+// memory barrier of the sequence lock (see poseHistory_beginWrite and poseHistory_beginRead)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define POSE_HISTORY_MEMORY_BARRIER()       _ReadWriteBarrier() // x86/x64 keep the order of the stores and of the loads, only the compiler may reorder them
+#elif defined(__GNUC__)
+#define POSE_HISTORY_MEMORY_BARRIER()       __sync_synchronize()
+#else
+#define POSE_HISTORY_MEMORY_BARRIER()
+#endif
+
+// audio clock mapping
+#define AUDIO_CLOCK_DLL_BANDWIDTH           .5  // bandwidth of the delay-locked loop filtering the audio timestamps, in Hz
+#define AUDIO_CLOCK_MAX_ERROR               .05 // in seconds, larger errors of the audio timestamps restart the mapping (xrun, clock jump)
+
+// interpolation methods
+#define RESAMPLING_METHOD_SLERP             0
+#define RESAMPLING_METHOD_SQUAD             1
+
+// return values of poseHistory_getPose
+#define RESAMPLING_NO_DATA                  0 // history empty, no pose returned
+#define RESAMPLING_OK                       1 // requested time inside the history, pose interpolated
+#define RESAMPLING_CLAMPED                  2 // requested time outside the history, oldest or newest pose returned
+
+//=====================================================================================================
+// structure definition: poseHistory (circular buffer of timestamped unit quaternions)
+//=====================================================================================================
+typedef struct _poseHistory {
+    // parameters
+    char                interpolationMethod; // see "interpolation methods"
+    float               smoothingTime; // width in seconds of the anti-alias window (0 = no smoothing)
+    
+    // circular buffer
+    double              timestamps[POSE_HISTORY_SIZE]; // in seconds, strictly increasing
+    float               poses[POSE_HISTORY_SIZE][4]; // W,X,Y,Z
+    long                numberOfPoses; // total number of poses written since the last init
+    double              timeOffset; // time base of the queries - time base of the timestamps, in seconds
+    
+    // sequence lock: incremented before and after each modification by the writer (odd while modifying)
+    volatile long       sequence;
+} poseHistory;
+
+//=====================================================================================================
+// structure definition: audioClockMapping (audio clock in samples -> host time in seconds)
+//=====================================================================================================
+//
+// host time of an audio sample = referenceHostTime + (sample time - referenceSampleTime) * samplePeriod
+// the reference and the sample period are updated from the timestamps given by the audio API (one per callback),
+// filtered by a delay-locked loop (timestamp jitter, drift between the audio and host clocks)
+//
+typedef struct _audioClockMapping {
+    double              samplerate; // nominal samplerate of the audio clock
+    double              referenceSampleTime; // audio clock (in samples) of the reference point
+    double              referenceHostTime; // host time (in seconds) of the reference point
+    double              samplePeriod; // duration of one audio sample on the host clock, in seconds
+    char                referenceValid; // 0 until the first timestamp
+} audioClockMapping;
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+poseHistory* newPoseHistory();
+void freePoseHistory(poseHistory* data);
+void initPoseHistory(poseHistory* data);
+
+void poseHistory_setInterpolationMethod(poseHistory* data, char interpolationMethod);
+void poseHistory_setSmoothingTime(poseHistory* data, float smoothingTime);
+
+// writer
+void poseHistory_addPose(poseHistory* data, double timestamp, float q1, float q2, float q3, float q4);
+void poseHistory_setTimeOffset(poseHistory* data, double timeOffset);
+
+// readers (lock-free, any thread)
+char poseHistory_getPose(poseHistory* data, double time, float *q1, float *q2, float *q3, float *q4);
+long poseHistory_getPoses(poseHistory* data, double startTime, double period, long numberOfPoses, float *quaternions);
+char poseHistory_getTimeRange(poseHistory* data, double *oldestTime, double *newestTime);
+long poseHistory_getBlockPoses(poseHistory* data, audioClockMapping* mapping, double blockStartSampleTime, long blockLength,
+                               long subBlockLength, float *quaternions);
+
+// audio clock mapping (audio thread)
+void audioClockMapping_init(audioClockMapping* mapping, double samplerate);
+void audioClockMapping_update(audioClockMapping* mapping, double sampleTime, double hostTime);
+double audioClockMapping_sampleTime2HostTime(audioClockMapping* mapping, double sampleTime);
+
+void poseHistory_beginWrite(poseHistory* data);
+void poseHistory_endWrite(poseHistory* data);
+long poseHistory_beginRead(poseHistory* data);
+char poseHistory_endRead(poseHistory* data, long sequence);
+char poseHistory_computePose(poseHistory* data, double time, float *q1, float *q2, float *q3, float *q4);
+char poseHistory_interpolate(poseHistory* data, double time, float *q1, float *q2, float *q3, float *q4);
+long poseHistory_findIndex(poseHistory* data, double time);
+void poseHistory_squadControlPoint(poseHistory* data, long index, float *s1, float *s2, float *s3, float *s4);
+
+#endif /* defined(__hedrot_receiver__libhedrot_resampling__) */
@@ -108,7 +108,11 @@ void list_comm_ports(headtrackerSerialcomm *x) {
     struct termios test;
     glob_t         glob_buffer;
     
+#ifdef __linux__
+    const char		*glob_pattern = "/dev/ttyACM*"; // USB serial devices (teensy)
+#else /* #ifdef __linux__ */
     const char		*glob_pattern = "/dev/cu.*";
+#endif /* #ifdef __linux__ */
 #endif /* #if defined(_WIN32) || defined(_WIN64) */
     
     // free the previous port list
@@ -0,0 +1,98 @@
+//
+//  libhedrot_sourceDirections.c
+//  hedrot_receiver
+//
+//  directions of (many) virtual sources relative to the head, batch version (SSE)
+//
+//  the world-frame directions are rotated into the head frame by the inverse of the head orientation (R^T d), 4 sources
+//  at a time, and converted to azimuth and elevation with the fast approximations of libhedrot_fastmath
+//  (max error FAST_ATAN2_MAX_ERROR_DEGREES), in the same pass. The directions are given and returned as structures of
+//  arrays (one array per coordinate), so that the loads and stores need no shuffling
+//
+
+
+#include "libhedrot_sourceDirections.h"
+
+
+//=====================================================================================================
+// function headRelativeSourceDirections
+//=====================================================================================================
+//
+// directions of numberOfSources sources relative to the head
+//  - (q1, q2, q3, q4): orientation of the head (e.g. qcent, qpred or a resampled pose), the source directions are
+//    expressed in the same axes (for axesReference 2: X->front, Y->left, Z->up)
+//  - x, y, z: world-frame directions of the sources (unit vectors)
+//  - headX, headY, headZ: head-relative directions (same norm as the world-frame directions)
+//  - azimuth, elevation: head-relative azimuth (atan2(y, x), counterclockwise from the X axis seen from above)
+//    and elevation (towards Z), in degrees
+// the outputs that are not needed can be NULL. The output arrays may be the input arrays (in-place computation)
+//
+void headRelativeSourceDirections(float q1, float q2, float q3, float q4, float *x, float *y, float *z, long numberOfSources,
+                                  float *headX, float *headY, float *headZ, float *azimuth, float *elevation) {
+    float R[3][3];
+    long i = 0;
+#ifdef HEDROT_FASTMATH_SSE
+    __m128 r00, r01, r02, r10, r11, r12, r20, r21, r22, x4, y4, z4, headX4, headY4, headZ4, toDegrees;
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+    
+    quaternionToRotationMatrix(q1, q2, q3, q4, R);
+    
+#ifdef HEDROT_FASTMATH_SSE
+    r00 = _mm_set1_ps(R[0][0]); r01 = _mm_set1_ps(R[0][1]); r02 = _mm_set1_ps(R[0][2]);
+    r10 = _mm_set1_ps(R[1][0]); r11 = _mm_set1_ps(R[1][1]); r12 = _mm_set1_ps(R[1][2]);
+    r20 = _mm_set1_ps(R[2][0]); r21 = _mm_set1_ps(R[2][1]); r22 = _mm_set1_ps(R[2][2]);
+    toDegrees = _mm_set1_ps(RAD_TO_DEGREE);
+    
+    for(; i + 4 <= numberOfSources; i += 4) {
+        x4 = _mm_loadu_ps(x + i);
+        y4 = _mm_loadu_ps(y + i);
+        z4 = _mm_loadu_ps(z + i);
+        
+        // R^T d
+        headX4 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r00, x4), _mm_mul_ps(r10, y4)), _mm_mul_ps(r20, z4));
+        headY4 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r01, x4), _mm_mul_ps(r11, y4)), _mm_mul_ps(r21, z4));
+        headZ4 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r02, x4), _mm_mul_ps(r12, y4)), _mm_mul_ps(r22, z4));
+        
+        if(headX) _mm_storeu_ps(headX + i, headX4);
+        if(headY) _mm_storeu_ps(headY + i, headY4);
+        if(headZ) _mm_storeu_ps(headZ + i, headZ4);
+        
+        if(azimuth) _mm_storeu_ps(azimuth + i, _mm_mul_ps(toDegrees, fastAtan2SSE(headY4, headX4)));
+        if(elevation)
+            _mm_storeu_ps(elevation + i, _mm_mul_ps(toDegrees, fastAtan2SSE(headZ4,
+                          _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(headX4, headX4), _mm_mul_ps(headY4, headY4))))));
+    }
+#endif /* #ifdef HEDROT_FASTMATH_SSE */
+    
+    for(; i < numberOfSources; i++)
+        headRelativeSourceDirection(R, x[i], y[i], z[i],
+                                    headX ? headX + i : NULL, headY ? headY + i : NULL, headZ ? headZ + i : NULL,
+                                    azimuth ? azimuth + i : NULL, elevation ? elevation + i : NULL);
+}
+
+
+//=====================================================================================================
+// "private" functions
+//=====================================================================================================
+
+//=====================================================================================================
+// function headRelativeSourceDirection
+//=====================================================================================================
+//
+// scalar version for one source (R: rotation matrix of the head orientation), for the sources that do not fill a SSE vector
+//
+void headRelativeSourceDirection(float R[3][3], float x, float y, float z,
+                                 float *headX, float *headY, float *headZ, float *azimuth, float *elevation) {
+    float hx, hy, hz;
+    
+    hx = R[0][0] * x + R[1][0] * y + R[2][0] * z;
+    hy = R[0][1] * x + R[1][1] * y + R[2][1] * z;
+    hz = R[0][2] * x + R[1][2] * y + R[2][2] * z;
+    
+    if(headX) *headX = hx;
+    if(headY) *headY = hy;
+    if(headZ) *headZ = hz;
+    
+    if(azimuth) *azimuth = RAD_TO_DEGREE * fastAtan2(hy, hx);
+    if(elevation) *elevation = RAD_TO_DEGREE * fastAtan2(hz, (float) sqrt(hx*hx + hy*hy));
+}
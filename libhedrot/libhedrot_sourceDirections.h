@@ -0,0 +1,25 @@
+//
+//  libhedrot_sourceDirections.h
+//  hedrot_receiver
+//
+//  directions of (many) virtual sources relative to the head, batch version (SSE)
+//
+
+#ifndef __hedrot_receiver__libhedrot_sourceDirections__
+#define __hedrot_receiver__libhedrot_sourceDirections__
+
+#include <stdio.h>
+#include <math.h>
+#include "libhedrot_utils.h"
+#include "libhedrot_fastmath.h"
+
+//=====================================================================================================
+// functions
+//=====================================================================================================
+void headRelativeSourceDirections(float q1, float q2, float q3, float q4, float *x, float *y, float *z, long numberOfSources,
+                                  float *headX, float *headY, float *headZ, float *azimuth, float *elevation);
+
+void headRelativeSourceDirection(float R[3][3], float x, float y, float z,
+                                 float *headX, float *headY, float *headZ, float *azimuth, float *elevation);
+
+#endif /* defined(__hedrot_receiver__libhedrot_sourceDirections__) */
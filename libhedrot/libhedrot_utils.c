@@ -104,6 +104,124 @@ void quaternionComposition(float q01, float q02, float q03, float q04, float q11
     *q24 = q01 * q14 + q02 * q13 - q03 * q12 + q04 * q11;
 }
 
+void quaternionFromRotationMatrix(float R[3][3], float *q1, float *q2, float *q3, float *q4) {
+    // unit quaternion corresponding to the rotation matrix R (same convention as quaternionComposition: v' = q x v x q^-1 <=> v' = R v)
+    // computed from the largest of the four possible divisors, for numerical stability (Shepperd's method)
+    float trace, s;
+    
+    trace = R[0][0] + R[1][1] + R[2][2];
+    if(trace > 0) {
+        s = 2.0f * (float) sqrt(1.0f + trace);
+        *q1 = .25f * s;
+        *q2 = (R[2][1] - R[1][2]) / s;
+        *q3 = (R[0][2] - R[2][0]) / s;
+        *q4 = (R[1][0] - R[0][1]) / s;
+    } else if(R[0][0] > R[1][1] && R[0][0] > R[2][2]) {
+        s = 2.0f * (float) sqrt(1.0f + R[0][0] - R[1][1] - R[2][2]);
+        *q1 = (R[2][1] - R[1][2]) / s;
+        *q2 = .25f * s;
+        *q3 = (R[0][1] + R[1][0]) / s;
+        *q4 = (R[0][2] + R[2][0]) / s;
+    } else if(R[1][1] > R[2][2]) {
+        s = 2.0f * (float) sqrt(1.0f + R[1][1] - R[0][0] - R[2][2]);
+        *q1 = (R[0][2] - R[2][0]) / s;
+        *q2 = (R[0][1] + R[1][0]) / s;
+        *q3 = .25f * s;
+        *q4 = (R[1][2] + R[2][1]) / s;
+    } else {
+        s = 2.0f * (float) sqrt(1.0f + R[2][2] - R[0][0] - R[1][1]);
+        *q1 = (R[1][0] - R[0][1]) / s;
+        *q2 = (R[0][2] + R[2][0]) / s;
+        *q3 = (R[1][2] + R[2][1]) / s;
+        *q4 = .25f * s;
+    }
+}
+
+void quaternionToRotationMatrix(float q1, float q2, float q3, float q4, float R[3][3]) {
+    // rotation matrix corresponding to the unit quaternion (q1, q2, q3, q4) (inverse of quaternionFromRotationMatrix: v' = R v)
+    R[0][0] = 1.0f - 2.0f * (q3*q3 + q4*q4);
+    R[0][1] = 2.0f * (q2*q3 - q1*q4);
+    R[0][2] = 2.0f * (q2*q4 + q1*q3);
+    R[1][0] = 2.0f * (q2*q3 + q1*q4);
+    R[1][1] = 1.0f - 2.0f * (q2*q2 + q4*q4);
+    R[1][2] = 2.0f * (q3*q4 - q1*q2);
+    R[2][0] = 2.0f * (q2*q4 - q1*q3);
+    R[2][1] = 2.0f * (q3*q4 + q1*q2);
+    R[2][2] = 1.0f - 2.0f * (q2*q2 + q3*q3);
+}
+
+void quaternionFromRotationVector(float rx, float ry, float rz, float *q1, float *q2, float *q3, float *q4) {
+    // exponential map: unit quaternion corresponding to a rotation of angle |r| around the axis r/|r|
+    float angle, halfAngleSinc;
+    
+    angle = (float) sqrt(rx*rx + ry*ry + rz*rz);
+    if(angle < 1e-4f) {
+        // second order approximation for small angles (avoids the division by zero)
+        halfAngleSinc = 0.5f - angle * angle / 48.0f;
+        *q1 = 1.0f - angle * angle / 8.0f;
+    } else {
+        halfAngleSinc = (float) sin(0.5f * angle) / angle;
+        *q1 = (float) cos(0.5f * angle);
+    }
+    *q2 = rx * halfAngleSinc;
+    *q3 = ry * halfAngleSinc;
+    *q4 = rz * halfAngleSinc;
+}
+
+void quaternionToRotationVector(float q1, float q2, float q3, float q4, float *rx, float *ry, float *rz) {
+    // logarithmic map (inverse of quaternionFromRotationVector): rotation vector (axis * angle) of a unit quaternion
+    // the shortest rotation is returned (q and -q give the same result)
+    float sinHalfAngle, factor;
+    
+    if(q1 < 0) {
+        q1 = -q1; q2 = -q2; q3 = -q3; q4 = -q4;
+    }
+    sinHalfAngle = (float) sqrt(q2*q2 + q3*q3 + q4*q4);
+    if(sinHalfAngle < 1e-4f) {
+        factor = 2.0f / q1; // small angles: atan(x) ~ x
+    } else {
+        factor = 2.0f * (float) atan2(sinHalfAngle, q1) / sinHalfAngle;
+    }
+    *rx = q2 * factor;
+    *ry = q3 * factor;
+    *rz = q4 * factor;
+}
+
+void quaternionSlerp(float qa1, float qa2, float qa3, float qa4, float qb1, float qb2, float qb3, float qb4, float t, float *q1, float *q2, float *q3, float *q4) {
+    // spherical linear interpolation between two unit quaternions (t = 0 => qa, t = 1 => qb), along the shortest path
+    float cosOmega, omega, sinOmega, ka, kb;
+    
+    cosOmega = qa1*qb1 + qa2*qb2 + qa3*qb3 + qa4*qb4;
+    if(cosOmega < 0) {
+        cosOmega = -cosOmega;
+        qb1 = -qb1; qb2 = -qb2; qb3 = -qb3; qb4 = -qb4;
+    }
+    
+    if(cosOmega > .9995f) {
+        // very close quaternions: normalized linear interpolation (avoids the division by sin(omega) ~ 0)
+        ka = 1.0f - t;
+        kb = t;
+    } else {
+        omega = (float) acos(cosOmega);
+        sinOmega = (float) sin(omega);
+        ka = (float) sin((1.0f - t) * omega) / sinOmega;
+        kb = (float) sin(t * omega) / sinOmega;
+    }
+    
+    *q1 = ka * qa1 + kb * qb1;
+    *q2 = ka * qa2 + kb * qb2;
+    *q3 = ka * qa3 + kb * qb3;
+    *q4 = ka * qa4 + kb * qb4;
+    
+    if(cosOmega > .9995f) {
+        ka = 1.0f / (float) sqrt(*q1 * *q1 + *q2 * *q2 + *q3 * *q3 + *q4 * *q4);
+        *q1 *= ka;
+        *q2 *= ka;
+        *q3 *= ka;
+        *q4 *= ka;
+    }
+}
+
 int stringToFloats(char* valueBuffer, float* data, int nvalues) {
     int i=0;
     
@@ -161,7 +279,7 @@ void getMean3(double *samples, long numberOfSamples, float* mean) {
     mean[0] = 0;
     mean[1] = 0;
     mean[2] = 0;
-    n = 3 * numberOfSamples;
+    n = numberOfSamples;
     
     while(n--) {
         mean[0] += (float) *samples++;
@@ -44,6 +44,9 @@ double round(double value);
 # define strtok_r strtok_s // strtok_r does not exist on windows, use strtok_s instead
 #endif /* #if defined(_WIN32) || defined(_WIN64) */
 
+// conversion from a quaternion to euler angles (quaternion2YawPitchRoll, quaternion2RollPitchYaw, and their fast versions)
+typedef void (*quaternion2EulerFunction)(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll);
+
 //=====================================================================================================
 // utils
 //=====================================================================================================
@@ -52,6 +55,11 @@ float invSqrt(float x);
 void quaternion2YawPitchRoll(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll);
 void quaternion2RollPitchYaw(float q1, float q2, float q3, float q4, float *yaw, float *pitch, float *roll);
 void quaternionComposition(float q01, float q02, float q03, float q04, float q11, float q12, float q13, float q14, float *q21, float *q22, float *q23, float *q24);
+void quaternionFromRotationMatrix(float R[3][3], float *q1, float *q2, float *q3, float *q4);
+void quaternionToRotationMatrix(float q1, float q2, float q3, float q4, float R[3][3]);
+void quaternionFromRotationVector(float rx, float ry, float rz, float *q1, float *q2, float *q3, float *q4);
+void quaternionToRotationVector(float q1, float q2, float q3, float q4, float *rx, float *ry, float *rz);
+void quaternionSlerp(float qa1, float qa2, float qa3, float qa4, float qb1, float qb2, float qb3, float qb4, float t, float *q1, float *q2, float *q3, float *q4);
 int stringToFloats(char* valueBuffer, float* data, int nvalues);
 int stringToChars(char* valueBuffer, char* data, int nvalues);
 
@@ -0,0 +1,533 @@
+//
+//  hedrotParameterSweep.c
+//
+//  parameter sweep and auto-tuning of the estimation over recorded sessions
+//
+//  the recordings (text format of the Max external) are replayed through the estimation for every combination of a
+//  grid of receiver settings (e.g. MadgwickBetaMax, MadgwickBetaGain, accLPtimeConstant). The combinations are shared
+//  dynamically between the worker threads (each thread takes the next combination of the grid as soon as it is
+//  done with the previous one, so that all the cores are busy until the end of the grid), then ranked by the metrics
+//  below. Optionally, the grid is refined around the best combination (finer steps on a narrower range)
+//
+//  metrics (no ground truth is needed, all of them computed on the replayed estimates):
+//      . drift: rotation of the estimate over the still segments (gyroscope norm below STILL_GYRO_THRESHOLD
+//          during at least STILL_MIN_DURATION), in degrees per second
+//      . jitter: RMS of the rotation of the estimate between two successive frames of the still segments, in degrees
+//      . tilt error: mean angle between the measured gravity (calibrated acceleration, when its norm is close to 1 g)
+//          and the gravity predicted by the estimate, in degrees
+//      . convergence time: time from the beginning of the recording (step response of the initialization) until the
+//          tilt error falls below CONVERGENCE_THRESHOLD, in seconds
+//      . score: sum of the metrics, each one relative to its best value over the grid (or to its resolution)
+//  drift, jitter and tilt error are computed after convergence only. A recording that never converges counts as a
+//  failure: the combinations with failures are ranked last
+//
+//  note: the Max external records one frame per output tick, the frame rate (1000/outputDataPeriod) should then be
+//  given with the option -r when it differs from the samplerate of the headtracker
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "libhedrot.h"
+#include "libhedrot_recording.h"
+
+#define MAX_NUMBER_OF_PARAMETERS    8
+#define MAX_NUMBER_OF_THREADS       256
+#define MAX_PARAMETER_NAME_LENGTH   64
+
+// metrics
+#define STILL_GYRO_THRESHOLD        .05 // gyroscope norm (in rad/s) below which the headtracker is considered still
+#define STILL_MIN_DURATION          .5 // minimum duration of a still segment, in seconds
+#define ACC_NORM_TOLERANCE          .05 // max deviation of the norm of the acceleration from 1 g for the tilt error
+#define CONVERGENCE_THRESHOLD       2 // tilt error (in degrees) below which the estimation is considered converged
+
+#define NUMBER_OF_METRICS           5
+#define METRIC_DRIFT                0
+#define METRIC_JITTER               1
+#define METRIC_TILT                 2
+#define METRIC_CONVERGENCE          3
+#define METRIC_SCORE                4
+
+const char *metricNames[NUMBER_OF_METRICS] = {"drift", "jitter", "tilt", "convergence", "score"};
+
+// resolution of the metrics (lower bound of the best values for the normalization of the score)
+const double metricResolutions[METRIC_SCORE] = {.01, .001, .1, .01};
+
+#define DEFAULT_NUMBER_OF_RESULTS   10
+
+//=====================================================================================================
+// structure definition: sweepParameter
+//=====================================================================================================
+typedef struct _sweepParameter {
+    char                name[MAX_PARAMETER_NAME_LENGTH]; // receiver setting (see receiverSettings)
+    double              start, stop, step; // current grid
+    double              min, max; // range given by the user (the refined grids stay in this range)
+    long                numberOfValues;
+} sweepParameter;
+
+//=====================================================================================================
+// structure definition: sweepResult
+//=====================================================================================================
+typedef struct _sweepResult {
+    double              values[MAX_NUMBER_OF_PARAMETERS];
+    double              metrics[NUMBER_OF_METRICS];
+    long                numberOfFailures; // number of recordings for which the estimation never converged
+} sweepResult;
+
+//=====================================================================================================
+// structure definition: replayStatistics (accumulated over the recordings of a combination)
+//=====================================================================================================
+typedef struct _replayStatistics {
+    double              driftAngle, driftTime;
+    double              jitterSum2;
+    long                jitterCount;
+    double              tiltSum;
+    long                tiltCount;
+    double              convergenceTime;
+    long                numberOfFailures;
+} replayStatistics;
+
+//=====================================================================================================
+// structure definition: parameterSweep
+//=====================================================================================================
+typedef struct _parameterSweep {
+    // recordings (read-only during the sweep)
+    recordedSession**   sessions;
+    long                numberOfSessions;
+    
+    // grid
+    sweepParameter      parameters[MAX_NUMBER_OF_PARAMETERS];
+    int                 numberOfParameters;
+    long                numberOfCombinations;
+    
+    // results, one per combination
+    sweepResult*        results;
+    
+    // next combination to evaluate, shared by the worker threads
+    volatile long       nextCombination;
+} parameterSweep;
+
+int rankingMetric = METRIC_SCORE; // used by compareResults
+
+
+//=====================================================================================================
+// function quaternionAngle
+//=====================================================================================================
+//
+// angle (in degrees) of the rotation between two unit quaternions
+//
+double quaternionAngle(double *a, double *b) {
+    double w, x, y, z;
+    
+    // a^-1 x b
+    w = a[0]*b[0] + a[1]*b[1] + a[2]*b[2] + a[3]*b[3];
+    x = a[0]*b[1] - a[1]*b[0] - a[2]*b[3] + a[3]*b[2];
+    y = a[0]*b[2] + a[1]*b[3] - a[2]*b[0] - a[3]*b[1];
+    z = a[0]*b[3] - a[1]*b[2] + a[2]*b[1] - a[3]*b[0];
+    
+    return 2 * atan2(sqrt(x*x + y*y + z*z), fabs(w)) * 180 / M_PI;
+}
+
+
+//=====================================================================================================
+// function replaySession
+//=====================================================================================================
+//
+// replay a recording through trackingData (prepared by recordedSession_initReplay) and accumulate its statistics
+//
+void replaySession(recordedSession *session, headtrackerData *trackingData, replayStatistics *statistics) {
+    double q[4], previousQ[4], segmentStartQ[4], gravity[3], norm, accNorm, tilt, angle;
+    double samplePeriod = 1.0 / trackingData->samplerate;
+    double tiltSumBeforeConvergence = 0;
+    long tiltCountBeforeConvergence = 0, segmentLength = 0, n;
+    char converged = 0, still;
+    
+    for(n = 0; n < session->numberOfFrames; n++) {
+        recordedSession_replayFrame(session, trackingData, n);
+        while(pullNotificationMessage(trackingData) != NOTIFICATION_MESSAGE_NONE);
+        
+        norm = sqrt(trackingData->q1*trackingData->q1 + trackingData->q2*trackingData->q2
+                    + trackingData->q3*trackingData->q3 + trackingData->q4*trackingData->q4);
+        q[0] = trackingData->q1 / norm;
+        q[1] = trackingData->q2 / norm;
+        q[2] = trackingData->q3 / norm;
+        q[3] = trackingData->q4 / norm;
+        
+        // tilt error: gravity predicted by the estimate (earth Z axis in the body frame) vs. measured acceleration
+        accNorm = sqrt(trackingData->accCalData[0]*trackingData->accCalData[0] + trackingData->accCalData[1]*trackingData->accCalData[1]
+                       + trackingData->accCalData[2]*trackingData->accCalData[2]);
+        if(fabs(accNorm - 1) < ACC_NORM_TOLERANCE) {
+            gravity[0] = 2 * (q[1]*q[3] - q[0]*q[2]);
+            gravity[1] = 2 * (q[0]*q[1] + q[2]*q[3]);
+            gravity[2] = q[0]*q[0] - q[1]*q[1] - q[2]*q[2] + q[3]*q[3];
+            tilt = (gravity[0]*trackingData->accCalData[0] + gravity[1]*trackingData->accCalData[1]
+                    + gravity[2]*trackingData->accCalData[2]) / accNorm;
+            tilt = acos(max(min(tilt, 1), -1)) * 180 / M_PI;
+            
+            if(converged) {
+                statistics->tiltSum += tilt;
+                statistics->tiltCount++;
+            } else {
+                tiltSumBeforeConvergence += tilt;
+                tiltCountBeforeConvergence++;
+                if(tilt < CONVERGENCE_THRESHOLD) {
+                    converged = 1;
+                    statistics->convergenceTime += n * samplePeriod;
+                }
+            }
+        }
+        
+        // drift and jitter over the still segments, after convergence
+        still = converged && (sqrt(trackingData->gyroCalData[0]*trackingData->gyroCalData[0] + trackingData->gyroCalData[1]*trackingData->gyroCalData[1]
+                                   + trackingData->gyroCalData[2]*trackingData->gyroCalData[2]) < STILL_GYRO_THRESHOLD);
+        if(still) {
+            if(segmentLength) {
+                angle = quaternionAngle(previousQ, q);
+                statistics->jitterSum2 += angle * angle;
+                statistics->jitterCount++;
+            } else {
+                memcpy(segmentStartQ, q, 4 * sizeof(double));
+            }
+            segmentLength++;
+        }
+        if(segmentLength && (!still || n == session->numberOfFrames - 1)) {
+            // end of a still segment
+            if(segmentLength * samplePeriod >= STILL_MIN_DURATION) {
+                statistics->driftAngle += quaternionAngle(segmentStartQ, still ? q : previousQ);
+                statistics->driftTime += segmentLength * samplePeriod;
+            }
+            segmentLength = 0;
+        }
+        
+        memcpy(previousQ, q, 4 * sizeof(double));
+    }
+    
+    if(!converged) {
+        statistics->convergenceTime += session->numberOfFrames * samplePeriod;
+        statistics->tiltSum += tiltSumBeforeConvergence;
+        statistics->tiltCount += tiltCountBeforeConvergence;
+        statistics->numberOfFailures++;
+    }
+}
+
+
+//=====================================================================================================
+// function evaluateCombination
+//=====================================================================================================
+//
+// replay all the recordings with the combination number "combination" of the grid, and store its metrics
+//
+void evaluateCombination(parameterSweep *sweep, long combination) {
+    sweepResult *result = sweep->results + combination;
+    replayStatistics statistics;
+    headtrackerData *trackingData;
+    char valueString[64];
+    long index = combination, i;
+    int p;
+    
+    // values of the parameters (mixed radix decomposition of the combination number)
+    for(p = 0; p < sweep->numberOfParameters; p++) {
+        result->values[p] = sweep->parameters[p].start + (index % sweep->parameters[p].numberOfValues) * sweep->parameters[p].step;
+        index /= sweep->parameters[p].numberOfValues;
+    }
+    
+    memset(&statistics, 0, sizeof(replayStatistics));
+    
+    for(i = 0; i < sweep->numberOfSessions; i++) {
+        trackingData = headtracker_new();
+        recordedSession_initReplay(sweep->sessions[i], trackingData);
+        for(p = 0; p < sweep->numberOfParameters; p++) {
+            sprintf(valueString, "%g", result->values[p]);
+            processReceiverSettingPair(trackingData, sweep->parameters[p].name, valueString);
+        }
+        
+        replaySession(sweep->sessions[i], trackingData, &statistics);
+        
+        headtracker_free(trackingData);
+    }
+    
+    result->metrics[METRIC_DRIFT] = statistics.driftTime ? statistics.driftAngle / statistics.driftTime : 0;
+    result->metrics[METRIC_JITTER] = statistics.jitterCount ? sqrt(statistics.jitterSum2 / statistics.jitterCount) : 0;
+    result->metrics[METRIC_TILT] = statistics.tiltCount ? statistics.tiltSum / statistics.tiltCount : 0;
+    result->metrics[METRIC_CONVERGENCE] = statistics.convergenceTime / sweep->numberOfSessions;
+    result->numberOfFailures = statistics.numberOfFailures;
+}
+
+
+//=====================================================================================================
+// function workerThreadFunction
+//=====================================================================================================
+//
+// worker thread: evaluates the next combination of the grid until the whole grid is done
+//
+void *workerThreadFunction(void *arg) {
+    parameterSweep *sweep = (parameterSweep*) arg;
+    long combination;
+    
+    while((combination = __sync_fetch_and_add(&sweep->nextCombination, 1)) < sweep->numberOfCombinations)
+        evaluateCombination(sweep, combination);
+    
+    return NULL;
+}
+
+
+//=====================================================================================================
+// function compareResults
+//=====================================================================================================
+//
+// qsort comparison: combinations without failures first, then by increasing value of the ranking metric
+//
+int compareResults(const void *a, const void *b) {
+    const sweepResult *resultA = (const sweepResult*) a, *resultB = (const sweepResult*) b;
+    
+    if(resultA->numberOfFailures != resultB->numberOfFailures)
+        return (resultA->numberOfFailures < resultB->numberOfFailures) ? -1 : 1;
+    if(resultA->metrics[rankingMetric] != resultB->metrics[rankingMetric])
+        return (resultA->metrics[rankingMetric] < resultB->metrics[rankingMetric]) ? -1 : 1;
+    return 0;
+}
+
+
+//=====================================================================================================
+// function runSweep
+//=====================================================================================================
+//
+// evaluate the current grid on numberOfThreads threads, compute the scores and rank the combinations
+//
+int runSweep(parameterSweep *sweep, int numberOfThreads) {
+    pthread_t threads[MAX_NUMBER_OF_THREADS];
+    double best[NUMBER_OF_METRICS];
+    long i, numberOfValidResults = 0;
+    int p, m;
+    
+    sweep->numberOfCombinations = 1;
+    for(p = 0; p < sweep->numberOfParameters; p++)
+        sweep->numberOfCombinations *= sweep->parameters[p].numberOfValues;
+    
+    free(sweep->results);
+    sweep->results = (sweepResult*) malloc(sweep->numberOfCombinations * sizeof(sweepResult));
+    if(sweep->results == NULL) {
+        printf("not enough memory for %ld combinations\r\n", sweep->numberOfCombinations);
+        return 0;
+    }
+    sweep->nextCombination = 0;
+    
+    for(i = 0; i < numberOfThreads; i++)
+        pthread_create(&threads[i], NULL, workerThreadFunction, sweep);
+    for(i = 0; i < numberOfThreads; i++)
+        pthread_join(threads[i], NULL);
+    
+    // best value of each metric (combinations without failures, if any)
+    for(i = 0; i < sweep->numberOfCombinations; i++)
+        if(!sweep->results[i].numberOfFailures) numberOfValidResults++;
+    for(m = 0; m < METRIC_SCORE; m++) {
+        best[m] = HUGE_VAL;
+        for(i = 0; i < sweep->numberOfCombinations; i++)
+            if(!numberOfValidResults || !sweep->results[i].numberOfFailures)
+                best[m] = min(best[m], sweep->results[i].metrics[m]);
+        best[m] = max(best[m], metricResolutions[m]);
+    }
+    
+    for(i = 0; i < sweep->numberOfCombinations; i++) {
+        sweep->results[i].metrics[METRIC_SCORE] = 0;
+        for(m = 0; m < METRIC_SCORE; m++)
+            sweep->results[i].metrics[METRIC_SCORE] += sweep->results[i].metrics[m] / best[m];
+    }
+    
+    qsort(sweep->results, sweep->numberOfCombinations, sizeof(sweepResult), compareResults);
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function refineGrid
+//=====================================================================================================
+//
+// new grid around the best combination: half the step, on +/- the previous step (within the range given by the user)
+//
+void refineGrid(parameterSweep *sweep) {
+    sweepParameter *parameter;
+    double best;
+    int p;
+    
+    for(p = 0; p < sweep->numberOfParameters; p++) {
+        parameter = sweep->parameters + p;
+        if(parameter->numberOfValues < 2) continue;
+        
+        best = sweep->results[0].values[p];
+        parameter->start = max(best - parameter->step, parameter->min);
+        parameter->stop = min(best + parameter->step, parameter->max);
+        parameter->step /= 2;
+        parameter->numberOfValues = (long) floor((parameter->stop - parameter->start) / parameter->step + 1e-9) + 1;
+    }
+}
+
+
+//=====================================================================================================
+// function addParameter
+//=====================================================================================================
+//
+// add a parameter to the grid, from its description "name=start:stop:step" or "name=value"
+// returns 1 if successful, 0 if the description or the name is not valid
+//
+int addParameter(parameterSweep *sweep, const char *description) {
+    sweepParameter *parameter;
+    receiverSetting *setting;
+    const char *equal;
+    int n;
+    
+    if(sweep->numberOfParameters >= MAX_NUMBER_OF_PARAMETERS) {
+        printf("too many parameters (max %d)\r\n", MAX_NUMBER_OF_PARAMETERS);
+        return 0;
+    }
+    
+    parameter = sweep->parameters + sweep->numberOfParameters;
+    
+    if((equal = strchr(description, '=')) == NULL || equal - description >= MAX_PARAMETER_NAME_LENGTH) {
+        printf("invalid parameter %s\r\n", description);
+        return 0;
+    }
+    strncpy(parameter->name, description, equal - description);
+    parameter->name[equal - description] = 0;
+    
+    for(setting = receiverSettings; setting->name; setting++)
+        if(!strcmp(setting->name, parameter->name)) break;
+    if(!setting->name) {
+        printf("unknown receiver setting %s\r\n", parameter->name);
+        return 0;
+    }
+    
+    n = sscanf(equal + 1, "%lf:%lf:%lf", &parameter->start, &parameter->stop, &parameter->step);
+    if(n == 1) {
+        parameter->stop = parameter->start;
+        parameter->step = 1;
+    } else if(n != 3 || parameter->step <= 0 || parameter->stop < parameter->start) {
+        printf("invalid range for %s (start:stop:step)\r\n", parameter->name);
+        return 0;
+    }
+    
+    parameter->min = parameter->start;
+    parameter->max = parameter->stop;
+    parameter->numberOfValues = (long) floor((parameter->stop - parameter->start) / parameter->step + 1e-9) + 1;
+    sweep->numberOfParameters++;
+    
+    return 1;
+}
+
+
+void printResults(parameterSweep *sweep, long numberOfResults) {
+    long i;
+    int p, m;
+    
+    printf("rank");
+    for(p = 0; p < sweep->numberOfParameters; p++) printf("\t%s", sweep->parameters[p].name);
+    for(m = 0; m < NUMBER_OF_METRICS; m++) printf("\t%s", metricNames[m]);
+    printf("\tfailures\r\n");
+    
+    for(i = 0; i < min(numberOfResults, sweep->numberOfCombinations); i++) {
+        printf("%ld", i + 1);
+        for(p = 0; p < sweep->numberOfParameters; p++) printf("\t%g", sweep->results[i].values[p]);
+        for(m = 0; m < NUMBER_OF_METRICS; m++) printf("\t%.4f", sweep->results[i].metrics[m]);
+        printf("\t%ld\r\n", sweep->results[i].numberOfFailures);
+    }
+}
+
+
+void printUsage() {
+    printf("usage: hedrot_sweep [-j threads] [-r frame rate] [-p name=start:stop:step]... [-z refinement passes] [-s metric] [-n results] recordings...\r\n");
+    printf("\t-j: number of worker threads (default: number of cores)\r\n");
+    printf("\t-r: rate of the recorded frames in Hz (default: samplerate of the header of each recording)\r\n");
+    printf("\t-p: receiver setting to sweep, can be repeated (default: MadgwickBetaMax=0.5:4:0.5 MadgwickBetaGain=0.25:2:0.25 accLPtimeConstant=0:0.05:0.01)\r\n");
+    printf("\t-z: number of refinement passes around the best combination (default: 0)\r\n");
+    printf("\t-s: ranking metric (drift, jitter, tilt, convergence, score) (default: score)\r\n");
+    printf("\t-n: number of results to print (default: %d)\r\n", DEFAULT_NUMBER_OF_RESULTS);
+}
+
+
+int main(int argc, const char * argv[]) {
+    parameterSweep *sweep;
+    long framerate = 0, numberOfResults = DEFAULT_NUMBER_OF_RESULTS, i;
+    int numberOfThreads = (int) sysconf(_SC_NPROCESSORS_ONLN), numberOfPasses = 0, pass, m;
+    double startTime;
+    
+    printf("Hedrot parameter sweep, based on hedrot version %s, compiled on "__DATE__"\r\n", HEDROT_VERSION);
+    
+    sweep = (parameterSweep*) malloc(sizeof(parameterSweep));
+    sweep->sessions = (recordedSession**) malloc(argc * sizeof(recordedSession*));
+    sweep->numberOfSessions = 0;
+    sweep->numberOfParameters = 0;
+    sweep->results = NULL;
+    
+    // arguments
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-j") && i+1 < argc) numberOfThreads = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-r") && i+1 < argc) framerate = atol(argv[++i]);
+        else if(!strcmp(argv[i], "-z") && i+1 < argc) numberOfPasses = atoi(argv[++i]);
+        else if(!strcmp(argv[i], "-n") && i+1 < argc) numberOfResults = atol(argv[++i]);
+        else if(!strcmp(argv[i], "-p") && i+1 < argc) {
+            if(!addParameter(sweep, argv[++i])) return 1;
+        } else if(!strcmp(argv[i], "-s") && i+1 < argc) {
+            i++;
+            for(m = 0; m < NUMBER_OF_METRICS; m++)
+                if(!strcmp(argv[i], metricNames[m])) break;
+            if(m == NUMBER_OF_METRICS) {
+                printUsage();
+                return 1;
+            }
+            rankingMetric = m;
+        } else if(argv[i][0] == '-') {
+            printUsage();
+            return 1;
+        } else {
+            // recording
+            sweep->sessions[sweep->numberOfSessions] = newRecordedSession();
+            sweep->sessions[sweep->numberOfSessions]->samplerate = framerate;
+            if(!recordedSession_read(sweep->sessions[sweep->numberOfSessions], (char*) argv[i])) return 1;
+            if(sweep->sessions[sweep->numberOfSessions]->samplerate <= 0) {
+                printf("unknown frame rate for %s, use -r\r\n", argv[i]);
+                return 1;
+            }
+            printf("%s: %ld frames at %ld Hz\r\n", argv[i], sweep->sessions[sweep->numberOfSessions]->numberOfFrames,
+                   sweep->sessions[sweep->numberOfSessions]->samplerate);
+            sweep->numberOfSessions++;
+        }
+    }
+    
+    if(!sweep->numberOfSessions) {
+        printUsage();
+        return 1;
+    }
+    
+    // default grid
+    if(!sweep->numberOfParameters) {
+        addParameter(sweep, "MadgwickBetaMax=0.5:4:0.5");
+        addParameter(sweep, "MadgwickBetaGain=0.25:2:0.25");
+        addParameter(sweep, "accLPtimeConstant=0:0.05:0.01");
+    }
+    
+    numberOfThreads = max(min(numberOfThreads, MAX_NUMBER_OF_THREADS), 1);
+    
+    for(pass = 0; pass <= numberOfPasses; pass++) {
+        if(pass) refineGrid(sweep);
+        
+        startTime = get_monotonic_time();
+        if(!runSweep(sweep, numberOfThreads)) return 1;
+        printf("pass %d: %ld combinations on %d threads in %.2f s\r\n", pass, sweep->numberOfCombinations, numberOfThreads,
+               get_monotonic_time() - startTime);
+    }
+    
+    printResults(sweep, numberOfResults);
+    
+    for(i = 0; i < sweep->numberOfSessions; i++)
+        freeRecordedSession(sweep->sessions[i]);
+    free(sweep->sessions);
+    free(sweep->results);
+    free(sweep);
+    
+    return 0;
+}
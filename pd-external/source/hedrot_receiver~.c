@@ -0,0 +1,499 @@
+// hedrot_receiver~.c
+//
+// Pure Data external (Linux): headtracker receiver with signal-rate pose outputs
+//
+// the headtracker is read by a separate thread (headtracker_tick every TICK_PERIOD), never by the DSP: the perform
+// routine interpolates the pose at every sample of the block from the timestamped history of the poses
+// (headtracker_getBlockPoses, lock-free). The DSP blocks are mapped to the host clock by a DLL (audioClockMapping)
+// fed with the time of each perform call, which filters out the scheduling jitter of the blocks. The poses are
+// delayed by poseDelay, so that they are interpolated between received frames instead of extrapolated.
+//
+// the messages of the Max external are accepted (open, close, devices, center, version, export/import_settings,
+// headtracker and receiver settings as "<name> <value>"). The notifications of libhedrot are checked by a clock
+// in the Pd main thread and output on the rightmost outlet (status)
+//
+// outlets: qw~ qx~ qy~ qz~ (centered quaternion, W,X,Y,Z) yaw~ pitch~ roll~ (in degrees), status
+//
+// Copyright 2016 Alexis Baskind
+
+#include "hedrot_receiver~.h"
+
+
+/* ---------------- OBJECT LIFECYCLE ------------------------- */
+
+void *hedrot_receiver_tilde_new(t_symbol *s, int argc, t_atom *argv)
+{
+    t_hedrot_receiver_tilde *x = (t_hedrot_receiver_tilde *)pd_new(hedrot_receiver_tilde_class);
+    pthread_mutexattr_t mutexAttributes;
+    int i;
+    
+    post("hedrot_receiver~ version %s, compiled on "__DATE__, HEDROT_VERSION);
+    
+    // outlets, from left to right
+    for(i = 0; i < NUMBER_OF_SIGNAL_OUTLETS; i++)
+        x->x_signal_outlets[i] = outlet_new(&x->x_obj, &s_signal);
+    x->x_status_outlet = outlet_new(&x->x_obj, &s_anything);
+    
+    x->verbose = 0;
+    x->canvasDirectory = canvas_getcurrentdir();
+    
+    // headtracker: only the pose history is needed (the signals are interpolated in the history)
+    x->trackingData = headtracker_new();
+    x->trackingData->serialcomm->baud = 57600;
+    setOutputMask(x->trackingData, OUTPUT_MASK_POSE_HISTORY);
+    
+    pthread_mutexattr_init(&mutexAttributes);
+    pthread_mutexattr_settype(&mutexAttributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&x->trackingDataMutex, &mutexAttributes);
+    pthread_mutexattr_destroy(&mutexAttributes);
+    
+    // DSP
+    audioClockMapping_init(&x->mapping, sys_getsr());
+    x->sampleCounter = 0;
+    x->quaternions = NULL;
+    x->quaternionsBlockSize = 0;
+    hedrot_receiver_tilde_poseDelay(x, (argc >= 1) ? atom_getfloatarg(0, argc, argv) : DEFAULT_POSE_DELAY);
+    
+    // reader thread and notifications
+    x->readerThreadRunning = 1;
+    pthread_create(&x->readerThread, NULL, hedrot_receiver_tilde_readerThreadFunction, x);
+    
+    x->notification_clock = clock_new(x, (t_method)hedrot_receiver_tilde_notificationTick);
+    clock_delay(x->notification_clock, NOTIFICATION_PERIOD);
+    
+    return x;
+}
+
+
+void hedrot_receiver_tilde_free(t_hedrot_receiver_tilde *x)
+{
+    clock_unset(x->notification_clock);
+    clock_free(x->notification_clock);
+    
+    x->readerThreadRunning = 0;
+    pthread_join(x->readerThread, NULL);
+    
+    setHeadtrackerOn(x->trackingData, 0);
+    export_gyroOffsetStore(x->trackingData);
+    headtracker_free(x->trackingData);
+    pthread_mutex_destroy(&x->trackingDataMutex);
+    
+    if(x->quaternions) freebytes(x->quaternions, 4 * x->quaternionsBlockSize * sizeof(float));
+}
+
+
+/* ---------------- READER THREAD AND NOTIFICATIONS ------------------------- */
+
+//=====================================================================================================
+// function hedrot_receiver_tilde_readerThreadFunction
+//=====================================================================================================
+//
+// reader thread: receives the data of the headtracker, estimates the orientation and fills the history of the poses
+//
+void *hedrot_receiver_tilde_readerThreadFunction(void *arg) {
+    t_hedrot_receiver_tilde *x = (t_hedrot_receiver_tilde*) arg;
+    
+    while(x->readerThreadRunning) {
+        pthread_mutex_lock(&x->trackingDataMutex);
+        headtracker_tick(x->trackingData);
+        pthread_mutex_unlock(&x->trackingDataMutex);
+        
+        usleep((int) (TICK_PERIOD * 1000000));
+    }
+    
+    return NULL;
+}
+
+
+//=====================================================================================================
+// function hedrot_receiver_tilde_notificationTick
+//=====================================================================================================
+//
+// Pd main thread: outputs the notification messages of libhedrot
+//
+void hedrot_receiver_tilde_notificationTick(t_hedrot_receiver_tilde *x) {
+    char messageNumber;
+    char str[80];
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    
+    while( (messageNumber = pullNotificationMessage(x->trackingData)) ) {
+        switch( messageNumber ) {
+            case NOTIFICATION_MESSAGE_COMM_PORT_LIST_UPDATED:
+                hedrot_receiver_tilde_outputPortList(x);
+                break;
+            case NOTIFICATION_MESSAGE_PORT_OPENED:
+                hedrot_receiver_tilde_selectOpenedPortInList(x);
+                break;
+            case NOTIFICATION_MESSAGE_WRONG_FIRMWARE_VERSION:
+                sprintf(str, "Wrong Headtracker Firmware Version - expected version: %i - actual version: %i", HEDROT_FIRMWARE_VERSION, x->trackingData->firmwareVersion);
+                hedrot_receiver_tilde_outputSymbolNotice(x, "wrong_firmware_version", str);
+                pd_error(x, "[hedrot_receiver~]: wrong firmware version");
+                break;
+            case NOTIFICATION_MESSAGE_HEADTRACKER_STATUS_CHANGED:
+                hedrot_receiver_tilde_outputReceptionStatus(x);
+                break;
+            case NOTIFICATION_MESSAGE_SETTINGS_DATA_TRANSMISSION_FAILED:
+                if(x->verbose) post("[hedrot_receiver~] : settings not correctly transmitted by head tracker");
+                break;
+            case NOTIFICATION_MESSAGE_EXPORT_SETTINGS_FAILED:
+                if(x->verbose) post("[hedrot_receiver~] : could not save settings into file");
+                break;
+            case NOTIFICATION_MESSAGE_IMPORT_SETTINGS_FAILED:
+                if(x->verbose) post("[hedrot_receiver~] : could not read settings from file");
+                break;
+            case NOTIFICATION_MESSAGE_CALIBRATION_NOT_VALID:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "calibration_not_valid", "calibration not valid");
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_STARTED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "gyro_calibration", "started");
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_FINISHED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "gyro_calibration", "finished");
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_RESTORED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "gyro_calibration", "restored");
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_OFFSET_STORE_UPDATED:
+                // Pd main thread: the signal outlets read the poses without lock, they are not stalled by the file access
+                if(!export_gyroOffsetStore(x->trackingData)) pd_error(x, "[hedrot_receiver~]: could not store the gyroscope offset");
+                break;
+            case NOTIFICATION_MESSAGE_GYRO_CALIBRATION_WINDOW_CLAMPED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "gyro_calibration", "window_clamped");
+                break;
+            case NOTIFICATION_MESSAGE_MAG_RT_CALIBRATION_SUCCEEDED:
+                if(x->verbose) post("[hedrot_receiver~] : magnetometer new calibrated");
+                break;
+            case NOTIFICATION_MESSAGE_BOARD_OVERLOAD:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "board_overload", "board too slow, reduce samplerate");
+                break;
+            case NOTIFICATION_MESSAGE_MAG_DISTURBANCE_STARTED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "mag_disturbance", "started");
+                break;
+            case NOTIFICATION_MESSAGE_MAG_DISTURBANCE_ENDED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "mag_disturbance", "ended");
+                break;
+            case NOTIFICATION_MESSAGE_IDLE_MODE_STARTED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "idle_mode", "started");
+                break;
+            case NOTIFICATION_MESSAGE_IDLE_MODE_ENDED:
+                hedrot_receiver_tilde_outputSymbolNotice(x, "idle_mode", "ended");
+                break;
+            default:
+                // calibration messages of the Max external, not handled here
+                if(x->verbose) post("[hedrot_receiver~] : message %d from libhedrot ignored", messageNumber);
+                break;
+        }
+    }
+    
+    pthread_mutex_unlock(&x->trackingDataMutex);
+    
+    clock_delay(x->notification_clock, NOTIFICATION_PERIOD);
+}
+
+
+void hedrot_receiver_tilde_outputPortList(t_hedrot_receiver_tilde *x) {
+    t_atom message_clear[2], outptr[4];
+    int i;
+    
+    SETSYMBOL(message_clear, gensym("available_ports"));
+    SETSYMBOL(message_clear+1, gensym("clear"));
+    outlet_anything(x->x_status_outlet, gensym("serial"), 2, message_clear);
+    
+    for(i=0; i<x->trackingData->serialcomm->numberOfAvailablePorts; i++) {
+        SETSYMBOL(outptr, gensym("available_ports"));
+        SETSYMBOL(outptr+1, gensym("append"));
+        SETFLOAT(outptr+2, i);
+        SETSYMBOL(outptr+3, gensym(x->trackingData->serialcomm->availablePorts[i]));
+        outlet_anything(x->x_status_outlet, gensym("serial"), 4, outptr);
+        
+        if(x->verbose) post("[hedrot_receiver~]: port %d, %s", i, x->trackingData->serialcomm->availablePorts[i]);
+    }
+}
+
+
+void hedrot_receiver_tilde_selectOpenedPortInList(t_hedrot_receiver_tilde *x) {
+    t_atom outptr[3];
+    
+    SETSYMBOL(outptr, gensym("available_ports"));
+    SETSYMBOL(outptr+1, gensym("set"));
+    SETFLOAT(outptr+2, x->trackingData->serialcomm->portNumber);
+    outlet_anything(x->x_status_outlet, gensym("serial"), 3, outptr);
+}
+
+
+void hedrot_receiver_tilde_outputReceptionStatus(t_hedrot_receiver_tilde *x) {
+    const char *status = "";
+    
+    switch(x->trackingData->infoReceptionStatus) {
+        case COMMUNICATION_STATE_NO_CONNECTED_HEADTRACKER:
+            status = "no headtracker connected";
+            break;
+        case COMMUNICATION_STATE_AUTODISCOVERING_STARTED:
+            status = "no headtracker connected, autodiscovering";
+            break;
+        case COMMUNICATION_STATE_AUTODISCOVERING_WAITING_FOR_RESPONSE:
+            status = "candidate found, waiting for confirm";
+            break;
+        case COMMUNICATION_STATE_AUTODISCOVERING_NO_HEADTRACKER_THERE:
+            status = "candidate is not a headtracker";
+            break;
+        case COMMUNICATION_STATE_AUTODISCOVERING_HEADTRACKER_FOUND:
+            status = "headtracker found";
+            break;
+        case COMMUNICATION_STATE_WAITING_FOR_INFO:
+            status = "headtracker connected, waiting for info";
+            break;
+        case COMMUNICATION_STATE_RECEIVING_INFO:
+            status = "receiving info from headtracker";
+            break;
+        case COMMUNICATION_STATE_HEADTRACKER_TRANSMITTING:
+            status = "headtracker transmitting...";
+            break;
+    }
+    
+    hedrot_receiver_tilde_outputSymbolNotice(x, "headtracker", status);
+    
+    if(x->verbose) post("[hedrot_receiver~]: communication status changed to %d", x->trackingData->infoReceptionStatus);
+}
+
+
+// output "<selector> <message>" on the status outlet, the message as one symbol
+void hedrot_receiver_tilde_outputSymbolNotice(t_hedrot_receiver_tilde *x, const char *selector, const char *message) {
+    t_atom output;
+    
+    SETSYMBOL(&output, gensym(message));
+    outlet_anything(x->x_status_outlet, gensym(selector), 1, &output);
+}
+
+
+/* ---------------- DSP ------------------------- */
+
+void hedrot_receiver_tilde_dsp(t_hedrot_receiver_tilde *x, t_signal **sp)
+{
+    long blockSize = sp[0]->s_n;
+    
+    // buffer of the poses of one block (the DSP is not running while the dsp method is called)
+    if(blockSize > x->quaternionsBlockSize) {
+        if(x->quaternions)
+            x->quaternions = (float*) resizebytes(x->quaternions, 4 * x->quaternionsBlockSize * sizeof(float), 4 * blockSize * sizeof(float));
+        else
+            x->quaternions = (float*) getbytes(4 * blockSize * sizeof(float));
+        x->quaternionsBlockSize = blockSize;
+    }
+    
+    // restart the mapping of the DSP clock (new samplerate, or DSP restarted)
+    audioClockMapping_init(&x->mapping, sp[0]->s_sr);
+    x->sampleCounter = 0;
+    x->poseDelaySamples = x->poseDelay * .001 * sp[0]->s_sr;
+    
+    dsp_add(hedrot_receiver_tilde_perform, 9, x, sp[0]->s_vec, sp[1]->s_vec, sp[2]->s_vec, sp[3]->s_vec,
+            sp[4]->s_vec, sp[5]->s_vec, sp[6]->s_vec, (t_int) blockSize);
+}
+
+
+//=====================================================================================================
+// function hedrot_receiver_tilde_perform
+//=====================================================================================================
+//
+// perform routine: one pose per sample of the block, never waits for the reader thread
+//
+t_int *hedrot_receiver_tilde_perform(t_int *w)
+{
+    t_hedrot_receiver_tilde *x = (t_hedrot_receiver_tilde *)(w[1]);
+    t_sample *outs[NUMBER_OF_SIGNAL_OUTLETS];
+    long n, numberOfSamples = (long) w[9];
+    float *q, yaw, pitch, roll;
+    int i;
+    
+    for(i = 0; i < NUMBER_OF_SIGNAL_OUTLETS; i++)
+        outs[i] = (t_sample *)(w[i+2]);
+    
+    // timestamp of the first sample of the block: the perform routine is called just before the block is computed
+    audioClockMapping_update(&x->mapping, x->sampleCounter, get_monotonic_time());
+    
+    headtracker_getBlockPoses(x->trackingData, &x->mapping, x->sampleCounter - x->poseDelaySamples, numberOfSamples, 1, x->quaternions);
+    x->sampleCounter += numberOfSamples;
+    
+    for(n = 0, q = x->quaternions; n < numberOfSamples; n++, q += 4) {
+        outs[0][n] = q[0];
+        outs[1][n] = q[1];
+        outs[2][n] = q[2];
+        outs[3][n] = q[3];
+        x->trackingData->quaternion2EulerAngles(q[0], q[1], q[2], q[3], &yaw, &pitch, &roll);
+        outs[4][n] = yaw;
+        outs[5][n] = pitch;
+        outs[6][n] = roll;
+    }
+    
+    return (w+10);
+}
+
+
+/* ---------------- METHODS ------------------------- */
+
+void hedrot_receiver_tilde_open(t_hedrot_receiver_tilde *x, t_floatarg n)
+{
+    pthread_mutex_lock(&x->trackingDataMutex);
+    // only transmit the open command from outside if autodiscover is not on
+    if(!x->trackingData->autoDiscover)
+        headtracker_open(x->trackingData, (int) n);
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+void hedrot_receiver_tilde_close(t_hedrot_receiver_tilde *x)
+{
+    if(x->verbose) post("[hedrot_receiver~] closing port...");
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    headtracker_close(x->trackingData);
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+void hedrot_receiver_tilde_devices(t_hedrot_receiver_tilde *x) {
+    pthread_mutex_lock(&x->trackingDataMutex);
+    headtracker_list_comm_ports(x->trackingData);
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+void hedrot_receiver_tilde_center_angles(t_hedrot_receiver_tilde *x) {
+    pthread_mutex_lock(&x->trackingDataMutex);
+    center_angles(x->trackingData);
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+
+/* ------------------- methods for importing/exporting headtracker settings --------------------------- */
+
+void hedrot_receiver_tilde_export_settings(t_hedrot_receiver_tilde *x, t_symbol *s) {
+    char fullFilename[MAXPDSTRING];
+    
+    hedrot_receiver_tilde_fullFilename(x, (s == &s_) ? gensym("headtrackerSettings.txt") : s, fullFilename);
+    
+    post("[hedrot_receiver~]: try to open file %s for storing settings", fullFilename);
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    if(!export_headtracker_settings(x->trackingData, fullFilename))
+        pd_error(x, "[hedrot_receiver~] Error while exporting settings");
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+
+void hedrot_receiver_tilde_import_settings(t_hedrot_receiver_tilde *x, t_symbol *s) {
+    char fullFilename[MAXPDSTRING];
+    
+    hedrot_receiver_tilde_fullFilename(x, (s == &s_) ? gensym("headtrackerSettings.txt") : s, fullFilename);
+    
+    post("[hedrot_receiver~]: try to open file %s for reading settings", fullFilename);
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    if(!import_headtracker_settings(x->trackingData, fullFilename))
+        pd_error(x, "[hedrot_receiver~] Error while importing settings");
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+
+void hedrot_receiver_tilde_printVersion(t_hedrot_receiver_tilde *x) {
+    post("hedrot_receiver~ version %s, compiled on "__DATE__", required firmware version %d", HEDROT_VERSION, HEDROT_FIRMWARE_VERSION);
+}
+
+
+/* ------------------- settings --------------------------- */
+
+void hedrot_receiver_tilde_verbose(t_hedrot_receiver_tilde *x, t_floatarg verbose) {
+    x->verbose = (char) verbose;
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    setVerbose(x->trackingData, (char) verbose);
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+
+// delay of the signal poses in ms (>= 0)
+void hedrot_receiver_tilde_poseDelay(t_hedrot_receiver_tilde *x, t_floatarg poseDelay) {
+    x->poseDelay = max(poseDelay, 0);
+    x->poseDelaySamples = x->poseDelay * .001 * x->mapping.samplerate;
+}
+
+
+void hedrot_receiver_tilde_gyroOffsetStoreFile(t_hedrot_receiver_tilde *x, t_symbol *s) {
+    char fullFilename[MAXPDSTRING];
+    
+    // empty symbol: disabled
+    if(s == &s_)
+        fullFilename[0] = 0;
+    else
+        hedrot_receiver_tilde_fullFilename(x, s, fullFilename);
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    setGyroOffsetStoreFilename(x->trackingData, fullFilename);
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+
+//=====================================================================================================
+// function hedrot_receiver_tilde_anything
+//=====================================================================================================
+//
+// "<name> <value(s)>": receiver setting (see processReceiverSettingPair) or headtracker setting
+// (see processKeyValueSettingPair, transmitted to the headtracker)
+//
+void hedrot_receiver_tilde_anything(t_hedrot_receiver_tilde *x, t_symbol *s, int argc, t_atom *argv) {
+    char value[MAXPDSTRING], atomString[MAXPDSTRING];
+    int i;
+    
+    // same syntax as the settings files (values separated by spaces)
+    value[0] = 0;
+    for(i = 0; i < argc; i++) {
+        atom_string(argv + i, atomString, MAXPDSTRING);
+        if(strlen(value) + strlen(atomString) + 2 > MAXPDSTRING) break;
+        if(i) strcat(value, " ");
+        strcat(value, atomString);
+    }
+    
+    pthread_mutex_lock(&x->trackingDataMutex);
+    
+    if(!processReceiverSettingPair(x->trackingData, (char *) s->s_name, value)
+       && !processKeyValueSettingPair(x->trackingData, (char *) s->s_name, value, 1))
+        pd_error(x, "[hedrot_receiver~]: invalid value for %s", s->s_name);
+    
+    pthread_mutex_unlock(&x->trackingDataMutex);
+}
+
+
+// file name relative to the directory of the patch (absolute file names are kept)
+void hedrot_receiver_tilde_fullFilename(t_hedrot_receiver_tilde *x, t_symbol *s, char *fullFilename) {
+    if(s->s_name[0] == '/' || !x->canvasDirectory)
+        snprintf(fullFilename, MAXPDSTRING, "%s", s->s_name);
+    else
+        snprintf(fullFilename, MAXPDSTRING, "%s/%s", x->canvasDirectory->s_name, s->s_name);
+}
+
+
+/* ---------------- SETUP ------------------------- */
+
+void hedrot_receiver_tilde_setup(void)
+{
+    t_class *c = class_new(gensym("hedrot_receiver~"), (t_newmethod)hedrot_receiver_tilde_new,
+                           (t_method)hedrot_receiver_tilde_free, sizeof(t_hedrot_receiver_tilde), CLASS_DEFAULT, A_GIMME, 0);
+    
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_dsp,             gensym("dsp"),          A_CANT, 0);
+    
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_open,            gensym("open"),         A_FLOAT, 0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_close,           gensym("close"),        0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_devices,         gensym("devices"),      0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_center_angles,   gensym("center"),       0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_printVersion,    gensym("version"),      0);
+    
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_export_settings, gensym("export_settings"), A_DEFSYM, 0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_import_settings, gensym("import_settings"), A_DEFSYM, 0);
+    
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_verbose,         gensym("verbose"),      A_FLOAT, 0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_poseDelay,       gensym("poseDelay"),    A_FLOAT, 0);
+    class_addmethod(c, (t_method)hedrot_receiver_tilde_gyroOffsetStoreFile, gensym("gyroOffsetStoreFile"), A_DEFSYM, 0);
+    
+    // receiver and headtracker settings
+    class_addanything(c, (t_method)hedrot_receiver_tilde_anything);
+    
+    hedrot_receiver_tilde_class = c;
+}
@@ -0,0 +1,95 @@
+// hedrot_receiver~.h
+//
+// Pure Data external (Linux): headtracker receiver with signal-rate pose outputs
+//
+// Copyright 2016 Alexis Baskind
+
+#ifndef hedrot_receiver_tilde_h
+#define hedrot_receiver_tilde_h
+
+#include "m_pd.h"
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "libhedrot.h"
+#include "hedrot_comm_protocol.h"
+
+// time constants
+#define TICK_PERIOD                 .002 // time period in seconds between two ticks of the reader thread
+#define NOTIFICATION_PERIOD         10   // time period in ms between two checks of the notification messages (Pd main thread)
+#define DEFAULT_POSE_DELAY          20   // default delay of the poses, in ms (reception jitter + scheduling jitter of the DSP blocks)
+
+#define NUMBER_OF_SIGNAL_OUTLETS    7    // qw qx qy qz yaw pitch roll
+
+typedef struct hedrot_receiver_tilde
+{
+    t_object            x_obj;
+    
+    // outlets
+    t_outlet            *x_signal_outlets[NUMBER_OF_SIGNAL_OUTLETS];
+    t_outlet            *x_status_outlet;
+    
+    // headtracker, shared by the reader thread and the Pd main thread (protected by trackingDataMutex)
+    headtrackerData     *trackingData;
+    pthread_mutex_t     trackingDataMutex; // recursive: the outputs may trigger messages sent back to the object
+    
+    // reader thread
+    pthread_t           readerThread;
+    volatile char       readerThreadRunning;
+    
+    // notification messages (Pd main thread)
+    t_clock             *notification_clock;
+    char                verbose;
+    t_symbol            *canvasDirectory; // directory of the patch, for the relative file names
+    
+    // DSP (used by the perform routine only, lock-free)
+    audioClockMapping   mapping; // DSP sample counter -> host time
+    double              sampleCounter; // number of samples computed since the DSP was started
+    float               poseDelay; // delay of the poses, in ms
+    double              poseDelaySamples; // delay of the poses, in samples
+    float               *quaternions; // poses of the samples of the current block (W,X,Y,Z interleaved)
+    long                quaternionsBlockSize; // size in samples of the buffer quaternions
+} t_hedrot_receiver_tilde;
+
+
+/* ---------------- FUNCTIONS ------------------------- */
+
+//  Object lifecycle
+void *hedrot_receiver_tilde_new(t_symbol *s, int argc, t_atom *argv);
+void hedrot_receiver_tilde_free(t_hedrot_receiver_tilde *x);
+
+// reader thread and notifications
+void *hedrot_receiver_tilde_readerThreadFunction(void *arg);
+void hedrot_receiver_tilde_notificationTick(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_outputPortList(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_selectOpenedPortInList(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_outputReceptionStatus(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_outputSymbolNotice(t_hedrot_receiver_tilde *x, const char *selector, const char *message);
+
+// DSP
+void hedrot_receiver_tilde_dsp(t_hedrot_receiver_tilde *x, t_signal **sp);
+t_int *hedrot_receiver_tilde_perform(t_int *w);
+
+// methods
+void hedrot_receiver_tilde_open(t_hedrot_receiver_tilde *x, t_floatarg n);
+void hedrot_receiver_tilde_close(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_devices(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_center_angles(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_export_settings(t_hedrot_receiver_tilde *x, t_symbol *s);
+void hedrot_receiver_tilde_import_settings(t_hedrot_receiver_tilde *x, t_symbol *s);
+void hedrot_receiver_tilde_printVersion(t_hedrot_receiver_tilde *x);
+void hedrot_receiver_tilde_verbose(t_hedrot_receiver_tilde *x, t_floatarg verbose);
+void hedrot_receiver_tilde_poseDelay(t_hedrot_receiver_tilde *x, t_floatarg poseDelay);
+void hedrot_receiver_tilde_gyroOffsetStoreFile(t_hedrot_receiver_tilde *x, t_symbol *s);
+void hedrot_receiver_tilde_anything(t_hedrot_receiver_tilde *x, t_symbol *s, int argc, t_atom *argv);
+void hedrot_receiver_tilde_fullFilename(t_hedrot_receiver_tilde *x, t_symbol *s, char *fullFilename);
+
+void hedrot_receiver_tilde_setup(void);
+
+t_class *hedrot_receiver_tilde_class;
+
+#endif
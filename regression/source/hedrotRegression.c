@@ -0,0 +1,715 @@
+//
+//  hedrotRegression.c
+//
+//  golden-trace regression harness for the estimation and the calibration
+//
+//  raw sensor traces are processed by libhedrot in several numeric modes (estimation method, gyroscope integration,
+//  fast angles...), and the poses (centered quaternion and euler angles) are compared with golden files recorded
+//  beforehand, with a tolerance per mode. The results of the offline calibration (offset and scaling of both methods)
+//  are compared the same way. The throughput of each trace/mode is reported (frames per second)
+//
+//  traces:
+//      . synthetic traces, generated deterministically (still, slow and fast movements, magnetic disturbance), with
+//          calibration point clouds on known ellipsoids
+//      . real captures: recordings of the Max external (option -t) and raw samples of calibrations exported by
+//          export_magCalDataRawSamples/export_accCalDataRawSamples (option -c)
+//  the frames are encoded as sent by the firmware and decoded by headtracker_compute_data, so that the decoder is
+//  tested as well
+//
+//  typical use: generate the golden files with the reference version (option -g), then compare any modified version
+//  with them (exit status 0 if all the traces pass, 1 otherwise)
+//
+//  the folder regression/golden holds the golden files of the current version for the synthetic traces and for the
+//  reference recording regression/traces/reference.txt (synthetic slow movements with a gyroscope bias, a magnetic
+//  disturbance and a non-trivial sensor calibration in the header, written in the text format of the Max external):
+//      ./hedrot_regression -t traces/reference.txt         (from the folder regression)
+//  they are generated again (-g) only when a change of the results is intended. No real capture is provided: real
+//  captures have to be added with -t/-c and their own golden files
+//
+//  golden files (text, one per trace and mode, in the golden directory):
+//      <trace>.<mode>.txt:                 frame q1 q2 q3 q4 yaw pitch roll (every GOLDEN_DECIMATION frames, and the last one)
+//      calibration.<trace>.<method>.txt:   offset x y z / scaling x y z
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "libhedrot.h"
+#include "libhedrot_recording.h"
+
+#define GOLDEN_DECIMATION                   25 // one pose out of GOLDEN_DECIMATION is stored in the golden files
+#define MAX_FILENAME_LENGTH                 1024
+#define MAX_NUMBER_OF_TRACES                64
+#define NUMBER_OF_MODE_SETTINGS             6
+
+// synthetic traces
+#define SYNTHETIC_SAMPLERATE                500
+#define SYNTHETIC_DURATION                  10 // in seconds
+#define SYNTHETIC_MAG_DECIMATION            5 // the magnetometer provides a new sample every SYNTHETIC_MAG_DECIMATION frames
+#define SYNTHETIC_ACC_RADIUS                256 // raw value for 1 g
+#define SYNTHETIC_MAG_RADIUS                500 // raw value for the norm of the magnetic field
+#define SYNTHETIC_NUMBER_OF_CALIBRATION_SAMPLES 2000
+#define RANDOM_SEED                         12345
+
+//=====================================================================================================
+// structure definition: regressionMode (numeric mode of the estimation, with its tolerance)
+//=====================================================================================================
+typedef struct _regressionMode {
+    const char          *name;
+    const char          *settings[NUMBER_OF_MODE_SETTINGS]; // values of the receiver settings modeSettingKeys
+    double              quaternionTolerance; // max absolute error on each component of the quaternion
+    double              angleTolerance; // max absolute error on the angles, in degrees
+} regressionMode;
+
+// every mode sets all these receiver settings, so that the golden files do not depend on their default values
+const char *modeSettingKeys[NUMBER_OF_MODE_SETTINGS] = {
+    "estimationMethod", "gyroIntegrationMethod", "fastAnglesOn", "magMultirateOn", "magDisturbanceGatingOn", "idleModeOn"
+};
+
+const regressionMode regressionModes[] = {
+    //                       method gyroInt fast    multir. gating  idle
+    {"madgwick",            {"0",   "0",    "0",    "0",    "0",    "0"},   1e-4,   .02},
+    {"madgwick-expmap",     {"0",   "1",    "0",    "0",    "0",    "0"},   1e-4,   .02},
+    {"madgwick-fastangles", {"0",   "0",    "1",    "0",    "0",    "0"},   1e-4,   .02},
+    {"madgwick-gating",     {"0",   "0",    "0",    "0",    "1",    "0"},   1e-4,   .02},
+    {"madgwick-multirate",  {"0",   "0",    "0",    "1",    "0",    "0"},   1e-4,   .02},
+    {"gyro",                {"1",   "0",    "0",    "0",    "0",    "0"},   1e-5,   .005},
+    {"eskf",                {"2",   "0",    "0",    "0",    "0",    "0"},   5e-4,   .05},
+    {"eskf-multirate",      {"2",   "0",    "0",    "1",    "0",    "0"},   5e-4,   .05},
+    {NULL,                  {NULL,  NULL,   NULL,   NULL,   NULL,   NULL},  0,      0}
+};
+
+//=====================================================================================================
+// structure definition: calibrationMethod (offline calibration method, with its tolerance)
+//=====================================================================================================
+typedef struct _calibrationMethod {
+    const char          *name;
+    char                offlineCalibrationMethod; // see setOfflineCalibrationMethod
+    double              tolerance; // max relative error on the offset and scaling
+} calibrationMethod;
+
+const calibrationMethod calibrationMethods[] = {
+    {"ellipsoidfit",        0,  1e-4},
+    {"mycalibration",       1,  1e-4},
+    {NULL,                  0,  0}
+};
+
+//=====================================================================================================
+// structure definition: syntheticTrace
+//=====================================================================================================
+typedef struct _syntheticTrace {
+    const char          *name;
+    int                 motion; // 0: still, 1: slow movements, 2: fast movements
+    double              magDisturbance; // magnetic disturbance between 3 and 6 s (relative to the norm of the field)
+    double              gyroBias; // gyroscope bias, in degrees per second
+} syntheticTrace;
+
+const syntheticTrace syntheticTraces[] = {
+    {"still",               0,  0,      .5},
+    {"slow",                1,  0,      .5},
+    {"fast",                2,  0,      -.3},
+    {"magdisturbance",      1,  .5,     .5},
+    {NULL,                  0,  0,      0}
+};
+
+//=====================================================================================================
+// structure definition: syntheticCalibration (point cloud on an ellipsoid)
+//=====================================================================================================
+typedef struct _syntheticCalibration {
+    const char          *name;
+    double              offset[3];
+    double              scaling[3];
+    double              noise; // standard deviation of the noise, in raw units
+} syntheticCalibration;
+
+const syntheticCalibration syntheticCalibrations[] = {
+    {"acc",                 {10, -5, 20},   {256, 250, 262},    2},
+    {"mag",                 {50, -30, 80},  {500, 470, 530},    3},
+    {NULL,                  {0, 0, 0},      {0, 0, 0},          0}
+};
+
+//=====================================================================================================
+// structure definition: regressionPose
+//=====================================================================================================
+typedef struct _regressionPose {
+    long                frame;
+    double              q[4]; // centered quaternion
+    double              angles[3]; // yaw, pitch, roll
+} regressionPose;
+
+char goldenDirectory[MAX_FILENAME_LENGTH] = "golden";
+char generateFlag = 0;
+int numberOfRepetitions = 1;
+unsigned long randomState;
+
+
+//=====================================================================================================
+// functions for the synthetic traces
+//=====================================================================================================
+
+// uniform random number in ]0,1[ (linear congruential generator, reproducible on all platforms)
+double uniformRandom() {
+    randomState = (randomState * 1664525UL + 1013904223UL) & 0xFFFFFFFFUL;
+    return (randomState + 1.0) / 4294967297.0;
+}
+
+// gaussian random number (Box-Muller)
+double gaussianRandom() {
+    double u = uniformRandom(), v = uniformRandom();
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// rotation of the vector v from the earth frame to the body frame of the unit quaternion q (body -> earth)
+void earthToBody(double *q, double *v, double *result) {
+    double w = q[0], x = q[1], y = q[2], z = q[3];
+    
+    result[0] = (1 - 2*(y*y + z*z)) * v[0] + 2*(x*y + w*z) * v[1] + 2*(x*z - w*y) * v[2];
+    result[1] = 2*(x*y - w*z) * v[0] + (1 - 2*(x*x + z*z)) * v[1] + 2*(y*z + w*x) * v[2];
+    result[2] = 2*(x*z + w*y) * v[0] + 2*(y*z - w*x) * v[1] + (1 - 2*(x*x + y*y)) * v[2];
+}
+
+
+//=====================================================================================================
+// function createSyntheticTrace
+//=====================================================================================================
+//
+// generate the raw data of a synthetic trace (exact rotation of the gravity and of the magnetic field, gyroscope with
+// bias and noise, magnetometer at a lower rate) and its header (calibration of the synthetic sensors)
+//
+void createSyntheticTrace(const syntheticTrace *trace, recordedSession *session) {
+    double q[4], dq[4], qn[4], omega[3], acc[3], mag[3], field[3], angle, norm, t;
+    double gravity[3] = {0, 0, 1}, magneticField[3] = {.45, 0, -.89};
+    double gyroFactor = RECORDING_DEFAULT_GYRO_HALFSCALE_SENSITIVITY * M_PI / 180 / pow(2, RECORDING_DEFAULT_GYRO_BITDEPTH - 1);
+    double samplePeriod = 1.0 / SYNTHETIC_SAMPLERATE;
+    short rawData[RECORDING_NUMBER_OF_RAW_VALUES];
+    char value[RECORDING_MAX_VALUE_LENGTH];
+    long n;
+    int i;
+    
+    randomState = RANDOM_SEED;
+    
+    sprintf(value, "%d", SYNTHETIC_SAMPLERATE);
+    recordedSession_addSetting(session, "samplerate", value);
+    recordedSession_addSetting(session, "gyroOffset", "0 0 0");
+    recordedSession_addSetting(session, "accOffset", "0 0 0");
+    sprintf(value, "%d %d %d", SYNTHETIC_ACC_RADIUS, SYNTHETIC_ACC_RADIUS, SYNTHETIC_ACC_RADIUS);
+    recordedSession_addSetting(session, "accScaling", value);
+    recordedSession_addSetting(session, "magOffset", "0 0 0");
+    sprintf(value, "%d %d %d", SYNTHETIC_MAG_RADIUS, SYNTHETIC_MAG_RADIUS, SYNTHETIC_MAG_RADIUS);
+    recordedSession_addSetting(session, "magScaling", value);
+    session->samplerate = SYNTHETIC_SAMPLERATE;
+    
+    // initial orientation: 30 degrees around the axis (0.3, 0.5, 0.81)
+    q[0] = cos(M_PI / 12);
+    q[1] = sin(M_PI / 12) * .3;
+    q[2] = sin(M_PI / 12) * .5;
+    q[3] = sin(M_PI / 12) * sqrt(1 - .34);
+    
+    for(n = 0; n < SYNTHETIC_SAMPLERATE * SYNTHETIC_DURATION; n++) {
+        t = n * samplePeriod;
+        
+        // angular rate (body frame, rad/s)
+        switch(trace->motion) {
+            case 1:
+                omega[0] = 1.0 * sin(2 * M_PI * .3 * t);
+                omega[1] = .7 * sin(2 * M_PI * .2 * t + 1);
+                omega[2] = 2.0 * sin(2 * M_PI * .1 * t);
+                break;
+            case 2:
+                omega[0] = 3.0 * sin(2 * M_PI * 1.0 * t);
+                omega[1] = 1.0 * sin(2 * M_PI * .7 * t + 1);
+                omega[2] = 5.0 * sin(2 * M_PI * .8 * t);
+                break;
+            default:
+                omega[0] = omega[1] = omega[2] = 0;
+                break;
+        }
+        
+        // exact integration over the sample period
+        norm = sqrt(omega[0]*omega[0] + omega[1]*omega[1] + omega[2]*omega[2]);
+        angle = norm * samplePeriod;
+        if(angle > 0) {
+            dq[0] = cos(angle / 2);
+            for(i = 0; i < 3; i++) dq[i+1] = sin(angle / 2) * omega[i] / norm;
+            qn[0] = q[0]*dq[0] - q[1]*dq[1] - q[2]*dq[2] - q[3]*dq[3];
+            qn[1] = q[0]*dq[1] + q[1]*dq[0] + q[2]*dq[3] - q[3]*dq[2];
+            qn[2] = q[0]*dq[2] - q[1]*dq[3] + q[2]*dq[0] + q[3]*dq[1];
+            qn[3] = q[0]*dq[3] + q[1]*dq[2] - q[2]*dq[1] + q[3]*dq[0];
+            memcpy(q, qn, 4 * sizeof(double));
+        }
+        
+        // sensors
+        earthToBody(q, gravity, acc);
+        memcpy(field, magneticField, 3 * sizeof(double));
+        if(t >= 3 && t < 6) field[1] += trace->magDisturbance;
+        earthToBody(q, field, mag);
+        
+        for(i = 0; i < 3; i++) {
+            if(!(n % SYNTHETIC_MAG_DECIMATION))
+                rawData[i] = (short) floor(mag[i] * SYNTHETIC_MAG_RADIUS + 2 * gaussianRandom() + .5);
+            rawData[i+3] = (short) floor(acc[i] * SYNTHETIC_ACC_RADIUS + 2 * gaussianRandom() + .5);
+            rawData[i+6] = (short) floor((omega[i] + trace->gyroBias * M_PI / 180) / gyroFactor + 3 * gaussianRandom() + .5);
+        }
+        
+        recordedSession_addFrame(session, rawData);
+    }
+}
+
+
+//=====================================================================================================
+// function createSyntheticCalibration
+//=====================================================================================================
+//
+// fill the calibration data with points on an ellipsoid (uniformly distributed directions, with noise)
+//
+void createSyntheticCalibration(const syntheticCalibration *calibration, calibrationData *calData) {
+    double direction[3], norm;
+    long n;
+    int i;
+    
+    randomState = RANDOM_SEED;
+    
+    for(n = 0; n < SYNTHETIC_NUMBER_OF_CALIBRATION_SAMPLES; n++) {
+        do {
+            for(i = 0; i < 3; i++) direction[i] = gaussianRandom();
+            norm = sqrt(direction[0]*direction[0] + direction[1]*direction[1] + direction[2]*direction[2]);
+        } while(norm < 1e-6);
+        
+        for(i = 0; i < 3; i++)
+            calData->rawSamples[n][i] = floor(calibration->offset[i] + calibration->scaling[i] * direction[i] / norm
+                                              + calibration->noise * gaussianRandom() + .5);
+    }
+    calData->numberOfSamples = SYNTHETIC_NUMBER_OF_CALIBRATION_SAMPLES;
+}
+
+
+//=====================================================================================================
+// function readCalibrationSamples
+//=====================================================================================================
+//
+// read the raw samples of a calibration (format of export_magCalDataRawSamples: "index, x y z;")
+// returns 1 if successful, 0 otherwise
+//
+int readCalibrationSamples(char *filename, calibrationData *calData) {
+    FILE *file;
+    char line[RECORDING_MAX_LINE_LENGTH];
+    long index;
+    
+    if((file = fopen(filename, "r")) == NULL) {
+        printf("cannot open %s\r\n", filename);
+        return 0;
+    }
+    
+    calData->numberOfSamples = 0;
+    while(fgets(line, RECORDING_MAX_LINE_LENGTH, file) && calData->numberOfSamples < MAX_NUMBER_OF_SAMPLES_FOR_CALIBRATION)
+        if(sscanf(line, "%ld, %lf %lf %lf", &index, &calData->rawSamples[calData->numberOfSamples][0],
+                  &calData->rawSamples[calData->numberOfSamples][1], &calData->rawSamples[calData->numberOfSamples][2]) == 4)
+            calData->numberOfSamples++;
+    
+    fclose(file);
+    
+    return calData->numberOfSamples > 0;
+}
+
+
+//=====================================================================================================
+// function encodeRawData
+//=====================================================================================================
+//
+// encode 3 values in 7 bytes, as sent by the firmware (see hedrot-firmware.ino and convert_7bytes_to_3int16)
+//
+void encodeRawData(short *values, unsigned char *rawDataBuffer, int baseIndex) {
+    unsigned short vx = (unsigned short) values[0], vy = (unsigned short) values[1], vz = (unsigned short) values[2];
+    
+    rawDataBuffer[baseIndex]   = (unsigned char) (128 | (vx >> 9));
+    rawDataBuffer[baseIndex+1] = (unsigned char) (128 | ((unsigned short)(vx << 7) >> 9));
+    rawDataBuffer[baseIndex+2] = (unsigned char) (128 | ((unsigned short)(vx << 14) >> 9) | (vy >> 11));
+    rawDataBuffer[baseIndex+3] = (unsigned char) (128 | ((unsigned short)(vy << 5) >> 9));
+    rawDataBuffer[baseIndex+4] = (unsigned char) (128 | ((unsigned short)(vy << 12) >> 9) | (vz >> 13));
+    rawDataBuffer[baseIndex+5] = (unsigned char) (128 | ((unsigned short)(vz << 3) >> 9));
+    rawDataBuffer[baseIndex+6] = (unsigned char) (128 | ((unsigned short)(vz << 10) >> 9) | 1);
+}
+
+
+//=====================================================================================================
+// function processTrace
+//=====================================================================================================
+//
+// process a trace in a mode, store the decimated poses (poses has to hold numberOfFrames/GOLDEN_DECIMATION+2 poses)
+// returns the processing time, in seconds
+//
+double processTrace(recordedSession *session, const regressionMode *mode, regressionPose *poses, long *numberOfPoses) {
+    headtrackerData *trackingData;
+    double startTime, elapsedTime;
+    long n;
+    int i;
+    
+    trackingData = headtracker_new();
+    setOutputMask(trackingData, OUTPUT_MASK_QUATERNION | OUTPUT_MASK_ANGLES);
+    recordedSession_initReplay(session, trackingData);
+    for(i = 0; i < NUMBER_OF_MODE_SETTINGS; i++)
+        processReceiverSettingPair(trackingData, (char*) modeSettingKeys[i], (char*) mode->settings[i]);
+    
+    *numberOfPoses = 0;
+    startTime = get_monotonic_time();
+    
+    for(n = 0; n < session->numberOfFrames; n++) {
+        encodeRawData(session->rawData + n * RECORDING_NUMBER_OF_RAW_VALUES, trackingData->rawDataBuffer, 0);
+        encodeRawData(session->rawData + n * RECORDING_NUMBER_OF_RAW_VALUES + 3, trackingData->rawDataBuffer, 7);
+        encodeRawData(session->rawData + n * RECORDING_NUMBER_OF_RAW_VALUES + 6, trackingData->rawDataBuffer, 14);
+        headtracker_compute_data(trackingData);
+        while(pullNotificationMessage(trackingData) != NOTIFICATION_MESSAGE_NONE);
+        
+        headtracker_updateOutputs(trackingData);
+        
+        if(!(n % GOLDEN_DECIMATION) || n == session->numberOfFrames - 1) {
+            poses[*numberOfPoses].frame = n;
+            poses[*numberOfPoses].q[0] = trackingData->qcent1;
+            poses[*numberOfPoses].q[1] = trackingData->qcent2;
+            poses[*numberOfPoses].q[2] = trackingData->qcent3;
+            poses[*numberOfPoses].q[3] = trackingData->qcent4;
+            poses[*numberOfPoses].angles[0] = trackingData->yaw;
+            poses[*numberOfPoses].angles[1] = trackingData->pitch;
+            poses[*numberOfPoses].angles[2] = trackingData->roll;
+            (*numberOfPoses)++;
+        }
+    }
+    
+    elapsedTime = get_monotonic_time() - startTime;
+    
+    headtracker_free(trackingData);
+    
+    return elapsedTime;
+}
+
+
+//=====================================================================================================
+// function writeGoldenPoses / readGoldenPoses
+//=====================================================================================================
+//
+// golden file of a trace in a mode: "frame q1 q2 q3 q4 yaw pitch roll" per line
+// return 1 if successful, 0 otherwise
+//
+int writeGoldenPoses(char *filename, regressionPose *poses, long numberOfPoses) {
+    FILE *file;
+    long n;
+    
+    if((file = fopen(filename, "w")) == NULL) return 0;
+    
+    for(n = 0; n < numberOfPoses; n++)
+        fprintf(file, "%ld %.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", poses[n].frame, poses[n].q[0], poses[n].q[1], poses[n].q[2], poses[n].q[3],
+                poses[n].angles[0], poses[n].angles[1], poses[n].angles[2]);
+    
+    return !fclose(file);
+}
+
+int readGoldenPoses(char *filename, regressionPose *poses, long maxNumberOfPoses, long *numberOfPoses) {
+    FILE *file;
+    regressionPose *pose;
+    
+    if((file = fopen(filename, "r")) == NULL) return 0;
+    
+    *numberOfPoses = 0;
+    while(*numberOfPoses < maxNumberOfPoses) {
+        pose = poses + *numberOfPoses;
+        if(fscanf(file, "%ld %lf %lf %lf %lf %lf %lf %lf", &pose->frame, &pose->q[0], &pose->q[1], &pose->q[2], &pose->q[3],
+                  &pose->angles[0], &pose->angles[1], &pose->angles[2]) != 8) break;
+        (*numberOfPoses)++;
+    }
+    
+    fclose(file);
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function comparePoses
+//=====================================================================================================
+//
+// max errors between the poses and the golden poses (q and -q are the same rotation, the angles are wrapped)
+// returns 1 if both lists have the same frames, 0 otherwise
+//
+int comparePoses(regressionPose *poses, regressionPose *goldenPoses, long numberOfPoses, double *quaternionError, double *angleError) {
+    double errorPlus, errorMinus, error;
+    long n;
+    int i;
+    
+    *quaternionError = 0;
+    *angleError = 0;
+    
+    for(n = 0; n < numberOfPoses; n++) {
+        if(poses[n].frame != goldenPoses[n].frame) return 0;
+        
+        errorPlus = 0;
+        errorMinus = 0;
+        for(i = 0; i < 4; i++) {
+            errorPlus = max(errorPlus, fabs(poses[n].q[i] - goldenPoses[n].q[i]));
+            errorMinus = max(errorMinus, fabs(poses[n].q[i] + goldenPoses[n].q[i]));
+        }
+        *quaternionError = max(*quaternionError, min(errorPlus, errorMinus));
+        
+        for(i = 0; i < 3; i++) {
+            error = fmod(fabs(poses[n].angles[i] - goldenPoses[n].angles[i]), 360);
+            *angleError = max(*angleError, min(error, 360 - error));
+        }
+    }
+    
+    return 1;
+}
+
+
+//=====================================================================================================
+// function runTrace
+//=====================================================================================================
+//
+// process a trace in all the modes, and generate or check the golden files
+// returns the number of failures
+//
+int runTrace(const char *traceName, recordedSession *session) {
+    const regressionMode *mode;
+    regressionPose *poses, *goldenPoses;
+    char filename[MAX_FILENAME_LENGTH];
+    long maxNumberOfPoses = session->numberOfFrames / GOLDEN_DECIMATION + 2, numberOfPoses, numberOfGoldenPoses;
+    double elapsedTime, time, quaternionError, angleError;
+    int numberOfFailures = 0, r;
+    
+    poses = (regressionPose*) malloc(maxNumberOfPoses * sizeof(regressionPose));
+    goldenPoses = (regressionPose*) malloc(maxNumberOfPoses * sizeof(regressionPose));
+    
+    for(mode = regressionModes; mode->name; mode++) {
+        // golden file, the trace is not processed if its name does not fit
+        if(snprintf(filename, MAX_FILENAME_LENGTH, "%s/%s.%s.txt", goldenDirectory, traceName, mode->name) >= MAX_FILENAME_LENGTH) {
+            printf("%-24s %-20s FAILED (golden file name too long)\r\n", traceName, mode->name);
+            numberOfFailures++;
+            continue;
+        }
+        
+        // best time over the repetitions
+        elapsedTime = HUGE_VAL;
+        for(r = 0; r < numberOfRepetitions; r++) {
+            time = processTrace(session, mode, poses, &numberOfPoses);
+            elapsedTime = min(elapsedTime, time);
+        }
+        
+        printf("%-24s %-20s %9.0f frames/s  ", traceName, mode->name, elapsedTime > 0 ? session->numberOfFrames / elapsedTime : 0);
+        
+        if(generateFlag) {
+            if(writeGoldenPoses(filename, poses, numberOfPoses)) {
+                printf("golden file written\r\n");
+            } else {
+                printf("cannot write %s\r\n", filename);
+                numberOfFailures++;
+            }
+        } else if(!readGoldenPoses(filename, goldenPoses, maxNumberOfPoses, &numberOfGoldenPoses)) {
+            printf("MISSING golden file %s\r\n", filename);
+            numberOfFailures++;
+        } else if(numberOfGoldenPoses != numberOfPoses || !comparePoses(poses, goldenPoses, numberOfPoses, &quaternionError, &angleError)) {
+            printf("FAILED (%ld poses instead of %ld)\r\n", numberOfPoses, numberOfGoldenPoses);
+            numberOfFailures++;
+        } else if(quaternionError > mode->quaternionTolerance || angleError > mode->angleTolerance) {
+            printf("FAILED (quaternion error %.3g, tolerance %.3g, angle error %.3g deg, tolerance %.3g)\r\n",
+                   quaternionError, mode->quaternionTolerance, angleError, mode->angleTolerance);
+            numberOfFailures++;
+        } else {
+            printf("ok (quaternion error %.3g, angle error %.3g deg)\r\n", quaternionError, angleError);
+        }
+    }
+    
+    free(poses);
+    free(goldenPoses);
+    
+    return numberOfFailures;
+}
+
+
+//=====================================================================================================
+// function runCalibration
+//=====================================================================================================
+//
+// offline calibration of the samples of trackingData->magCalibrationData with all the methods, and generate or check
+// the golden files
+// returns the number of failures
+//
+int runCalibration(const char *traceName, headtrackerData *trackingData) {
+    const calibrationMethod *method;
+    calibrationData *samples;
+    char filename[MAX_FILENAME_LENGTH];
+    FILE *file;
+    float goldenOffset[3], goldenScaling[3];
+    double startTime, elapsedTime, error;
+    int numberOfFailures = 0, result, i;
+    
+    // the calibration routines modify the data: keep a copy of the samples
+    samples = (calibrationData*) malloc(sizeof(calibrationData));
+    memcpy(samples, trackingData->magCalibrationData, sizeof(calibrationData));
+    
+    for(method = calibrationMethods; method->name; method++) {
+        // golden file, the calibration is not run if its name does not fit
+        if(snprintf(filename, MAX_FILENAME_LENGTH, "%s/calibration.%s.%s.txt", goldenDirectory, traceName, method->name) >= MAX_FILENAME_LENGTH) {
+            printf("%-24s %-20s FAILED (golden file name too long)\r\n", traceName, method->name);
+            numberOfFailures++;
+            continue;
+        }
+        
+        memcpy(trackingData->magCalibrationData, samples, sizeof(calibrationData));
+        setOfflineCalibrationMethod(trackingData, method->offlineCalibrationMethod);
+        
+        startTime = get_monotonic_time();
+        result = !calibrateMag(trackingData);
+        elapsedTime = get_monotonic_time() - startTime;
+        while(pullNotificationMessage(trackingData) != NOTIFICATION_MESSAGE_NONE);
+        
+        printf("%-24s %-20s %9.3f ms        ", traceName, method->name, elapsedTime * 1000);
+        
+        if(!result) {
+            printf("FAILED (calibration failed)\r\n");
+            numberOfFailures++;
+        } else if(generateFlag) {
+            if((file = fopen(filename, "w")) != NULL) {
+                result = (fprintf(file, "offset %.9g %.9g %.9g\nscaling %.9g %.9g %.9g\n",
+                                  trackingData->magOffset[0], trackingData->magOffset[1], trackingData->magOffset[2],
+                                  trackingData->magScaling[0], trackingData->magScaling[1], trackingData->magScaling[2]) > 0);
+                if(fclose(file)) result = 0;
+            } else {
+                result = 0;
+            }
+            
+            if(result) {
+                printf("golden file written\r\n");
+            } else {
+                printf("cannot write %s\r\n", filename);
+                numberOfFailures++;
+            }
+        } else if((file = fopen(filename, "r")) == NULL) {
+            printf("MISSING golden file %s\r\n", filename);
+            numberOfFailures++;
+        } else {
+            result = (fscanf(file, "offset %f %f %f scaling %f %f %f", &goldenOffset[0], &goldenOffset[1], &goldenOffset[2],
+                             &goldenScaling[0], &goldenScaling[1], &goldenScaling[2]) == 6);
+            fclose(file);
+            
+            // relative error, compared to the scaling
+            error = 0;
+            for(i = 0; i < 3 && result; i++) {
+                error = max(error, fabs(trackingData->magOffset[i] - goldenOffset[i]) / fabs(goldenScaling[i]));
+                error = max(error, fabs(trackingData->magScaling[i] - goldenScaling[i]) / fabs(goldenScaling[i]));
+            }
+            
+            if(!result) {
+                printf("FAILED (invalid golden file)\r\n");
+                numberOfFailures++;
+            } else if(error > method->tolerance) {
+                printf("FAILED (relative error %.3g, tolerance %.3g)\r\n", error, method->tolerance);
+                numberOfFailures++;
+            } else {
+                printf("ok (relative error %.3g)\r\n", error);
+            }
+        }
+    }
+    
+    free(samples);
+    
+    return numberOfFailures;
+}
+
+
+// name of a trace: name of the file without directory and extension
+void traceNameFromFilename(char *traceName, const char *filename) {
+    const char *slash = strrchr(filename, '/');
+    char *dot;
+    
+    strncpy(traceName, slash ? slash + 1 : filename, MAX_FILENAME_LENGTH - 1);
+    traceName[MAX_FILENAME_LENGTH - 1] = 0;
+    if((dot = strrchr(traceName, '.')) != NULL) *dot = 0;
+}
+
+
+void printUsage() {
+    printf("usage: hedrot_regression [-g] [-d golden directory] [-t recording]... [-c calibration samples]... [-n repetitions]\r\n");
+    printf("\t-g: generate the golden files (reference version) instead of checking them\r\n");
+    printf("\t-d: directory of the golden files (default: golden)\r\n");
+    printf("\t-t: real capture, recorded by the Max external (text or binary format), can be repeated\r\n");
+    printf("\t-c: raw samples of a real calibration (see export_magCalDataRawSamples), can be repeated\r\n");
+    printf("\t-n: number of repetitions of each trace for the throughput measurement (default: 1)\r\n");
+}
+
+
+int main(int argc, const char * argv[]) {
+    const char *recordings[MAX_NUMBER_OF_TRACES], *calibrations[MAX_NUMBER_OF_TRACES];
+    int numberOfRecordings = 0, numberOfCalibrations = 0, numberOfFailures = 0, i;
+    char traceName[MAX_FILENAME_LENGTH];
+    const syntheticTrace *trace;
+    const syntheticCalibration *calibration;
+    recordedSession *session;
+    headtrackerData *trackingData;
+    
+    printf("Hedrot regression harness, based on hedrot version %s, compiled on "__DATE__"\r\n", HEDROT_VERSION);
+    
+    // arguments
+    for(i = 1; i < argc; i++) {
+        if(!strcmp(argv[i], "-g")) generateFlag = 1;
+        else if(!strcmp(argv[i], "-d") && i+1 < argc) {
+            strncpy(goldenDirectory, argv[++i], MAX_FILENAME_LENGTH - 1);
+        } else if(!strcmp(argv[i], "-t") && i+1 < argc && numberOfRecordings < MAX_NUMBER_OF_TRACES) {
+            recordings[numberOfRecordings++] = argv[++i];
+        } else if(!strcmp(argv[i], "-c") && i+1 < argc && numberOfCalibrations < MAX_NUMBER_OF_TRACES) {
+            calibrations[numberOfCalibrations++] = argv[++i];
+        } else if(!strcmp(argv[i], "-n") && i+1 < argc) {
+            numberOfRepetitions = atoi(argv[++i]);
+            numberOfRepetitions = max(numberOfRepetitions, 1);
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    
+    // estimation: synthetic traces, then real captures
+    for(trace = syntheticTraces; trace->name; trace++) {
+        session = newRecordedSession();
+        createSyntheticTrace(trace, session);
+        numberOfFailures += runTrace(trace->name, session);
+        freeRecordedSession(session);
+    }
+    
+    for(i = 0; i < numberOfRecordings; i++) {
+        session = newRecordedSession();
+        traceNameFromFilename(traceName, recordings[i]);
+        if(recordedSession_read(session, (char*) recordings[i]) && session->samplerate > 0) {
+            numberOfFailures += runTrace(traceName, session);
+        } else {
+            printf("%s: cannot read the recording or its samplerate\r\n", recordings[i]);
+            numberOfFailures++;
+        }
+        freeRecordedSession(session);
+    }
+    
+    // calibration: synthetic point clouds, then real captures
+    trackingData = headtracker_new();
+    
+    for(calibration = syntheticCalibrations; calibration->name; calibration++) {
+        createSyntheticCalibration(calibration, trackingData->magCalibrationData);
+        numberOfFailures += runCalibration(calibration->name, trackingData);
+    }
+    
+    for(i = 0; i < numberOfCalibrations; i++) {
+        traceNameFromFilename(traceName, calibrations[i]);
+        if(readCalibrationSamples((char*) calibrations[i], trackingData->magCalibrationData)) {
+            numberOfFailures += runCalibration(traceName, trackingData);
+        } else {
+            printf("%s: no calibration samples\r\n", calibrations[i]);
+            numberOfFailures++;
+        }
+    }
+    
+    headtracker_free(trackingData);
+    
+    if(generateFlag)
+        printf("%d errors while writing the golden files in %s\r\n", numberOfFailures, goldenDirectory);
+    else
+        printf("%d failures\r\n", numberOfFailures);
+    
+    return numberOfFailures ? 1 : 0;
+}